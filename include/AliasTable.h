@@ -0,0 +1,50 @@
+#ifndef ALIASTABLE_H
+#define ALIASTABLE_H
+
+#include <vector>
+#include <boost/random/mersenne_twister.hpp>
+
+/// Table for picking an index at random from a fixed set of weights, in
+/// constant time, using Vose's alias method.
+///
+/// Building the table takes time proportional to the number of weights.
+/// Each pick then takes one random column and one random number in [0, 1):
+/// the column's own index is returned if the number is below the column's
+/// probability, and the column's alias otherwise.
+class AliasTable
+{
+public:
+  /// Create an empty table.
+  AliasTable();
+
+  /// Create a table from a set of weights.
+  /// @see build()
+  AliasTable(std::vector<double> const& weights);
+
+  ~AliasTable();
+
+  /// Rebuild the table from a set of weights.  Index i is picked with
+  /// probability weights[i] / (sum of weights).  Weights must not be
+  /// negative; if they are all zero, the table is empty.
+  void build(std::vector<double> const& weights);
+
+  /// Return true if there is nothing to pick.
+  bool empty() const;
+
+  /// Get the number of weights in the table.
+  unsigned int size() const;
+
+  /// Pick a random index.  The table must not be empty.
+  unsigned int pick(boost::random::mt19937& twister) const;
+
+private:
+  // Deliberately not PIMPLed; picks happen in tight loops.
+
+  /// Chance of keeping each column's own index.
+  std::vector<double> probability_;
+
+  /// Index to return instead, for each column.
+  std::vector<unsigned int> alias_;
+};
+
+#endif // ALIASTABLE_H
@@ -36,6 +36,14 @@ public:
   {
   }
 
+  /// Get how long the processing thread can sleep before process() needs to
+  /// be called again.  It is woken early by incoming events.
+  /// @return Time in ms, or a negative value to sleep until woken.
+  virtual double get_sleep_ms()
+  {
+    return 0;
+  }
+
   virtual void render()
   {
   }
@@ -36,6 +36,12 @@ public:
   /// @note Called in the processing thread ONLY!
   void process();
 
+  /// Get how long the processing thread can sleep, according to the active
+  /// app state.
+  /// @note Called in the processing thread ONLY!
+  /// @return Time in ms, or a negative value to sleep until woken.
+  double get_sleep_ms();
+
   /// Call the render function of the active app state.
   /// @note Called in the rendering thread ONLY!
   void render();
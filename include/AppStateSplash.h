@@ -20,6 +20,7 @@ public:
   void enter_state();
   void leave_state();
   void process();
+  double get_sleep_ms();
   void render();
 
 private:
@@ -13,6 +13,9 @@
 #include "AppStateManager.h"
 #include "FontCollection.h"
 
+// Forward declarations
+class JobSystem;
+
 /// The primary application class.  This class is instantiated by main(), and
 /// is the class wrapper for the entire program.  Since there's obviously one
 /// instance of the application, it is a singleton class.
@@ -47,6 +50,11 @@ public:
   /// Tell the application to halt.
   void halt();
 
+  /// Wake the processing thread if it is sleeping.
+  /// Call this after changing anything the processing thread should react
+  /// to from another thread.  Events handled by the application already do.
+  void wake();
+
   /// Return whether the application is running.
   bool isRunning();
 
@@ -56,6 +64,9 @@ public:
   /// Get the FontCollection instance.
   FontCollection& get_fonts();
 
+  /// Get the JobSystem instance.
+  JobSystem& get_jobs();
+
 protected:
 private:
   /// Application constructor.  Private since Application is a singleton class.
@@ -70,15 +81,15 @@ private:
   std::unique_ptr<Impl> impl;
 
   /// Processing function.
-  /// The processing function is very straightforward:
-  /// it polls the SFML window for events, and processes them when they come
-  /// in.  It also runs the state manager process function.
+  /// The processing function runs the state manager process function, then
+  /// sleeps for as long as the active state says it can, or until woken by
+  /// wake().
   void process();
 
   /// Rendering function.
   /// Also very straightforward, the rendering function is responsible for
-  /// rendering the GUI and stage to the screen regularly.
-  /// @todo Restrict the maximum rendering speed to 60fps.
+  /// rendering the GUI and stage to the screen regularly, at no more than
+  /// Settings::renderFrameRateLimit frames per second.
   void render();
 
   /// Application event handler.
@@ -0,0 +1,96 @@
+#ifndef ATLASBUILDER_H
+#define ATLASBUILDER_H
+
+#include <memory>
+#include <string>
+#include <SFML/Graphics.hpp>
+
+/// Builds a texture atlas in memory, with no need for a graphics context, so
+/// the same code runs in the game and in the offline AtlasBaker tool.
+///
+/// Images are placed with a skyline packer: the packer keeps the height of
+/// the filled area at every X position as a list of flat segments, puts each
+/// new image at the lowest spot along the skyline where it fits (leftmost on
+/// a tie), and raises the skyline over it.  The atlas image grows downward,
+/// in powers of two, as it fills up.
+///
+/// A finished atlas can be baked to an image file plus an XML table that
+/// lists where each named image went, the size and modification time of the
+/// file it came from, and the skyline, so that loading a baked atlas takes
+/// no packing at all and more images can still be added afterwards.
+class AtlasBuilder
+{
+public:
+  /// Constructor.
+  /// @param width      Width of the atlas, in pixels.
+  /// @param max_height Largest height the atlas may grow to, in pixels.
+  AtlasBuilder(unsigned int width, unsigned int max_height);
+
+  ~AtlasBuilder();
+
+  AtlasBuilder(AtlasBuilder const&) = delete;
+  AtlasBuilder& operator=(AtlasBuilder const&) = delete;
+
+  /// Pack an image into the atlas.
+  /// @param image  Image to add.
+  /// @param name   Name to file the image under, normally the path of the
+  ///               file it was read from; empty if it won't be looked up.
+  /// @param rect   Set to where the image went.
+  /// @return False if there is no room left.
+  bool add(sf::Image const& image, std::string const& name, sf::IntRect& rect);
+
+  /// Look up a named image.  If the name is the path of a file, the image
+  /// only counts if the file still has the size and modification time it had
+  /// when the image was added.
+  /// @return True if the image was found.
+  bool find(std::string const& name, sf::IntRect& rect) const;
+
+  /// Look up a named image, even if the file it came from has changed since
+  /// it was added.
+  /// @return True if the image was found.
+  bool find_any_version(std::string const& name, sf::IntRect& rect) const;
+
+  /// Overwrite a named image with a new version of the same size, in the
+  /// same place, and record the file's new size and modification time.
+  /// @param rect   Set to where the image is.
+  /// @return False if there is no image under that name, or if it is a
+  ///         different size.
+  bool replace(sf::Image const& image, std::string const& name, sf::IntRect& rect);
+
+  /// Get the atlas image.  Its height is a power of two at least as large as
+  /// get_used_height().
+  sf::Image const& get_image() const;
+
+  /// Get the width of the atlas.
+  unsigned int get_width() const;
+
+  /// Get the height of the part of the atlas that has anything in it.
+  unsigned int get_used_height() const;
+
+  /// Get the number of images in the atlas.
+  unsigned int get_image_count() const;
+
+  /// Get the fraction of the used part of the atlas that is covered by
+  /// images.
+  double get_efficiency() const;
+
+  /// Get the total time spent packing and copying images, in ms.
+  double get_packing_ms() const;
+
+  /// Write the atlas image and its table out.
+  /// @return True on success.
+  bool bake(std::string const& image_path, std::string const& table_path) const;
+
+  /// Replace the contents of the atlas with a baked one.
+  /// @return True on success.  On failure, the atlas is left empty, and the
+  ///         reason has been printed.
+  bool load(std::string const& image_path, std::string const& table_path);
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // ATLASBUILDER_H
@@ -0,0 +1,147 @@
+#ifndef BOUNDEDMPMCQUEUE_H
+#define BOUNDEDMPMCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// A fixed-capacity, lock-free queue that any number of threads can push to
+/// and pop from at once.  Each slot carries a sequence number that tells
+/// producers and consumers whose turn it is, so the only contention is on
+/// the head and tail counters (this is Dmitry Vyukov's bounded MPMC queue).
+template <typename T>
+class BoundedMPMCQueue
+{
+public:
+  /// Create a queue holding at least min_capacity items.  The capacity is
+  /// rounded up to a power of two.
+  explicit BoundedMPMCQueue(size_t min_capacity)
+  {
+    size_t capacity = 2;
+    while (capacity < min_capacity)
+    {
+      capacity <<= 1;
+    }
+
+    cells_.reset(new Cell[capacity]);
+    mask_ = capacity - 1;
+
+    for (size_t index = 0; index < capacity; ++index)
+    {
+      cells_[index].sequence.store(index, std::memory_order_relaxed);
+    }
+
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_relaxed);
+  }
+
+  BoundedMPMCQueue(BoundedMPMCQueue const&) = delete;
+  BoundedMPMCQueue& operator=(BoundedMPMCQueue const&) = delete;
+
+  /// Push an item onto the queue.  Returns false if the queue is full.
+  bool push(T const& value)
+  {
+    Cell* cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+      if (diff == 0)
+      {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Pop an item off the queue.  Returns false if the queue is empty.
+  bool pop(T& value)
+  {
+    Cell* cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+
+      if (diff == 0)
+      {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    value = cell->data;
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Get the number of items in the queue.  Only approximate while other
+  /// threads are pushing or popping.
+  size_t size_approx() const
+  {
+    size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+    return (enqueued > dequeued) ? (enqueued - dequeued) : 0;
+  }
+
+  /// Get the capacity of the queue.
+  size_t capacity() const
+  {
+    return mask_ + 1;
+  }
+
+private:
+  /// A slot in the queue.
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  /// Size of padding used to keep the counters on separate cache lines.
+  static const size_t cache_line_size = 64;
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  char pad0_[cache_line_size];
+  std::atomic<size_t> enqueue_pos_;
+  char pad1_[cache_line_size];
+  std::atomic<size_t> dequeue_pos_;
+  char pad2_[cache_line_size];
+};
+
+#endif // BOUNDEDMPMCQUEUE_H
@@ -0,0 +1,78 @@
+#ifndef CHUNKRENDERSTATE_H
+#define CHUNKRENDERSTATE_H
+
+#include <atomic>
+#include <cstdint>
+
+/// Whether a chunk's render data is stale, and whether the chunk is waiting
+/// on a renderer's stale queue, kept in a single atomic word.
+///
+/// A renderer that takes a chunk off its queue clears both flags in one
+/// step, before it snapshots the chunk.  With two separate flags there is a
+/// moment, between clearing one and the other, when a change to the chunk
+/// finds it still dirty (so nobody is told) or still queued (so it isn't
+/// pushed), and the change is then never re-rendered.
+class ChunkRenderState
+{
+public:
+  /// The state starts out dirty and not queued.
+  ChunkRenderState()
+    : state_(Dirty)
+  {
+  }
+
+  ChunkRenderState(ChunkRenderState const&) = delete;
+  ChunkRenderState& operator=(ChunkRenderState const&) = delete;
+
+  /// Mark the render data as stale.
+  /// @return True if it was up to date; i.e. if listeners should be told.
+  inline bool set_dirty()
+  {
+    return (state_.fetch_or(Dirty) & Dirty) == 0;
+  }
+
+  /// Mark the render data as up to date, leaving the queued flag alone.
+  inline void clear_dirty()
+  {
+    state_.fetch_and((uint8_t) ~Dirty);
+  }
+
+  /// Return true if the render data is stale.
+  inline bool is_dirty() const
+  {
+    return (state_.load() & Dirty) != 0;
+  }
+
+  /// Mark the chunk as queued.
+  /// @return True if it was not already queued; i.e. if the caller is the
+  ///         one who should queue it.
+  inline bool try_mark_queued()
+  {
+    return (state_.fetch_or(Queued) & Queued) == 0;
+  }
+
+  /// Clear the queued flag, e.g. if the chunk couldn't be queued after all.
+  inline void clear_queued()
+  {
+    state_.fetch_and((uint8_t) ~Queued);
+  }
+
+  /// Clear both flags at once, when the chunk has been taken off the queue
+  /// and is about to be snapshotted.  Any change after this marks it dirty
+  /// and gets it queued again.
+  inline void take()
+  {
+    state_.store(0);
+  }
+
+private:
+  enum Bits
+  {
+    Dirty = 0x01,   ///< Render data needs recalculating
+    Queued = 0x02   ///< Chunk is on a renderer's stale queue
+  };
+
+  std::atomic<uint8_t> state_;
+};
+
+#endif // CHUNKRENDERSTATE_H
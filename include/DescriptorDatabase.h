@@ -0,0 +1,117 @@
+#ifndef DESCRIPTORDATABASE_H
+#define DESCRIPTORDATABASE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/property_tree/ptree.hpp>
+
+/// Compiled, binary copy of the descriptor files under data/ (substances,
+/// prop types and verbs), so that startup doesn't have to parse hundreds of
+/// XML files.
+///
+/// The database is written offline by the DataCompiler tool (see
+/// tools/DataCompiler.cbp), and mapped into memory when the game starts.  It
+/// holds a string table, one record per descriptor file, and the nodes of
+/// every file's property tree as parallel columns: key, text value, typed
+/// value and subtree size.  It also lists the size and modification time of
+/// every source file; if any of them no longer match, or the format version
+/// differs, the database is stale and is ignored, and descriptors are read
+/// from XML as before.
+///
+/// The file is written in the compiling machine's byte order and is not meant
+/// to be shipped between platforms.
+class DescriptorDatabase
+{
+public:
+  /// Kinds of descriptor in the database.
+  enum class Section
+  {
+    Substances,   ///< data/substances/<name>.xml
+    Props,        ///< data/props/<name>.xml
+    Verbs,        ///< data/verbs.xml, stored under the name "verbs"
+    Count
+  };
+
+  /// Type of a property value, as worked out when the database was compiled.
+  enum class PropertyType
+  {
+    Empty,        ///< No text at all
+    Bool,         ///< "true" or "false"
+    Int,          ///< A decimal integer
+    Float,        ///< Any other number
+    String        ///< Anything else
+  };
+
+  /// A single property value.
+  struct Property
+  {
+    PropertyType type;
+
+    /// The value as it appeared in the XML file.
+    std::string text;
+
+    /// The value as a number, for Bool, Int and Float properties.
+    double number;
+  };
+
+  /// Get the singleton database instance.  It starts out closed.
+  static DescriptorDatabase* instance();
+
+  ~DescriptorDatabase();
+
+  DescriptorDatabase(DescriptorDatabase const&) = delete;
+  DescriptorDatabase& operator=(DescriptorDatabase const&) = delete;
+
+  /// Compile the descriptor files under a data directory into a database.
+  /// @param data_path      Data directory, normally "data".
+  /// @param database_path  File to write.
+  /// @return True on success.
+  static bool compile(std::string data_path, std::string database_path);
+
+  /// Map a database into memory, if it is present and up to date.
+  /// @param data_path      Data directory the database was compiled from.
+  /// @param database_path  Database file.
+  /// @return True if the database is now open.  If false, the reason has
+  ///         been printed and read() falls back to the XML files.
+  bool open(std::string data_path, std::string database_path);
+
+  /// Unmap the database; read() falls back to the XML files.
+  void close();
+
+  /// Return true if a database is open.
+  bool is_open() const;
+
+  /// Read the property tree for a descriptor, from the database if it is
+  /// open, or from its XML file if not.  Safe to call from several threads
+  /// at once.
+  /// @throw std::exception if the XML file can't be read or parsed, or if
+  ///        the database is open but has no such descriptor.
+  void read(Section section,
+            std::string const& name,
+            boost::property_tree::ptree& properties) const;
+
+  /// Look a single property up in the open database, without building a
+  /// property tree.  Path components are separated by dots, as with ptree.
+  /// @return True if the database is open and the property was found.
+  bool get_property(Section section,
+                    std::string const& name,
+                    std::string const& path,
+                    Property& property) const;
+
+  /// Get the names of every descriptor of one kind in the open database, in
+  /// sorted order.
+  std::vector<std::string> get_names(Section section) const;
+
+protected:
+private:
+  DescriptorDatabase();
+
+  static std::unique_ptr<DescriptorDatabase> instance_;
+
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // DESCRIPTORDATABASE_H
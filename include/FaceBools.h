@@ -8,6 +8,7 @@
 #ifndef FACEBOOLS_H_
 #define FACEBOOLS_H_
 
+#include "common_enums.h"
 #include "common_includes.h"
 #include "common_typedefs.h"
 
@@ -38,6 +39,15 @@ public:
   void set_back(bool value);
   void set_front(bool value);
 
+  /// Get the faces as a bitmask, with bit N corresponding to FaceName N.
+  uint8_t get_mask() const;
+
+  /// Set the faces from a bitmask, with bit N corresponding to FaceName N.
+  void set_mask(uint8_t mask);
+
+  /// Bitmask with all six faces set.
+  static const uint8_t all_mask = 0x3F;
+
   FaceBools& operator=(const FaceBools& rhs);
   FaceBools& operator=(const bool& rhs);
   FaceBools& operator|=(const FaceBools& rhs);
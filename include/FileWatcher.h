@@ -0,0 +1,52 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Watches directories for files being written, created, moved in or
+/// deleted, so that data can be reloaded while the game runs.
+///
+/// On Linux the kernel reports changes as they happen, through inotify.
+/// Elsewhere, or if inotify can't be set up, a background thread compares
+/// the size and modification time of every file at a fixed interval instead.
+class FileWatcher
+{
+public:
+  /// Called from the watcher's thread when new changes are waiting.
+  typedef std::function<void()> Callback;
+
+  /// Constructor.  Starts watching straight away.
+  /// @param directories  Directories to watch.  Subdirectories aren't.
+  /// @param extension    Only report files with this extension, e.g. ".xml".
+  /// @param poll_ms      Interval between checks, if polling has to be used.
+  /// @param on_change    If not empty, called when changes are waiting.
+  FileWatcher(std::vector<std::string> const& directories,
+              std::string const& extension,
+              unsigned int poll_ms,
+              Callback on_change = Callback());
+
+  /// Destructor.  Stops watching.
+  ~FileWatcher();
+
+  FileWatcher(FileWatcher const&) = delete;
+  FileWatcher& operator=(FileWatcher const&) = delete;
+
+  /// Get the paths of the files that have changed since the last call, each
+  /// listed once, in sorted order.  A path is a watched directory, a slash,
+  /// and a file name.
+  std::vector<std::string> take_changes();
+
+  /// Return true if the watcher is polling instead of being told of changes.
+  bool is_polling() const;
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // FILEWATCHER_H
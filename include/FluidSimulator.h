@@ -0,0 +1,62 @@
+#ifndef FLUIDSIMULATOR_H
+#define FLUIDSIMULATOR_H
+
+#include "common_includes.h"
+#include "common_typedefs.h"
+
+// Forward declarations
+class Stage;
+
+/// Cellular-automaton simulation of liquids on the stage.
+///
+/// Every block gets a liquid level from 0 to max_level, kept per chunk slab
+/// in two buffers.  A tick reads only the current buffers and writes each
+/// chunk's other buffer, so chunks can be updated in any order, on any number
+/// of threads, with identical results.  Liquid first falls into the block
+/// below if there is room, and then spreads sideways towards lower neighbors.
+///
+/// Only chunks that had some flow on the last tick (and those around them) are
+/// updated, so a settled lake costs nothing.  When a block gains or loses
+/// liquid, its fluid layer substance is updated on the stage.
+class FluidSimulator
+{
+public:
+  FluidSimulator(Stage& stage);
+  ~FluidSimulator();
+
+  /// Read liquid from every block on the stage, and mark every chunk that
+  /// contains any as active.
+  void load();
+
+  /// Re-read which substances are liquids, after substance descriptors have
+  /// been reloaded.  Chunk slabs holding those substances should then be
+  /// woken.
+  void refresh_substances();
+
+  /// Re-read the chunk slab containing a block, after something other than
+  /// the simulator has changed it, and mark it active.
+  void wake(StageCoord x, StageCoord y, StageCoord z);
+
+  /// Advance the simulation by one step.
+  /// @return The number of chunk slabs that were updated.
+  unsigned int tick();
+
+  /// Get the number of chunk slabs that will be updated on the next tick,
+  /// not counting their neighbors.
+  unsigned int get_active_chunk_count() const;
+
+  /// Get the number of job system workers that large ticks are split
+  /// between.
+  unsigned int get_thread_count() const;
+
+  /// Liquid level of a completely full block.
+  static const int max_level = 64;
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // FLUIDSIMULATOR_H
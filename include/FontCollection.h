@@ -6,6 +6,7 @@
 #include <string>
 
 // Forward declarations
+class TextLayoutCache;
 class TextureFont;
 
 class FontCollection
@@ -31,6 +32,9 @@ class FontCollection
     // Get the default font.  Use for speed when you just want the default.
     TextureFont& get_default();
 
+    // Get the cache of text laid out in these fonts.
+    TextLayoutCache& get_layouts();
+
   protected:
   private:
     struct Impl;
@@ -33,6 +33,9 @@ public:
   /// Returns this element's name.
   std::string getElementName();
 
+  /// Returns this element's parent, or nullptr if it has none.
+  GUIElement* get_parent();
+
   glm::vec2 const& getLocation();
 
   /// Set the element's location.
@@ -68,15 +71,24 @@ public:
   glm::vec2 getAbsoluteSize();
   bool get_absolute_visibility();
 
-  /// Set the dirty flag on this element and on this element's parent (if any).
+  /// Set the dirty flag on this element, and tell this element's ancestors
+  /// (if any) that something under them is dirty.
   virtual void set_dirty();
 
-  /// Clear the dirty flag on this element.
+  /// Clear the dirty flags on this element.
   virtual void clear_dirty();
 
-  /// Return whether this element is dirty.
+  /// Clear only the flag saying that something under this element is dirty,
+  /// leaving this element's own flag and its children's flags alone.
+  void clear_child_dirty();
+
+  /// Return whether this element, or anything under it, is dirty.
   virtual bool is_dirty();
 
+  /// Return whether this element itself is dirty, as opposed to only
+  /// something under it.
+  bool is_self_dirty();
+
 protected:
   void set_dirty_flag();
   void clear_dirty_flag();
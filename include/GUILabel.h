@@ -10,6 +10,8 @@
 
 /// Forward declarations
 class GUIElementVisitor;
+struct TextLayout;
+class TextureFont;
 
 /// Class representing a text label in the GUI.
 class GUILabel: public GUIElement
@@ -29,6 +31,17 @@ public:
   virtual std::u32string getText();
   virtual void setText(std::u32string text);
 
+  /// Get whether the text is drawn with a dark outline around it.
+  virtual bool getOutlined();
+
+  /// Set whether the text is drawn with a dark outline around it.
+  virtual void setOutlined(bool outlined);
+
+  /// Get the text laid out in a font and wrapped at a width.  The layout is
+  /// kept until the text, font or width changes, so a label whose text stays
+  /// the same is never laid out again.
+  virtual TextLayout const& getLayout(TextureFont& font, float wrap_width);
+
 private:
   struct Impl;
   /// Private implementation pointer
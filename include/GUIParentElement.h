@@ -43,7 +43,7 @@ public:
   /// Get the total number of children of this element.
   unsigned int get_child_count();
 
-  /// Clear dirty flag, and dirty flag on all child elements.
+  /// Clear dirty flags, and dirty flags on all child elements.
   virtual void clear_dirty();
 
 protected:
@@ -2,27 +2,61 @@
 #define GUIRENDERDATA_H
 
 #include <boost/container/vector.hpp>
+#include <boost/unordered_map.hpp>
 #include <glm/glm.hpp>
 
 #include "common.h"
 
 // Forward declarations
+class GUIElement;
 struct GUIVertexRenderData;
 
-/** Struct representing all of the rendering data associated with a GUI element. */
+/** Struct representing all of the rendering data associated with a GUI element.
+ *
+ *  The vertices for the whole GUI live in one buffer, in the order the tree
+ *  is visited, so every element's vertices and those of everything under it
+ *  form one contiguous span.  Each span is followed by some spare room.
+ *  Once the buffer has been built, a pass over the GUI only re-emits the
+ *  elements that are dirty (and everything under them), writing each one
+ *  back over its old span and uploading just that part of the buffer.  If
+ *  an element no longer fits in its span, the whole buffer is rebuilt. */
 struct GUIRenderData
 {
+  /// Part of the vertex buffer belonging to an element and its children.
+  struct Span
+  {
+    unsigned int first;       ///< Index of the first vertex
+    unsigned int capacity;    ///< Number of vertices, including spare room
+  };
+
   GUIRenderData();
   ~GUIRenderData();
+
+  /// Throw away all vertex data, so the next pass rebuilds it all.
   void clear_vertices();
+
+  /// Start a pass over the GUI.
+  void begin_pass();
+
+  /// Start visiting an element during a pass.
+  /// @return True if the element's vertices should be emitted now.
+  bool begin_element(GUIElement& element);
+
+  /// Finish a pass over the GUI.
+  /// @return False if something didn't fit in its span, in which case the
+  ///         data has been cleared and the GUI needs another pass.
+  bool end_pass();
+
   void add_vertex(glm::vec2 vertex,
                  glm::vec4 color,
                  float tex_coord_x = 0.0f,
                  float tex_coord_y = 0.0f,
                  bool textured = false);
+
+  /// Upload whatever has changed since the last upload.
   void update_VAO();
 
-  /// Vertex vector.
+  /// Vertex vector for the whole GUI.
   boost::container::vector<GUIVertexRenderData> vertices;
 
   /// VBO ID for the vertex array.
@@ -33,5 +67,45 @@ struct GUIRenderData
 
   /// Number of vertices.
   int vertex_count;
+
+  /// Number of vertices emitted during the last pass.  A pass where nothing
+  /// changed emits none.
+  unsigned int emitted_count;
+
+private:
+  /// Span that is still being emitted.
+  struct OpenSpan
+  {
+    GUIElement* element;
+    unsigned int first;
+  };
+
+  /// Return the buffer vertices are being emitted into.
+  boost::container::vector<GUIVertexRenderData>& target();
+
+  /// Finish the innermost open span.
+  void close_span();
+
+  /// Spans of every element that has been emitted.
+  boost::unordered_map<GUIElement const*, Span> spans;
+
+  /// Spans being emitted, outermost first.
+  boost::container::vector<OpenSpan> open;
+
+  /// Vertices and spans of an element being re-emitted, relative to the
+  /// start of its old span, until we know they fit.
+  boost::container::vector<GUIVertexRenderData> scratch;
+  boost::unordered_map<GUIElement const*, Span> scratch_spans;
+
+  /// True while the whole buffer is being built from scratch.
+  bool rebuilding;
+
+  /// True if something didn't fit in its span during this pass.
+  bool overflowed;
+
+  /// Part of the buffer that needs uploading.
+  bool upload_all;
+  unsigned int upload_first;
+  unsigned int upload_last;
 };
-#endif // CHUNKRENDERDATA_H
+#endif // GUIRENDERDATA_H
@@ -0,0 +1,34 @@
+#ifndef HIDDENFACEKERNEL_H
+#define HIDDENFACEKERNEL_H
+
+#include "common.h"
+
+#include "StageChunk.h"
+#include "StageChunkHalo.h"
+
+/// Calculates the hidden face masks for every block in a chunk at once.
+/// This does the same job as StageBlock::calculate_hidden_faces(), but works
+/// on a StageChunkHalo snapshot of the chunk and its neighbors, so it can
+/// compare eight blocks at a time with SSE2 instructions.
+class HiddenFaceKernel
+{
+public:
+  /// Output masks, one per block, row-major within the chunk.  Bit N is set
+  /// if the face FaceName N is hidden.
+  struct Output
+  {
+    uint8_t solid[StageChunk::blocks_per_chunk];  ///< Solid layer masks
+    uint8_t fluid[StageChunk::blocks_per_chunk];  ///< Fluid layer masks
+  };
+
+  /// Calculate the hidden face masks, using SIMD instructions if available.
+  static void calculate(StageChunkHalo const& halo, Output& output);
+
+  /// Calculate the hidden face masks one block at a time.
+  static void calculate_scalar(StageChunkHalo const& halo, Output& output);
+
+private:
+  HiddenFaceKernel() = delete;  ///< No instantiations!
+};
+
+#endif // HIDDENFACEKERNEL_H
@@ -1,6 +1,6 @@
 // *** ADDED BY HEADER FIXUP ***
 #include <algorithm>
-#include <set>
+#include <vector>
 // *** END ***
 #ifndef INVENTORY_H_
 #define INVENTORY_H_
@@ -9,42 +9,85 @@
 #include "common_includes.h"
 #include "common_typedefs.h"
 
-// Forward declarations
-class HasLocation;
-
-/// Declaration of an inventory of objects derived from HasLocation.
+/// Declaration of an inventory of Props, referred to by serial number.
+/// Up to inline_capacity serial numbers are stored inside the Inventory
+/// itself; beyond that they spill into a vector, and move back once there are
+/// few enough to fit again.  Either way the contents are kept sorted and
+/// contiguous, so they can be iterated with begin()/end().
 class Inventory
 {
 public:
   Inventory();                                    ///< Constructor
   virtual ~Inventory();                           ///< Destructor
 
-  /// Attempt to add a HasLocation object to this container.
-  /// Called by HasLocation::moveTo().  Does not change the added object's
+  /// Attempt to add a Prop to this container.
+  /// Called by Prop::move_to().  Does not change the added object's
   /// location -- this is up to the caller.
-  bool add(HasLocation* _prop);
+  bool add(SerialNumber prop);
 
-  /// Attempt to remove a HasLocation object from this container.
-  /// Called by HasLocation::moveTo().  Does not change the removed object's
+  /// Attempt to remove a Prop from this container.
+  /// Called by Prop::move_to().  Does not change the removed object's
   /// location -- this is up to the caller.
-  bool remove(HasLocation* _prop);
+  bool remove(SerialNumber prop);
+
+  /// Set the stage position of this inventory, for inventories that sit on
+  /// the stage (i.e. those of StageBlocks).  Props moved into it are added to
+  /// the stage's PropSpatialIndex.
+  void set_position(StageCoord3 const& position);
+
+  /// Get the stage position of this inventory.
+  /// Returns false if the inventory isn't on the stage.
+  bool get_position(StageCoord3& position) const;
+
+  /// Returns true if the Prop is in this inventory.
+  bool contains(SerialNumber prop) const;
 
   /// Returns the number of items in an inventory.
-  int Quantity();
+  int Quantity() const;
 
   /// Returns true if an inventory is empty, false otherwise.
-  bool IsEmpty();
+  bool IsEmpty() const;
 
-  /// Return a const reference to the contents for enumeration.
-  boost::container::set<HasLocation*> const& getContents(void);
+  /// Return a pointer to the first serial number in the inventory.
+  /// Invalidated by add() and remove().
+  SerialNumber const* begin() const;
+
+  /// Return a pointer past the last serial number in the inventory.
+  SerialNumber const* end() const;
 
   /// Get the "limbo" inventory.
+  /// Limbo doesn't keep track of its contents; Props just pass through it.
   static Inventory& getLimbo();
 
+  /// Number of serial numbers stored without spilling to the heap.
+  static const unsigned int inline_capacity = 3;
+
 private:
-  struct Impl;
-  /// Private implementation pointer
-  std::unique_ptr<Impl> impl;
+  // Deliberately not PIMPLed; most inventories hold only a few items, and
+  // the point is to avoid a heap allocation for them.
+
+  /// Constructor used for limbo.
+  Inventory(bool tracked);
+
+  /// Serial numbers, if there are no more than inline_capacity of them.
+  SerialNumber inline_[inline_capacity];
+
+  /// Serial numbers, while there are more than inline_capacity of them.
+  std::vector<SerialNumber> spill_;
+
+  /// Stage position of the inventory, if positioned_ is true.
+  StageCoord3 position_;
+
+  /// Number of items in the inventory.
+  unsigned int count_;
+
+  /// True if the inventory sits at a position on the stage.
+  bool positioned_;
+
+  /// True if the contents are in spill_ rather than inline_.
+  bool spilled_;
 
+  /// False if the inventory doesn't record its contents (i.e. limbo).
+  bool tracked_;
 };
 #endif /* INVENTORY_H_ */
@@ -0,0 +1,149 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <functional>
+#include <boost/thread/mutex.hpp>
+
+#include "common_includes.h"
+
+/// Pool of worker threads that stage builders, the chunk mesher and the
+/// simulation systems hand short jobs to, instead of each starting threads
+/// of their own.
+///
+/// Each worker has its own queues.  A job submitted from a worker goes on
+/// that worker's queues, and the worker runs its newest jobs first; a worker
+/// that runs out of work steals the oldest jobs from the others.  Jobs
+/// submitted from other threads are dealt out between the workers in turn.
+///
+/// Jobs have a priority; a worker always takes a higher-priority job, from
+/// anywhere, before a lower-priority one.  Completion is tracked with
+/// Counters: a job can be tied to a Counter when it is submitted, another job
+/// can be held back until a Counter reaches zero, and any thread can wait on
+/// a Counter.  A waiting thread runs queued jobs itself until the Counter
+/// reaches zero, so waiting from inside a job can't deadlock the pool.
+class JobSystem
+{
+public:
+  /// A unit of work.
+  typedef std::function<void()> Job;
+
+  /// Job priority.  Higher-priority jobs are always started first.
+  enum class Priority
+  {
+    High,
+    Normal,
+    Low,
+    Count
+  };
+
+  /// Number of jobs still to finish from some group.  Tie jobs to a Counter
+  /// by passing it to submit().  A Counter must outlive its jobs, and any
+  /// jobs held back with submit_after().
+  class Counter
+  {
+  public:
+    Counter();
+    ~Counter();
+
+    Counter(Counter const&) = delete;
+    Counter& operator=(Counter const&) = delete;
+
+    /// Return true if every job tied to this Counter has finished.
+    bool is_done() const;
+
+  private:
+    friend class JobSystem;
+
+    /// A job waiting for this Counter to reach zero.
+    struct Continuation
+    {
+      Job job;
+      Priority priority;
+      Counter* counter;
+    };
+
+    std::atomic<unsigned int> pending_;
+
+    /// Protects continuations_, and the moment pending_ reaches zero.
+    boost::mutex mutex_;
+
+    std::vector<Continuation> continuations_;
+  };
+
+  /// Statistics for one worker.
+  struct WorkerStats
+  {
+    /// Number of jobs run.
+    unsigned int jobs_run;
+
+    /// Number of those jobs that were taken from another worker's queues.
+    unsigned int jobs_stolen;
+
+    /// Number of times the worker went to sleep for lack of jobs.
+    unsigned int sleeps;
+
+    /// Total time spent running jobs, in ms.
+    double busy_ms;
+  };
+
+  /// Constructor.  Starts the worker threads.
+  /// @param worker_count Number of worker threads; if 0, one per hardware
+  ///                     thread.
+  JobSystem(unsigned int worker_count);
+
+  /// Destructor.  Runs every job that is still queued, then stops the
+  /// worker threads.
+  ~JobSystem();
+
+  JobSystem(JobSystem const&) = delete;
+  JobSystem& operator=(JobSystem const&) = delete;
+
+  /// Queue a job.
+  /// @param job      Job to run.
+  /// @param priority Priority of the job.
+  /// @param counter  If not null, Counter to tie the job to.
+  void submit(Job job,
+              Priority priority = Priority::Normal,
+              Counter* counter = nullptr);
+
+  /// Queue a job once every job tied to another Counter has finished.
+  /// @param dependency Counter to wait for.
+  /// @param job        Job to run.
+  /// @param priority   Priority of the job.
+  /// @param counter    If not null, Counter to tie the job to.  The job
+  ///                   counts as pending from now, not from when it's queued.
+  void submit_after(Counter& dependency,
+                    Job job,
+                    Priority priority = Priority::Normal,
+                    Counter* counter = nullptr);
+
+  /// Run queued jobs on this thread until every job tied to a Counter has
+  /// finished.
+  void wait(Counter& counter);
+
+  /// Split the range [0, count) into pieces of at most grain items, run
+  /// body(first, last) for each piece as a job, and wait for all of them.
+  void parallel_for(unsigned int count,
+                    unsigned int grain,
+                    std::function<void(unsigned int, unsigned int)> body,
+                    Priority priority = Priority::Normal);
+
+  /// Get the number of worker threads.
+  unsigned int get_worker_count() const;
+
+  /// Get statistics for each worker thread, followed by one entry for all
+  /// jobs run by other threads while waiting.
+  std::vector<WorkerStats> get_stats() const;
+
+  /// Print statistics for each worker thread.
+  void report() const;
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // JOBSYSTEM_H
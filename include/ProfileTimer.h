@@ -0,0 +1,33 @@
+#ifndef PROFILETIMER_H
+#define PROFILETIMER_H
+
+#include <string>
+#include <boost/chrono.hpp>
+
+/// Simple stopwatch used for profiling.
+/// If constructed with a label, the elapsed time is printed when the timer
+/// goes out of scope, but only if debug.code.profile is set in the settings
+/// file.  Unlabeled timers can be used to accumulate time manually.
+class ProfileTimer
+{
+public:
+  ProfileTimer(std::string label = "");
+  ~ProfileTimer();
+
+  /// Restart the timer from zero.
+  void restart();
+
+  /// Get the time elapsed since construction or the last restart, in ms.
+  double get_elapsed_ms() const;
+
+private:
+  // Deliberately not PIMPLed; these get created in tight loops.
+
+  /// Label to print on destruction.  Empty means "don't print".
+  std::string label_;
+
+  /// Time at which the timer was started.
+  boost::chrono::steady_clock::time_point start_;
+};
+
+#endif // PROFILETIMER_H
@@ -28,6 +28,9 @@ public:
 
   void accept(StageComponentVisitor& visitor);
 
+  /// Return this Prop's serial number.
+  SerialNumber get_serial_number() const;
+
   Inventory& get_inventory();
 
   /// Return this object's location.
@@ -47,9 +50,10 @@ public:
   const Substance& get_substance() const;
 
 protected:
-  Prop();                             ///< Constructor
-  Prop(std::string typeName);      ///< Constructor
-  Prop(Prop& _other);                 ///< Constructor
+  Prop(SerialNumber number,
+       const PropPrototype& type,
+       Inventory& location);                             ///< Constructor
+  Prop(SerialNumber number, Prop& _other);               ///< Constructor
 
 private:
   struct Impl;
@@ -58,12 +62,75 @@ private:
 
 // === Static Members =========================================================
 public:
+  /// Flags kept in the hot data for every Prop slot.
+  enum HotFlags
+  {
+    FlagAlive = 0x01,     ///< Slot holds a live Prop
+    FlagSolid = 0x02,     ///< Prop is solid
+    FlagVisible = 0x04,   ///< Prop is visible
+    FlagOpaque = 0x08     ///< Prop is opaque (always set with FlagVisible)
+  };
+
   static SerialNumber create(std::string name);
+
+  /// Create a batch of Props of the same type, appending their serial
+  /// numbers to the vector provided.  The prototype is looked up only once.
+  static void create(std::string name,
+                     unsigned int count,
+                     std::vector<SerialNumber>& numbers);
+
+  /// Create one Prop of the same type in each of the locations provided, in
+  /// a single pass.  The prototype is looked up only once, and the Props go
+  /// straight to their locations without passing through limbo.
+  /// If numbers is not null, the new serial numbers are appended to it.
+  static void place(std::string name,
+                    std::vector<Inventory*> const& locations,
+                    std::vector<SerialNumber>* numbers = nullptr);
+
   static SerialNumber clone(SerialNumber other);
   static bool destroy(SerialNumber prop);
   static bool exists(SerialNumber prop);
   static Prop& get(SerialNumber prop);
 
+  /// Make room for the requested number of additional Props.
+  static void reserve(unsigned int count);
+
+  /// Get the number of Props currently in existence.
+  static unsigned int get_count();
+
+  /// Get the serial numbers of all Props currently in existence, for linear
+  /// iteration.  Order is not preserved across destroy().
+  static std::vector<SerialNumber> const& get_all();
+
+  /// Get the pool slot a serial number refers to.  This is the index into
+  /// the hot data arrays, and is stable for as long as the Prop exists.
+  static unsigned int get_slot_index(SerialNumber prop);
+
+  /// Get the number of slots in the Prop pool.  The hot data arrays below
+  /// all have this many entries; slots without FlagAlive are unused.
+  static unsigned int get_slot_count();
+
+  /// Get the HotFlags for every slot.  Invalidated by Prop creation.
+  static uint8_t const* get_flags_data();
+
+  /// Get the prototype ID for every slot.  Invalidated by Prop creation.
+  static PropPrototypeID const* get_prototype_data();
+
+  /// Get the location for every slot.  Invalidated by Prop creation.
+  static Inventory* const* get_location_data();
+
+  /// Get the Prop in a slot.  The slot must have FlagAlive set.
+  static Prop& get_at_slot(unsigned int slot);
+
+  /// Set the prototype of every Prop of a type again, after the type has
+  /// been reloaded, so that their hot flags match it.
+  /// @return The number of Props updated.
+  static unsigned int refresh_prototype(PropPrototypeID id);
+
+  /// Create, look up, iterate over and destroy the requested number of
+  /// Props, printing the time taken for each step.
+  static void benchmark(unsigned int count);
+
 protected:
 
 private:
@@ -25,6 +25,18 @@ public:
   /// Indicates whether this prop is visible.
   Visibility get_visibility() const;
 
+  /// Get this prototype's dense ID.
+  inline PropPrototypeID get_id(void) const
+  {
+    return id;
+  }
+
+  /// Indicates whether props of this type are solid.
+  inline bool is_solid(void) const
+  {
+    return cached_solid;
+  }
+
   /// Property tree containing all properties of this prop type.
   boost::property_tree::ptree properties;
 
@@ -64,6 +76,22 @@ public:
   /// Get a particular type from the collection.
   static PropPrototype& get(std::string type);
 
+  /// Get a particular type from the collection by ID.
+  static PropPrototype& get(PropPrototypeID id);
+
+  /// Get the number of types in the collection.
+  static unsigned int get_count();
+
+  /// Re-read the descriptor of an existing type, so that edits to it take
+  /// effect without restarting.  The type keeps its ID.  Descriptors are read
+  /// through the DescriptorDatabase, which must be closed first if it was
+  /// compiled before the edits.  The new properties are swapped in while
+  /// holding SubstanceLibrary::get_reload_mutex(), so code on the rendering
+  /// thread that holds it sees either the old type or the new one.
+  /// @return True if the type was reloaded; false if it doesn't exist or its
+  ///         descriptor can't be read, in which case it is left as it was.
+  static bool reload(std::string name);
+
 protected:
 private:
   // TODO: PIMPLize this when I'm feeling particularly masochistic.
@@ -71,18 +99,21 @@ private:
   /// Construct a PropPrototype object from an XML data file.
   PropPrototype(std::string name);
 
+  /// Load a type and add it to the collection, assigning it the next ID.
+  static void add(std::string name);
+
+  /// Fill in the cached fields from the property tree.
+  void cache_properties();
+
   /// Static font instance.
   static sf::Font const& getUnicodeFont();
 
-  /// Draw some text onto a texture, complete with black outlines.
-  void drawTextOntoTexture(sf::Text& renderText,
-                           sf::RenderTexture& renderTexture,
-                           bool outline,
-                           bool invert);
-
   /// Prop's name.
   std::string name;
 
+  /// Prototype's dense ID.
+  PropPrototypeID id;
+
   /// Visibility of this prop type.
   Visibility visibility;
 
@@ -92,6 +123,7 @@ private:
   int cached_xoffset;
   int cached_yoffset;
   bool cached_colorize;
+  bool cached_solid;
 
   /// Permitted/forbidden material categories.
   /// Doesn't technically need to be saved here again, as it is already
@@ -105,5 +137,8 @@ private:
 
   /// Static collection of all types.
   static boost::ptr_map<std::string, PropPrototype> collection;
+
+  /// Pointers into the collection, indexed by ID.
+  static std::vector<PropPrototype*> collection_by_id;
 };
 #endif // PROPPROTOTYPE_H
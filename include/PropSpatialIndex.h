@@ -0,0 +1,54 @@
+#ifndef PROPSPATIALINDEX_H
+#define PROPSPATIALINDEX_H
+
+#include "common_includes.h"
+#include "common_typedefs.h"
+
+/// Uniform grid of the Props sitting directly on the stage, for answering
+/// "which Props are near here?" without walking block inventories.
+/// Each cell covers 8x8 blocks on a single Z-level, so a StageChunk slab is
+/// split into a 4x4 group of cells.
+/// Props inside other Props, or in limbo, are not in the index.
+/// Like the Prop pool itself, this is not thread-safe.
+class PropSpatialIndex
+{
+public:
+  /// Construct an index covering a stage of the given size.
+  PropSpatialIndex(StageCoord3 stage_size);
+  ~PropSpatialIndex();
+
+  /// Add a Prop at a position, or move it there if it's already indexed.
+  /// Returns false if the position is outside the stage.
+  bool update(SerialNumber prop, StageCoord3 const& position);
+
+  /// Remove a Prop from the index.  Returns false if it wasn't in it.
+  bool remove(SerialNumber prop);
+
+  /// Returns true if the Prop is in the index.
+  bool contains(SerialNumber prop) const;
+
+  /// Get the number of Props in the index.
+  unsigned int get_count() const;
+
+  /// Append all Props within a box (inclusive) to the vector provided.
+  void query_box(StageCoord3 const& min_corner,
+                 StageCoord3 const& max_corner,
+                 std::vector<SerialNumber>& props) const;
+
+  /// Append all Props within a distance of a point to the vector provided.
+  void query_radius(StageCoord3 const& center,
+                    int radius,
+                    std::vector<SerialNumber>& props) const;
+
+  /// Insert, move, query and remove the requested number of dummy entries in
+  /// a scratch index, printing the time taken for each step.
+  static void benchmark(StageCoord3 stage_size, unsigned int count);
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // PROPSPATIALINDEX_H
@@ -33,6 +33,13 @@ public:
   static bool debugDieOnMinorError;
   static bool debugDieOnMajorError;
   static bool debugShowVerboseInfo;
+  static bool debugProfile;
+  static unsigned int debugBenchmarkProps;
+  static bool debugHotReload;
+  static unsigned int debugHotReloadPollMs;
+
+  static BlockLayout stageBlockLayout;
+  static bool stageSubstanceIndex;
 
   static StageCoord3 terrainSize;
   static StageCoord terrainStageHeight;
@@ -52,7 +59,16 @@ public:
   static int terrainSingleDensity;
   static bool terrainGanguePresent;
 
+  static double simulationColumnRate;
+  static double simulationColumnBudget;
+  static double simulationFluidRate;
+  static double simulationFluidBudget;
+  static unsigned int simulationMaxCatchUp;
+
+  static unsigned int jobsWorkerCount;
+
   static bool renderLoadTextures;
+  static unsigned int renderFrameRateLimit;
   static unsigned int renderGeneratedTextureSize;
 protected:
 
@@ -6,6 +6,10 @@
 
 #include "TextureFont.h"
 
+/// Bitmap font laid out as a grid of equally-sized glyphs, one per
+/// character code.  When loaded, a second copy of the grid holding each
+/// glyph's outline is added below the first, so the texture is twice as tall
+/// as the font image.
 class SimpleMatrixFont : public TextureFont
 {
   public:
@@ -20,6 +24,7 @@ class SimpleMatrixFont : public TextureFont
     void bind();
     void unbind();
     glm::vec4 getTextureCoordinates(char32_t character);
+    glm::vec4 getOutlineTextureCoordinates(char32_t character);
     glm::vec2 getGlyphSize(char32_t character);
     int32_t getXAdvance(char32_t character);
     int32_t getKerning(char32_t char1, char32_t char2);
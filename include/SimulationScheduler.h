@@ -0,0 +1,99 @@
+#ifndef SIMULATIONSCHEDULER_H
+#define SIMULATIONSCHEDULER_H
+
+#include <functional>
+
+#include "common_includes.h"
+
+/// Fixed-timestep scheduler for the systems that run while the stage is
+/// running (column maintenance, fluids, and so on).
+///
+/// Each system ticks at its own fixed rate, regardless of how often update()
+/// is called.  If update() falls behind, a system is ticked several times in
+/// a row to catch up, up to a limit; beyond that, ticks are dropped so a slow
+/// system can't snowball.  Each system has a time budget per tick, and ticks
+/// that go over it are counted as overruns.
+///
+/// Not thread-safe; call everything from the processing thread.
+class SimulationScheduler
+{
+public:
+  /// Function called to tick a system.
+  typedef std::function<void()> TickFunction;
+
+  /// Statistics for one system.
+  struct SystemStats
+  {
+    /// Name the system was registered with.
+    std::string name;
+
+    /// Ticks per second.
+    double rate;
+
+    /// Time budget per tick, in ms.
+    double budget_ms;
+
+    /// Number of ticks run.
+    unsigned int ticks;
+
+    /// Total time spent in ticks, in ms.
+    double total_ms;
+
+    /// Time taken by the most recent tick, in ms.
+    double last_ms;
+
+    /// Time taken by the slowest tick, in ms.
+    double max_ms;
+
+    /// Number of ticks that took longer than the budget.
+    unsigned int overruns;
+
+    /// Number of extra ticks run to catch up after falling behind.
+    unsigned int catch_up_ticks;
+
+    /// Number of ticks skipped because the catch-up limit was reached.
+    unsigned int dropped_ticks;
+  };
+
+  /// Constructor.
+  /// @param max_catch_up Most ticks a system may run in one update().
+  SimulationScheduler(unsigned int max_catch_up);
+  ~SimulationScheduler();
+
+  /// Register a system.  Systems tick in the order they were added.
+  /// @param name         Name used in statistics.
+  /// @param rate         Ticks per second.
+  /// @param budget_ms    Time budget per tick, in ms.
+  /// @param tick         Function to call for each tick.
+  void add_system(std::string name,
+                  double rate,
+                  double budget_ms,
+                  TickFunction tick);
+
+  /// Run any ticks that are due.
+  void update();
+
+  /// Restart timing from now, discarding any time owed to the systems.
+  /// Call this when resuming, so the time spent paused isn't caught up.
+  void reset();
+
+  /// Get how long until update() next has a tick to run.
+  /// @return Time in ms; zero if a tick is already due, or if update() hasn't
+  ///         been called since construction or reset().  Negative if there
+  ///         are no systems.
+  double get_ms_until_next_tick() const;
+
+  /// Get statistics for every system, in the order they were added.
+  std::vector<SystemStats> const& get_stats() const;
+
+  /// Print statistics for every system.
+  void report() const;
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // SIMULATIONSCHEDULER_H
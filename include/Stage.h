@@ -10,9 +10,12 @@
 
 // Forward declarations
 class ColumnData;
+class PropSpatialIndex;
 class StageBlock;
 class StageChunk;
+class StageChunkListener;
 class StageComponentVisitor;
+class SubstanceChunkIndex;
 
 /// Representation of the game playing field.
 class Stage: public EventListener, public StageComponent
@@ -56,6 +59,11 @@ public:
   /// Process stage data.
   void process(void);
 
+  /// Get how long process() can go without being called.
+  /// @return Time in ms, or a negative value if process() has nothing to do
+  ///         until an event or edit arrives.
+  double get_sleep_ms();
+
   /// Gets the initial height of a column.
   StageCoord get_column_initial_height(StageCoord x, StageCoord y);
 
@@ -85,6 +93,29 @@ public:
   bool at_edge_top(StageCoord3 const& coord) const;
   bool at_edge_bottom(StageCoord3 const& coord) const;
 
+  /// Adds a listener to be told when chunks need re-rendering.
+  /// Must not be called before build().
+  void add_chunk_listener(StageChunkListener* listener);
+
+  /// Removes a chunk listener.
+  void remove_chunk_listener(StageChunkListener* listener);
+
+  /// Gets the number of chunks in the stage.
+  int get_chunk_count() const;
+
+  /// Gets the spatial index of Props on the stage.
+  /// Must not be called before build().
+  PropSpatialIndex& get_prop_index();
+
+  /// Gets the index of which chunks each substance appears in.
+  /// @return The index, or nullptr if Settings::stageSubstanceIndex is off or
+  ///         the stage hasn't been built.
+  SubstanceChunkIndex* get_substance_index();
+
+  /// Gets a chunk by index.
+  /// Must not be called before build().
+  StageChunk& get_chunk(int chunk_index);
+
   /// Gets the StageChunk containing a particular block.
   StageChunk& get_chunk_containing(StageCoord x, StageCoord y, StageCoord z);
 
@@ -38,14 +38,24 @@ public:
   /// Get the substance a particular block layer is composed of.
   std::string get_substance(BlockLayer _layer) const;
 
+  /// Get the ID of the substance a particular block layer is composed of.
+  SubstanceID get_substance_id(BlockLayer _layer) const;
+
   /// Set the substance a particular block layer is composed of.
   void set_substance(BlockLayer layer, std::string substance);
 
+  /// Set the substance a particular block layer is composed of, by ID.
+  void set_substance(BlockLayer layer, SubstanceID substance);
+
   /// Set the substance a particular block layer is composed of, without
   /// invalidating neighboring block hidden face data.  This should speed
   /// up stage generation a LOT.
   void set_substance_quickly(BlockLayer layer, std::string substance);
 
+  /// Set the substance a particular block layer is composed of, by ID,
+  /// without invalidating neighboring block hidden face data.
+  void set_substance_quickly(BlockLayer layer, SubstanceID substance);
+
   /// Tells whether a substance is the same as another block's substance.
   bool is_same_substance_as(StageBlock& other, BlockLayer layer);
 
@@ -59,6 +69,11 @@ public:
   /// and over again.
   FaceBools get_hidden_faces(BlockLayer _layer);
 
+  /// Sets hidden face info for both solid and fluid layers from bitmasks
+  /// (bit N corresponds to FaceName N), and clears the dirty flag.
+  /// Used by StageChunk when it calculates a whole chunk at once.
+  void set_hidden_faces(uint8_t solid_mask, uint8_t fluid_mask);
+
   /// Sets the boolean indicating that hidden faces need recalculating.
   void invalidate_face_data();
 
@@ -66,6 +81,9 @@ public:
   /// Includes both solid AND fluid layers.
   bool has_any_visible_faces();
 
+  /// Returns true if hidden face data needs recalculating.
+  bool is_face_data_dirty() const;
+
   bool is_opaque(void) const;
   bool is_solid(void) const;
   bool is_traversable(void) const;
@@ -75,6 +93,30 @@ public:
   void set_known(bool _known);
   void set_known_quickly(bool _known);
 
+  /// Recalculate everything the block caches from its substances, after
+  /// their descriptors have been reloaded, and mark its chunk for
+  /// re-rendering.
+  void refresh_substances();
+
+  /// Bits summarizing the state of a block.  These are cached whenever the
+  /// block changes, so that the owning StageChunk can keep running totals
+  /// instead of scanning all of its blocks.
+  enum SummaryBits
+  {
+    SummaryOpaque = 0x01,
+    SummarySolid = 0x02,
+    SummaryVisible = 0x04,
+    SummaryKnown = 0x08,
+    SummaryVisibleFaces = 0x10
+  };
+
+  /// Get the cached summary bits for this block.
+  uint8_t get_summary() const;
+
+  /// Set the chunk that owns this block.  Called by the StageChunk
+  /// constructor; from then on the chunk is kept informed of changes.
+  void set_chunk(StageChunk* chunk);
+
 private:
   /// @note Normally this class would use a PIMPL idiom like the other classes
   ///       I've implemented.  However, due to the sheer number of StageBlocks
@@ -82,11 +124,26 @@ private:
 
   void invalidate_neighboring_faces();
 
+  /// Recalculate the summary bits that depend on the block's substances.
+  void refresh_substance_summary();
+
+  /// Set the summary bits, informing the owning chunk of the change.
+  void set_summary(uint8_t summary);
+
+  /// Set the hidden face dirty flag, informing the owning chunk of the change.
+  void set_face_data_dirty(bool dirty);
+
+  /// Chunk that owns this block.
+  StageChunk* chunk_;
+
+  /// Cached summary bits (see SummaryBits).
+  uint8_t summary_;
+
   /// Absolute coordinates for this block.
   StageCoord3 coord_;
 
   /// Materials comprising the block.
-  std::string substance_[(unsigned int) BlockLayer::Count];
+  SubstanceID substance_[(unsigned int) BlockLayer::Count];
 
   /// Booleans indicating which sides are hidden from view.
   FaceBools hidden_faces_[(unsigned int) BlockLayer::Count];
@@ -8,10 +8,13 @@
 #ifndef STAGECHUNK_H_
 #define STAGECHUNK_H_
 
+#include <atomic>
+#include <boost/dynamic_bitset.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "common.h"
 
+#include "ChunkRenderState.h"
 #include "StageBlock.h"
 #include "StageComponent.h"
 
@@ -20,7 +23,9 @@ class FaceBools;
 class Stage;
 class StageChunkCollection;
 class StageComponentVisitor;
+struct StageChunkHalo;
 class Substance;
+class SubstanceChunkIndex;
 
 /** A StageChunk is a manageable collection of blocks.  Splitting the stage into chunks
  *  allows for faster rendering and calculation when the stage contents change.
@@ -52,6 +57,9 @@ public:
    *  Coordinates correspond to the upper-back-left corner of the Chunk. */
   StageCoord3 const& get_coords() const;
 
+  // The following predicates are answered from running totals kept up to
+  // date by the blocks themselves, so they do not need to scan the chunk.
+
   /// Returns bool indicating whether this chunk is totally opaque.
   bool is_opaque(void);
 
@@ -69,36 +77,109 @@ public:
 
   /// Returns true if any faces are visible, false otherwise.
   /// Includes both solid AND fluid layers.
+  /// If any block's hidden face data is stale, it is recalculated first.
   bool has_any_visible_faces();
 
+  /// Recalculates hidden face data for every block in the chunk at once.
+  void calculate_hidden_faces();
+
+  /// Copies this chunk's block data, plus a one-block border from the
+  /// neighboring chunks and the Z-levels above and below, into a halo.
+  void capture_halo(StageChunkHalo& halo);
+
+  /// Refresh every block that has any of a set of substances in it (see
+  /// StageBlock::refresh_substances()), after they have been reloaded.
+  /// @param substances One bit per substance ID.
+  /// @return True if any block was refreshed.
+  bool refresh_substances(boost::dynamic_bitset<> const& substances);
+
+  /// Update the chunk's running totals when a block's summary bits change.
+  void update_block_summary(uint8_t old_summary, uint8_t new_summary);
+
+  /// Update the collection's substance index when one of a block's layers
+  /// changes substance.
+  void update_block_substance(SubstanceID old_id, SubstanceID new_id);
+
+  /// Update the count of blocks with stale hidden face data.
+  void update_dirty_face_count(int delta);
+
   /// Returns true if the chunk's render data needs to be recalculated AND if
   /// the stage indicates it is okay to render the map.
   bool is_render_data_dirty();
 
   /// Sets whether render data needs recalculating.
+  /// When the chunk goes from clean to dirty, the collection's listeners are
+  /// notified.
   void set_render_data_dirty(bool dirty);
 
+  /// Marks the chunk as queued for re-rendering.  Returns true if it was not
+  /// already queued; i.e. if the caller is the one who should queue it.
+  bool try_mark_queued();
+
+  /// Clears the queued flag, if the chunk couldn't be queued after all.
+  void clear_queued();
+
+  /// Clears the dirty and queued flags together, once the chunk has been
+  /// taken off the queue and before it is snapshotted for re-rendering.
+  void take_from_queue();
+
   /// The constant, hard-coded chunk side length.
   static const StageCoord chunk_side_length = 32;
 
+  /// The number of blocks in a chunk.
+  static const int blocks_per_chunk = chunk_side_length * chunk_side_length;
+
 private:
   /// @note Normally this class would use a PIMPL idiom like the other classes
   ///       I've implemented.  However, due to the sheer number of StageChunks
   ///       we deal with, I'm trying to keep complexity down to a minimum.
 
+  /// Does the work of calculate_hidden_faces(); blocks_mutex_ must be held.
+  void calculate_hidden_faces_locked();
+
+  /// Does the work of capture_halo(); blocks_mutex_ must be held.
+  void capture_halo_locked(StageChunkHalo& halo);
+
   /** Pointer to the StageChunkCollection that owns this chunk. */
   StageChunkCollection* parent_;
 
   /** Absolute coordinates of this chunk.  Constant after initialization. */
   StageCoord3 coord_;
 
+  /** Number of the chunk's blocks along X and Y that are inside the stage.
+   *  Less than chunk_side_length only for chunks on the far edges. */
+  StageCoord blocks_x_;
+  StageCoord blocks_y_;
+
   /** Index of this chunk.  Constant after initialization. */
   int index_;
 
-  /** Boolean indicating whether rendering data needs to be regenerated. */
-  bool render_data_dirty_;
+  /** The collection's substance index, or nullptr if it has none. */
+  SubstanceChunkIndex* substance_index_;
+
+  /** Whether rendering data needs to be regenerated, and whether the chunk
+   *  is on a renderer's stale queue. */
+  ChunkRenderState render_state_;
 
   /** Mutex for accessing blocks array. */
   boost::mutex blocks_mutex_;
+
+  /** Number of blocks that are opaque. */
+  std::atomic<int> opaque_count_;
+
+  /** Number of blocks that are solid. */
+  std::atomic<int> solid_count_;
+
+  /** Number of blocks that are visible. */
+  std::atomic<int> visible_count_;
+
+  /** Number of blocks that are known to the player. */
+  std::atomic<int> known_count_;
+
+  /** Number of blocks with at least one visible face. */
+  std::atomic<int> visible_face_count_;
+
+  /** Number of blocks whose hidden face data is stale. */
+  std::atomic<int> dirty_face_count_;
 };
 #endif /* STAGECHUNK_H_ */
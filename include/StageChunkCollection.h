@@ -1,6 +1,7 @@
 #ifndef STAGECHUNKCOLLECTION_H_
 #define STAGECHUNKCOLLECTION_H_
 
+#include "common_enums.h"
 #include "common_includes.h"
 #include "common_typedefs.h"
 
@@ -10,7 +11,9 @@
 class Stage;
 class StageBlock;
 class StageChunk;
+class StageChunkListener;
 class StageComponentVisitor;
+class SubstanceChunkIndex;
 
 class StageChunkCollection: StageComponent
 {
@@ -20,11 +23,36 @@ public:
 
   void accept(StageComponentVisitor& visitor);
 
+  /// Get the memory layout used for the blocks in this collection.
+  /// Block indexing is handled internally, so this is informational only.
+  BlockLayout get_layout() const;
+
+  /// Get a printable name for the memory layout used.
+  std::string get_layout_name() const;
+
+  /// Get the size of the collection, in blocks.
+  StageCoord3 const& get_size() const;
+
   /// Get the chunk containing the requested block.
   StageChunk& get_chunk_containing(StageCoord block_x,
                                  StageCoord block_y,
                                  StageCoord block_z);
 
+  /// Add a listener to be told when chunks become dirty.  Chunks that are
+  /// already dirty are reported to the new listener straight away.
+  void add_listener(StageChunkListener* listener);
+
+  /// Remove a previously added listener.  A notification already under way
+  /// on another thread may still reach the listener after this returns.
+  void remove_listener(StageChunkListener* listener);
+
+  /// Tell all listeners that a chunk has become dirty.  Takes no lock.
+  /// Called by StageChunk::set_render_data_dirty().
+  void notify_chunk_dirty(StageChunk& chunk);
+
+  /// Get the number of chunks in the collection.
+  int get_chunk_count() const;
+
   /// Get an individual chunk by index.
   StageChunk& getChunk(int chunk_index);
 
@@ -33,11 +61,17 @@ public:
                        StageCoord block_y,
                        StageCoord block_z);
 
-  /// Get a pointer to an individual block in the collection.
+  /// Get a pointer to an individual block in the collection.  The block
+  /// must be inside the stage, whatever the layout; the padding blocks that
+  /// the tiled layouts store past the edges are never valid.
   StageBlock* getBlockPointer(StageCoord block_x,
                               StageCoord block_y,
                               StageCoord block_z);
 
+  /// Get the index of which chunks each substance appears in.
+  /// @return The index, or nullptr if Settings::stageSubstanceIndex is off.
+  SubstanceChunkIndex* get_substance_index();
+
 
 private:
   struct Impl;
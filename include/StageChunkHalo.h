@@ -0,0 +1,52 @@
+#ifndef STAGECHUNKHALO_H
+#define STAGECHUNKHALO_H
+
+#include "common.h"
+
+#include "StageChunk.h"
+
+/// A private copy of the compact block data for a StageChunk plus a one-block
+/// border around it: 34x34 blocks on the chunk's own Z-level, and on the
+/// levels directly above and below.  Face calculation and meshing both work
+/// from this snapshot, so after it has been captured (see
+/// StageChunk::capture_halo) they need no locks and no lookups into
+/// neighboring chunks.
+struct StageChunkHalo
+{
+  /// Side length of a slab: the chunk plus a one-block border.
+  static const int side = StageChunk::chunk_side_length + 2;
+
+  /// Number of blocks in a slab.
+  static const int area = side * side;
+
+  /// Slab indices.
+  enum Slab
+  {
+    Below = 0, Center = 1, Above = 2, SlabCount = 3
+  };
+
+  /// Get the index within a slab of a chunk-relative block position.
+  /// (0, 0) is the chunk's corner; the border is at -1 and chunk_side_length.
+  static int index(int add_x, int add_y)
+  {
+    return ((add_y + 1) * side) + (add_x + 1);
+  }
+
+  /// Coordinates of the chunk that was captured.
+  StageCoord3 coords;
+
+  /// Solid layer substance IDs.  SUBSTANCEID_NULL outside the stage.
+  SubstanceID solid[SlabCount][area];
+
+  /// Fluid layer substance IDs.  SUBSTANCEID_NULL outside the stage.
+  SubstanceID fluid[SlabCount][area];
+
+  /// 0xFFFF if the block is opaque, 0 if not (or outside the stage).
+  /// Stored as 16 bits so it can be used directly as a SIMD mask.
+  uint16_t opaque[SlabCount][area];
+
+  /// StageBlock summary bits.  Zero outside the stage.
+  uint8_t summary[SlabCount][area];
+};
+
+#endif // STAGECHUNKHALO_H
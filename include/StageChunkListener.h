@@ -0,0 +1,20 @@
+#ifndef STAGECHUNKLISTENER_H
+#define STAGECHUNKLISTENER_H
+
+// Forward declarations
+class StageChunk;
+
+/// Base class for any class that wants to be told when StageChunks change,
+/// instead of having to visit the whole stage to find out.
+class StageChunkListener
+{
+public:
+  virtual ~StageChunkListener() {}
+
+  /// Called when a chunk's render data goes from clean to dirty.
+  /// This can be called from any thread, so implementations should do as
+  /// little as possible (e.g. queue the chunk) and must be thread-safe.
+  virtual void handle_chunk_dirty(StageChunk& chunk) = 0;
+};
+
+#endif // STAGECHUNKLISTENER_H
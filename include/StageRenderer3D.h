@@ -12,9 +12,10 @@
 #include "common_includes.h"
 #include "common_typedefs.h"
 
+#include "StageChunkListener.h"
 #include "StageRenderer.h"
 
-class StageRenderer3D: public StageRenderer
+class StageRenderer3D: public StageRenderer, public StageChunkListener
 {
 public:
   StageRenderer3D();
@@ -26,6 +27,8 @@ public:
   bool visit(StageChunk& chunk);
   bool visit(StageChunkCollection& collection);
 
+  void handle_chunk_dirty(StageChunk& chunk);
+
   void draw();
 
   EventResult handle_window_resize(int w, int h);
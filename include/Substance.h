@@ -4,6 +4,7 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <boost/dynamic_bitset.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <glm/glm.hpp>
 
@@ -14,6 +15,32 @@
 /// Forward declarations
 class SubstanceLibrary;
 
+/// Set of substance categories, indexed by CategoryID.
+typedef boost::dynamic_bitset<> CategorySet;
+
+/// Boolean properties in the substance property schema.
+/// Each schema property is looked up in a substance's descriptor once, when
+/// the substance is parsed, and kept in a typed slot; reading it afterwards
+/// is an array index instead of a walk through the property tree.  The
+/// descriptor path and default value for each entry are declared in the
+/// schema tables in Substance.cpp, which must be kept in the same order.
+enum class SubstanceBoolProperty
+{
+  IsSoil,           ///< attributes.soil
+  IsWater,          ///< attributes.water
+  Count
+};
+
+/// String properties in the substance property schema.
+enum class SubstanceStringProperty
+{
+  Name,             ///< name
+  TerrainLayer,     ///< terrain.layer
+  OreOf,            ///< attributes.ore
+  SecondaryOreOf,   ///< attributes.secondaryore
+  Count
+};
+
 /// Representation of a Substance that a StageChunk or a Prop can be made out of.
 class Substance
 {
@@ -29,6 +56,12 @@ public:
   /// Check substance information for consistency.
   void check_consistency();
 
+  /// Get a boolean property from the property schema.
+  bool get(SubstanceBoolProperty property) const;
+
+  /// Get a string property from the property schema.
+  std::string const& get(SubstanceStringProperty property) const;
+
   /// Get a string property from the substance.  Returns "" if not present.
   std::string get_string_property(std::string property) const;
 
@@ -40,6 +73,15 @@ public:
   /// present.  If default_value is not present, it defaults to false.
   bool get_bool_property(std::string property, bool default_value) const;
 
+  /// Get the set of categories this substance belongs to.  Only valid once
+  /// the SubstanceLibrary has been initialized; every substance's set is then
+  /// as large as the number of categories.
+  CategorySet const& get_categories() const;
+
+  /// Return whether this substance is in a category.
+  bool in_category(CategoryID category) const;
+
+  SubstanceID get_id() const;         ///< Get substance ID.
   Visibility get_visibility() const;  ///< Get visibility.
   SubstanceData get_data() const;   ///< Get substance data.
 
@@ -66,8 +108,35 @@ protected:
   Substance();    ///< Constructor (private)
 
   /// Load substance data from disk.
+  /// Equivalent to parse() followed by finish_load().
   bool load(std::string _name);
 
+  /// Read the substance's descriptor file, and its texture image if there is
+  /// one.  Touches nothing outside this Substance, so several substances can
+  /// be parsed at once on different threads.  Errors are kept until
+  /// report_errors() is called, rather than reported from whatever thread
+  /// this runs on.
+  /// @return True if the descriptor file was parsed.
+  bool parse(std::string _name);
+
+  /// Report, and then forget, any errors found by parse().  Call this from
+  /// the thread that owns the library.
+  void report_errors();
+
+  /// Finish loading after parse(), by adding the texture image (if any) to
+  /// the texture atlas.  Not thread-safe; substances must be finished one at
+  /// a time, in a fixed order, so atlas positions don't change between runs.
+  void finish_load();
+
+  /// Set the substance ID.  Called by the SubstanceLibrary.
+  void set_id(SubstanceID id);
+
+  /// Add the substance to a category.
+  void add_category(CategoryID category);
+
+  /// Set the size of the category set, once every category is known.
+  void resize_categories(unsigned int category_count);
+
   /// Get substance XML properties.
   boost::property_tree::ptree const& get_properties() const;
 
@@ -0,0 +1,112 @@
+#ifndef SUBSTANCECHUNKINDEX_H
+#define SUBSTANCECHUNKINDEX_H
+
+#include <cstdint>
+#include <vector>
+#include <boost/dynamic_bitset.hpp>
+
+#include "common.h"
+
+/// Reverse index from substances to the chunks they appear in, kept up to
+/// date by the blocks as they change, so that finding every chunk with a
+/// particular substance in it doesn't mean scanning every block.
+///
+/// For every substance and chunk, the index counts the block layers (solid,
+/// fluid and cover) made of that substance, and keeps one bitset per
+/// substance with a bit set for every chunk whose count isn't zero.  Counts
+/// for a substance are stored together, so totalling one up stays in cache.
+///
+/// Like the blocks themselves, the index is only changed from the thread
+/// that writes blocks, and should only be read from there.
+class SubstanceChunkIndex
+{
+public:
+  /// Constructor.  Every count starts at zero.
+  /// @param substance_count  Number of substance IDs to track.
+  /// @param chunk_count      Number of chunks on the stage.
+  SubstanceChunkIndex(unsigned int substance_count, unsigned int chunk_count);
+
+  ~SubstanceChunkIndex();
+
+  SubstanceChunkIndex(SubstanceChunkIndex const&) = delete;
+  SubstanceChunkIndex& operator=(SubstanceChunkIndex const&) = delete;
+
+  /// Record a block layer in a chunk changing from one substance to another.
+  /// Either may be SUBSTANCEID_NULL, for a layer appearing or disappearing.
+  inline void replace(unsigned int chunk_index,
+                      SubstanceID old_id,
+                      SubstanceID new_id)
+  {
+    if (old_id == new_id)
+    {
+      return;
+    }
+
+    if (old_id < substance_count_)
+    {
+      uint16_t& count = counts_[(old_id * chunk_count_) + chunk_index];
+      --count;
+      --(totals_[old_id]);
+      if (count == 0)
+      {
+        chunks_[old_id].reset(chunk_index);
+      }
+    }
+
+    if (new_id < substance_count_)
+    {
+      uint16_t& count = counts_[(new_id * chunk_count_) + chunk_index];
+      if (count == 0)
+      {
+        chunks_[new_id].set(chunk_index);
+      }
+      ++count;
+      ++(totals_[new_id]);
+    }
+  }
+
+  /// Get the number of block layers made of a substance in a chunk.
+  unsigned int get_count(unsigned int chunk_index, SubstanceID id) const;
+
+  /// Get the number of block layers made of a substance on the whole stage.
+  unsigned int get_total(SubstanceID id) const;
+
+  /// Get the chunks a substance appears in, one bit per chunk index.
+  boost::dynamic_bitset<> const& get_chunks(SubstanceID id) const;
+
+  /// Get the chunks that any of a set of substances appear in.
+  /// @param substances One bit per substance ID.
+  /// @return One bit per chunk index.
+  boost::dynamic_bitset<> get_chunks(boost::dynamic_bitset<> const& substances) const;
+
+  /// Get the number of substance IDs tracked.
+  unsigned int get_substance_count() const;
+
+  /// Get the number of chunks tracked.
+  unsigned int get_chunk_count() const;
+
+private:
+  // Deliberately not PIMPLed; replace() is called on every block write.
+
+  /// Number of substance IDs tracked.
+  unsigned int substance_count_;
+
+  /// Number of chunks tracked.
+  unsigned int chunk_count_;
+
+  /// Block layer count for every substance in every chunk, indexed by
+  /// (substance ID * chunk count) + chunk index.  A chunk has 3072 layers
+  /// at most, so 16 bits is plenty.
+  std::vector<uint16_t> counts_;
+
+  /// Block layer count for every substance across all chunks.
+  std::vector<unsigned int> totals_;
+
+  /// Chunks with a nonzero count, for every substance.
+  std::vector<boost::dynamic_bitset<> > chunks_;
+
+  /// Returned for IDs that aren't tracked.
+  boost::dynamic_bitset<> no_chunks_;
+};
+
+#endif // SUBSTANCECHUNKINDEX_H
@@ -3,7 +3,9 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <boost/property_tree/ptree.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "common.h"
 
@@ -29,6 +31,20 @@ class SubstanceLibrary
     /// If this attempt fails, return "nothing".
     SubstanceConstShPtr get(std::string name);
 
+    /// Get a pointer to a substance by ID.
+    /// If the ID is out of range, return "nothing".
+    SubstanceConstShPtr get(SubstanceID id);
+
+    /// Get the ID of the requested substance.
+    /// If the substance does not exist, return the ID of "nothing".
+    SubstanceID get_id(std::string name);
+
+    /// Get the name of a substance by ID.
+    std::string const& get_name(SubstanceID id);
+
+    /// Get the number of substances in the library.
+    unsigned int get_substance_count();
+
     /// Get the count of possible substances for a layer.
     unsigned int get_layer_substance_count(std::string name);
 
@@ -38,6 +54,44 @@ class SubstanceLibrary
     /// Return whether a substance is a part of a category.
     bool in_category(std::string name, std::string category);
 
+    /// Return whether a substance is a part of a category.
+    /// This is a single bit test.
+    bool in_category(SubstanceID id, CategoryID category);
+
+    /// Get the ID of a category.
+    /// If no substance is in the category, return CATEGORYID_NULL.
+    CategoryID get_category_id(std::string name);
+
+    /// Get the name of a category by ID.
+    std::string const& get_category_name(CategoryID id);
+
+    /// Get the number of categories.
+    unsigned int get_category_count();
+
+    /// Get every substance that is in all of a set of categories, in ID
+    /// order.  The set must be get_category_count() bits long.
+    std::vector<SubstanceID> get_substances_in(CategorySet const& categories);
+
+    /// Get every substance that is in all of the named categories, in ID
+    /// order; for example, {"granular", "soluble"}.
+    std::vector<SubstanceID> get_substances_in(std::vector<std::string> const& categories);
+
+    /// Re-read the descriptors of existing substances, so that edits to them
+    /// take effect without restarting.  Each substance keeps its ID, and
+    /// only its own entries in the library's tables are rebuilt.  Names of
+    /// substances the library doesn't already have are skipped; adding or
+    /// removing a substance still needs a restart.  Descriptors are read
+    /// through the DescriptorDatabase, which must be closed first if it was
+    /// compiled before the edits.
+    /// @return IDs of the substances that were reloaded.
+    std::vector<SubstanceID> reload(std::vector<std::string> const& names);
+
+    /// Get the mutex held by reload() while it swaps substances in, and by
+    /// PropPrototype::reload() while it swaps a prop type in.  Code on
+    /// another thread that looks up a lot of substances or prop types in one
+    /// go, such as chunk meshing, should hold it for the duration.
+    boost::mutex& get_reload_mutex();
+
   protected:
 
   private:
@@ -0,0 +1,82 @@
+#ifndef TEXTLAYOUT_H
+#define TEXTLAYOUT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "common.h"
+
+// Forward declarations
+class TextureFont;
+
+/// A string laid out in a particular font: one positioned quad per glyph,
+/// ready to be copied into vertex data.
+struct TextLayout
+{
+  /// A single glyph.
+  struct Quad
+  {
+    /// Top-left corner, relative to the start of the text, in pixels.
+    glm::vec2 position;
+
+    /// Size of the glyph, in pixels.
+    glm::vec2 size;
+
+    /// Texture coordinates of the glyph (s, t, width, height).
+    glm::vec4 texture_coords;
+
+    /// Texture coordinates of the glyph's outline (s, t, width, height).
+    glm::vec4 outline_texture_coords;
+  };
+
+  /// Lay out a string.
+  /// @param font       Font to use.
+  /// @param wrap_width Width at which to wrap onto a new line, in pixels.
+  /// @param text       Text to lay out.
+  TextLayout(TextureFont& font, float wrap_width, std::u32string const& text);
+
+  /// Glyphs, in the order of the text.
+  std::vector<Quad> quads;
+};
+
+/// Cache of text layouts, keyed by font, wrap width and text, so that text
+/// that doesn't change isn't laid out again every time the GUI is rebuilt.
+/// The least recently used layouts are dropped once the cache is full.
+/// Layouts are handed out as shared pointers, so one that is dropped stays
+/// valid for as long as anything holds on to it.
+class TextLayoutCache
+{
+public:
+  /// Constructor.
+  /// @param capacity Number of layouts to keep.
+  TextLayoutCache(unsigned int capacity = 256);
+
+  ~TextLayoutCache();
+
+  TextLayoutCache(TextLayoutCache const&) = delete;
+  TextLayoutCache& operator=(TextLayoutCache const&) = delete;
+
+  /// Get the layout of a string, laying it out if it isn't in the cache.
+  std::shared_ptr<TextLayout const> get(TextureFont& font,
+                                        float wrap_width,
+                                        std::u32string const& text);
+
+  /// Drop every layout that uses a font; call this if the font changes.
+  void forget(TextureFont& font);
+
+  /// Get the number of lookups that found a layout in the cache.
+  unsigned int get_hit_count() const;
+
+  /// Get the number of lookups that had to lay text out.
+  unsigned int get_miss_count() const;
+
+protected:
+private:
+  struct Impl;
+  /// Private implementation pointer
+  std::unique_ptr<Impl> impl;
+};
+
+#endif // TEXTLAYOUT_H
@@ -2,25 +2,52 @@
 #define TEXTUREATLAS_H
 
 #include <boost/container/flat_map.hpp>
-#include <boost/dynamic_bitset.hpp>
+#include <boost/thread/mutex.hpp>
 #include <memory>
 #include <SFML/Graphics.hpp>
 
 #include "common.h"
 
+// Forward declarations
+class AtlasBuilder;
+
 /// Singleton "atlas" texture containing all graphical textures used in the engine.
+///
+/// Images are packed into a copy of the atlas in main memory (see
+/// AtlasBuilder), and the whole atlas is uploaded to the graphics card in
+/// one go the next time the texture is asked for.  If the AtlasBaker tool
+/// has baked an atlas into data/atlas.png and data/atlas.xml, it is loaded
+/// at startup, and any image in it whose file hasn't changed needn't be
+/// read or packed at all.
 class TextureAtlas
 {
 public:
   static TextureAtlas* instance();
 
-  /// Save a texture into the atlas.
-  SerialNumber save(sf::Image& image);
+  ~TextureAtlas();
+
+  /// Save a texture into the atlas.  If an image was saved under the same
+  /// name before, e.g. because its file has been edited, the new one goes
+  /// in the old one's place if it is the same size; if not, it is packed
+  /// separately, and if there is no room for it the old image is kept.
+  /// @param image  Image to save.
+  /// @param name   Path of the file the image was read from, if any.
+  SerialNumber save(sf::Image& image, std::string const& name = "");
+
+  /// Return whether the baked atlas has an up-to-date copy of an image file.
+  /// Safe to call from several threads at once, as long as nothing is being
+  /// saved at the same time.
+  bool hasBaked(std::string const& name);
+
+  /// Get a serial number for an image file in the baked atlas.
+  /// @see hasBaked()
+  SerialNumber useBaked(std::string const& name);
 
   /// Get the coordinates corresponding to a particular texture.
   sf::IntRect const& getRect(SerialNumber texNumber);
 
-  /// Get the atlas texture.
+  /// Get the atlas texture, first uploading it if anything has been saved
+  /// since the last upload.
   sf::Texture const* getAtlasTexture(void);
 
 protected:
@@ -29,23 +56,14 @@ private:
 
   static std::unique_ptr<TextureAtlas> instance_;
 
-  /// Locate a free spot in the texture to place an image.
-  bool findNextSpot(sf::Vector2u& origin, sf::Vector2u const& imageBlocks);
+  /// Copy of the atlas in main memory, and the packer.
+  std::unique_ptr<AtlasBuilder> builder;
 
-  /// Mark a spot in the texture as reserved.
-  void reserveSpot(sf::Vector2u const& origin,
-                   sf::Vector2u const& imageBlocks);
+  /// True if the atlas has changed since it was last uploaded.
+  bool dirty;
 
-  inline unsigned int get_block(unsigned int x, unsigned int y)
-  {
-    return (y * maxBlocks) + x;
-  }
-
-  /// Number of blocks.  Each block is 16x16 (by default) in size.
-  unsigned int maxBlocks;
-
-  /// Bitset indicating which blocks are in use.
-  boost::dynamic_bitset<> used;
+  /// Protects everything above, and texRect.
+  boost::mutex mutex;
 
   /// Big texture stored on the graphics card.
   sf::Texture atlas;
@@ -62,11 +80,12 @@ public:
 
   // === Static private members =============================================
 private:
-  /// Size of blocks, as a power of 2.
-  /// Larger blocks will let the placer algorithm run faster but results
-  /// in less efficient packing of images; smaller blocks make the placer
-  /// algorithm take longer to find a suitable place.
-  static unsigned int const blockSize = 4;
+  /// Width of the atlas, in pixels, if the graphics card allows it.  The
+  /// height grows as images are added.
+  static unsigned int const atlasWidth = 2048;
+
+  /// Size of the blank texture, in pixels.
+  static unsigned int const blankSize = 16;
 };
 
 #define TAtlas TextureAtlas::instance()
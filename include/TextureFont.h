@@ -38,6 +38,14 @@ class TextureFont
     /// @return A vec4 containing the s/t/p/q coordinates of the texture.
     virtual glm::vec4 getTextureCoordinates(char32_t character) = 0;
 
+    /// Gets the texture coordinates of a character's outline: its glyph
+    /// grown by one pixel in each direction, worked out when the font is
+    /// loaded.  Drawing the outline in a dark color under the glyph makes
+    /// text readable over anything.
+    /// @param character Character to find.
+    /// @return A vec4 containing the s/t/p/q coordinates of the texture.
+    virtual glm::vec4 getOutlineTextureCoordinates(char32_t character) = 0;
+
     /// Gets the size of a character glyph, in pixels.
     /// @param character Character to find.
     /// @return A vec2 containing the x/y size of the glyph, in pixels.
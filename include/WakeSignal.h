@@ -0,0 +1,38 @@
+#ifndef WAKESIGNAL_H
+#define WAKESIGNAL_H
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/// Lets a thread sleep until another thread has something for it to do.
+///
+/// A notify() that arrives while nobody is waiting is remembered, so the next
+/// wait() returns straight away; a wakeup can't be lost between a thread
+/// deciding it is idle and going to sleep.
+class WakeSignal
+{
+public:
+  WakeSignal();
+  ~WakeSignal();
+
+  WakeSignal(WakeSignal const&) = delete;
+  WakeSignal& operator=(WakeSignal const&) = delete;
+
+  /// Wake the waiting thread, or the next one to wait.
+  void notify();
+
+  /// Sleep until notified, or until a timeout expires.
+  /// @param timeout_ms Longest time to sleep, in ms.  If negative, sleep
+  ///                   until notified.
+  /// @return True if notified, false if the timeout expired.
+  bool wait(double timeout_ms);
+
+private:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+
+  /// True if notify() has been called since the last wait() returned.
+  bool pending_;
+};
+
+#endif // WAKESIGNAL_H
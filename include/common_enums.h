@@ -7,6 +7,15 @@ enum class BlockLayer
   Solid, Fluid, Cover, Count
 };
 
+/// Enumeration of the ways StageBlocks can be laid out in memory.
+/// "Linear" is a plain Z-major, row-major array covering the whole stage.
+/// "Tiled" stores each 32x32 chunk slab contiguously, row-major inside.
+/// "Morton" stores each chunk slab contiguously in Z-order inside.
+enum class BlockLayout
+{
+  Linear, Tiled, Morton, MemberCount
+};
+
 enum class Octant
 {
   BottomBackLeft,
@@ -98,6 +98,21 @@ struct StageCoord3
 /// Typedef to indicate that a value should be interpreted as a percentage.
 typedef double Percentage;
 
+/// Dense numeric ID assigned to each Substance when the SubstanceLibrary is
+/// initialized.  IDs run from zero to (substance count - 1), in name order.
+typedef unsigned short SubstanceID;
+const SubstanceID SUBSTANCEID_NULL = (SubstanceID) (-1);
+
+/// Dense numeric ID assigned to each substance category by the
+/// SubstanceLibrary, in the order categories are first seen.
+typedef unsigned short CategoryID;
+const CategoryID CATEGORYID_NULL = (CategoryID) (-1);
+
+/// Dense numeric ID assigned to each PropPrototype when the prototypes are
+/// loaded.  "anomaly" is always 0.
+typedef unsigned short PropPrototypeID;
+const PropPrototypeID PROPPROTOTYPEID_NULL = (PropPrototypeID) (-1);
+
 /// "SerialNumber" typedef used for enumerating tangible objects.
 /// An int will allow for a total of 4,294,967,295 Props before
 /// we run out of numbers.  I HOPE this is sufficient.  If not, we'll
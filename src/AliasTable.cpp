@@ -0,0 +1,115 @@
+#include "AliasTable.h"
+
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+AliasTable::AliasTable()
+{
+}
+
+AliasTable::AliasTable(std::vector<double> const& weights)
+{
+  build(weights);
+}
+
+AliasTable::~AliasTable()
+{
+}
+
+void AliasTable::build(std::vector<double> const& weights)
+{
+  unsigned int count = weights.size();
+
+  probability_.clear();
+  alias_.clear();
+
+  double total = 0;
+  for (double weight : weights)
+  {
+    total += weight;
+  }
+
+  if ((count == 0) || (total <= 0))
+  {
+    return;
+  }
+
+  probability_.resize(count);
+  alias_.resize(count);
+
+  // Scale the weights so they average 1, and split the columns into those
+  // below and above average.
+  std::vector<double> scaled(count);
+  std::vector<unsigned int> small;
+  std::vector<unsigned int> large;
+
+  for (unsigned int index = 0; index < count; ++index)
+  {
+    scaled[index] = weights[index] * count / total;
+    if (scaled[index] < 1)
+    {
+      small.push_back(index);
+    }
+    else
+    {
+      large.push_back(index);
+    }
+  }
+
+  // Top each small column up to 1 from a large one.
+  while (!small.empty() && !large.empty())
+  {
+    unsigned int less = small.back();
+    unsigned int more = large.back();
+    small.pop_back();
+
+    probability_[less] = scaled[less];
+    alias_[less] = more;
+
+    scaled[more] -= (1 - scaled[less]);
+    if (scaled[more] < 1)
+    {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+
+  // Whatever is left is full, give or take rounding error.
+  for (unsigned int index : large)
+  {
+    probability_[index] = 1;
+    alias_[index] = index;
+  }
+  for (unsigned int index : small)
+  {
+    probability_[index] = 1;
+    alias_[index] = index;
+  }
+}
+
+bool AliasTable::empty() const
+{
+  return probability_.empty();
+}
+
+unsigned int AliasTable::size() const
+{
+  return probability_.size();
+}
+
+unsigned int AliasTable::pick(boost::random::mt19937& twister) const
+{
+  boost::random::uniform_int_distribution<unsigned int>
+    column_distribution(0, probability_.size() - 1);
+  boost::random::uniform_real_distribution<double> chance_distribution(0, 1);
+
+  unsigned int column = column_distribution(twister);
+  if (chance_distribution(twister) < probability_[column])
+  {
+    return column;
+  }
+  else
+  {
+    return alias_[column];
+  }
+}
@@ -5,9 +5,12 @@
 
 #include "AppStateManager.h"
 #include "BGRenderer3D.h"
+#include "DescriptorDatabase.h"
 #include "GUI.h"
 #include "GUIRenderer3D.h"
 #include "MenuArea.h"
+#include "Prop.h"
+#include "PropSpatialIndex.h"
 #include "PropPrototype.h"
 #include "Settings.h"
 #include "Stage.h"
@@ -35,6 +38,9 @@ const unsigned int AppStateGame::Impl::menu_bar_width = 250;
 AppStateGame::AppStateGame(AppStateManager* manager)
   : AppState(manager), impl(new Impl())
 {
+  // Use the compiled descriptor database if it's up to date.
+  DescriptorDatabase::instance()->open("data", "data/descriptors.db");
+
   Verb::initialize();                 // verb dictionary
 
   // Create and initialize the substance library.
@@ -42,6 +48,13 @@ AppStateGame::AppStateGame(AppStateManager* manager)
 
   PropPrototype::initialize();        // prop prototypes
 
+  if (Settings::debugBenchmarkProps > 0)
+  {
+    Prop::benchmark(Settings::debugBenchmarkProps);
+    PropSpatialIndex::benchmark(Settings::terrainSize,
+                                Settings::debugBenchmarkProps);
+  }
+
   impl->gui.reset(new GUI());
 
   // Create the status area.
@@ -119,6 +132,11 @@ void AppStateGame::process()
   Stage::get_instance()->process();
 }
 
+double AppStateGame::get_sleep_ms()
+{
+  return Stage::get_instance()->get_sleep_ms();
+}
+
 void AppStateGame::render()
 {
   if (impl->bg_renderer.get() == nullptr)
@@ -139,10 +157,8 @@ void AppStateGame::render()
 
   if (Stage::get_instance()->okay_to_render_map())
   {
-    // Tell renderer to visit the stage to create the vertex array.
-    Stage::get_instance()->accept(*(impl->stage_renderer));
-
-    // Render stage.
+    // Render stage.  The renderer is told about changed chunks as they
+    // happen, so there's no need to visit the stage first.
     impl->stage_renderer->draw();
   }
 
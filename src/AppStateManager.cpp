@@ -54,6 +54,18 @@ void AppStateManager::process()
   }
 }
 
+double AppStateManager::get_sleep_ms()
+{
+  if (impl->activeAppState != AppStateID::None)
+  {
+    return impl->appStates.at(impl->activeAppState).get_sleep_ms();
+  }
+  else
+  {
+    return -1;
+  }
+}
+
 void AppStateManager::render()
 {
   if (impl->activeAppState != AppStateID::None)
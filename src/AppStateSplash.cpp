@@ -40,6 +40,12 @@ void AppStateSplash::process()
   }
 }
 
+double AppStateSplash::get_sleep_ms()
+{
+  double remaining_ms = 1000.0 - clock.getElapsedTime().asMilliseconds();
+  return (remaining_ms > 0) ? remaining_ms : 0;
+}
+
 void AppStateSplash::render()
 {
   // TODO: rewrite to use 2D shader program instead.
@@ -10,7 +10,9 @@
 
 #include "ErrorMacros.h"
 #include "FPSControl.h"
+#include "JobSystem.h"
 #include "Settings.h"
+#include "WakeSignal.h"
 
 struct App::Impl
 {
@@ -35,11 +37,17 @@ struct App::Impl
   /// Font collection
   std::unique_ptr<FontCollection> font_collection_;
 
+  /// Worker threads shared by everything that runs jobs in parallel.
+  std::unique_ptr<JobSystem> jobs_;
+
   /// Frame timer for rendering thread.
   FrequencyControl frame_timer_;
 
   /// Timer for processing thread.
   FrequencyControl process_timer_;
+
+  /// Wakes the processing thread when it is sleeping.
+  WakeSignal process_wake_;
 };
 
 std::unique_ptr<App> App::Impl::instance_;
@@ -61,6 +69,9 @@ App::App()
   // Create the font collection.
   impl->font_collection_.reset(new FontCollection());
 
+  // Start the job system.
+  impl->jobs_.reset(new JobSystem(Settings::jobsWorkerCount));
+
 }
 
 App::~App()
@@ -90,13 +101,10 @@ void App::execute()
   std::cout << "Starting rendering thread..." << std::endl;
   boost::thread rendering_thread(&App::render, this);
 
-  while (!(impl->halt_program_))
+  // Block until events arrive, rather than spinning on pollEvent.
+  while (!(impl->halt_program_) && impl->window_->waitEvent(event))
   {
-    while (impl->window_->pollEvent(event))
-    {
-      handle_event(event);
-    }
-    boost::thread::yield();
+    handle_event(event);
   }
 
   // Join the rendering thread until it quits.
@@ -107,6 +115,11 @@ void App::execute()
 
   // Set the app state manager to none (which will clean up the last state).
   impl->state_manager_->SetActiveAppState(AppStateID::None);
+
+  if (Settings::debugProfile)
+  {
+    impl->jobs_->report();
+  }
 }
 
 void App::process()
@@ -117,7 +130,14 @@ void App::process()
   {
     impl->process_timer_.loop();
     impl->state_manager_->process();
-    boost::thread::yield();
+
+    // Sleep until the active state has more work to do, or something wakes
+    // us up.
+    double sleep_ms = impl->state_manager_->get_sleep_ms();
+    if (sleep_ms != 0)
+    {
+      impl->process_wake_.wait(sleep_ms);
+    }
   }
   std::cout << "Processing thread terminating." << std::endl;
 }
@@ -131,6 +151,9 @@ void App::render()
 
   window.setActive(true);
 
+  // Let display() sleep between frames instead of spinning.
+  window.setFramerateLimit(Settings::renderFrameRateLimit);
+
   // Initialize GLEW.
   GLenum err = glewInit();
   if (err != GLEW_OK)
@@ -170,8 +193,6 @@ void App::render()
     impl->state_manager_->render();
     impl->window_->setTitle(buffer);
     impl->window_->display();
-
-    boost::thread::yield();
   }
 
   std::cout << "Rendering thread terminating." << std::endl;
@@ -186,12 +207,18 @@ EventResult App::handle_event(const sf::Event& event)
   {
     result = impl->state_manager_->handle_event(event);
   }
+
+  // Whoever handled the event may have left work for the processing thread.
+  if (result == EventResult::Handled)
+  {
+    wake();
+  }
   return result;
 }
 
 EventResult App::handle_window_exit()
 {
-  impl->halt_program_ = true;
+  halt();
   return EventResult::Handled;
 }
 
@@ -208,6 +235,12 @@ boost::random::mt19937& App::twister()
 void App::halt()
 {
   impl->halt_program_ = true;
+  wake();
+}
+
+void App::wake()
+{
+  impl->process_wake_.notify();
 }
 
 bool App::isRunning()
@@ -236,11 +269,16 @@ FontCollection& App::get_fonts()
   return *(impl->font_collection_.get());
 }
 
+JobSystem& App::get_jobs()
+{
+  return *(impl->jobs_.get());
+}
+
 EventResult App::handle_key_down(sf::Event::KeyEvent key)
 {
   if (key.code == sf::Keyboard::Escape)
   {
-    impl->halt_program_ = true;
+    halt();
     return EventResult::Handled;
   }
   return EventResult::Ignored;
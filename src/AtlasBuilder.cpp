@@ -0,0 +1,522 @@
+#include "AtlasBuilder.h"
+
+#include <algorithm>
+#include <ctime>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "ProfileTimer.h"
+
+struct AtlasBuilder::Impl
+{
+  /// Flat piece of the skyline.
+  struct Segment
+  {
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+  };
+
+  /// A named image, and the file it came from.
+  struct Entry
+  {
+    sf::IntRect rect;
+    uintmax_t size;
+    std::time_t modified;
+  };
+
+  Impl(unsigned int width_, unsigned int max_height_)
+    : width(width_), max_height(max_height_)
+  {
+    reset();
+  }
+
+  /// Empty the atlas.
+  void reset()
+  {
+    Segment floor = { 0, 0, width };
+    skyline.assign(1, floor);
+    entries.clear();
+    image = sf::Image();
+    image_height = 0;
+    used_height = 0;
+    image_count = 0;
+    image_area = 0;
+    packing_ms = 0;
+  }
+
+  /// Get the size and modification time of a file, or zeroes if the name
+  /// isn't a file.
+  static void get_stamp(std::string const& name,
+                        uintmax_t& size,
+                        std::time_t& modified)
+  {
+    boost::system::error_code error;
+    size = 0;
+    modified = 0;
+
+    if (!name.empty() && boost::filesystem::is_regular_file(name, error))
+    {
+      size = boost::filesystem::file_size(name, error);
+      modified = boost::filesystem::last_write_time(name, error);
+    }
+  }
+
+  /// Find the lowest spot along the skyline where an image fits.
+  /// @param index  Set to the segment the image's left edge goes on.
+  /// @param y      Set to the top of the spot.
+  /// @return False if there is no room.
+  bool find_spot(unsigned int w, unsigned int h, size_t& index, unsigned int& y)
+  {
+    bool found = false;
+    unsigned int best_bottom = 0;
+
+    for (size_t first = 0; first < skyline.size(); ++first)
+    {
+      if (skyline[first].x + w > width)
+      {
+        break;
+      }
+
+      // The image rests on the highest segment under it.
+      unsigned int top = 0;
+      unsigned int remaining = w;
+      for (size_t segment = first; remaining > 0; ++segment)
+      {
+        top = std::max(top, skyline[segment].y);
+        remaining -= std::min(remaining, skyline[segment].width);
+      }
+
+      if ((top + h <= max_height) && (!found || (top + h < best_bottom)))
+      {
+        found = true;
+        best_bottom = top + h;
+        index = first;
+        y = top;
+      }
+    }
+
+    return found;
+  }
+
+  /// Raise the skyline over an image placed at a spot from find_spot().
+  void place(size_t index, unsigned int y, unsigned int w, unsigned int h)
+  {
+    Segment raised = { skyline[index].x, y + h, w };
+    unsigned int right = raised.x + w;
+
+    // Drop or trim the segments the image covers.
+    while ((index < skyline.size()) && (skyline[index].x < right))
+    {
+      unsigned int segment_right = skyline[index].x + skyline[index].width;
+      if (segment_right <= right)
+      {
+        skyline.erase(skyline.begin() + index);
+      }
+      else
+      {
+        skyline[index].width = segment_right - right;
+        skyline[index].x = right;
+        break;
+      }
+    }
+
+    skyline.insert(skyline.begin() + index, raised);
+
+    // Merge neighbors at the same height.
+    for (size_t segment = 0; segment + 1 < skyline.size(); )
+    {
+      if (skyline[segment].y == skyline[segment + 1].y)
+      {
+        skyline[segment].width += skyline[segment + 1].width;
+        skyline.erase(skyline.begin() + segment + 1);
+      }
+      else
+      {
+        ++segment;
+      }
+    }
+  }
+
+  /// Make the atlas image at least a certain height, rounding up to a power
+  /// of two.
+  void grow(unsigned int height)
+  {
+    if (height <= image_height)
+    {
+      return;
+    }
+
+    unsigned int new_height = 1;
+    while (new_height < height)
+    {
+      new_height <<= 1;
+    }
+    new_height = std::min(new_height, max_height);
+
+    sf::Image grown;
+    grown.create(width, new_height, sf::Color(0, 0, 0, 0));
+    if (image_height != 0)
+    {
+      grown.copy(image, 0, 0);
+    }
+    image = grown;
+    image_height = new_height;
+  }
+
+  /// Width of the atlas.
+  unsigned int width;
+
+  /// Largest height the atlas may grow to.
+  unsigned int max_height;
+
+  /// Skyline, left to right.  The segments always cover the full width.
+  std::vector<Segment> skyline;
+
+  /// Named images.
+  std::map<std::string, Entry> entries;
+
+  /// The atlas itself.
+  sf::Image image;
+
+  /// Height of the atlas image.
+  unsigned int image_height;
+
+  /// Height of the part of the atlas that has anything in it.
+  unsigned int used_height;
+
+  /// Number of images added, named or not.
+  unsigned int image_count;
+
+  /// Total area of the images added.
+  uint64_t image_area;
+
+  /// Total time spent in add().
+  double packing_ms;
+};
+
+AtlasBuilder::AtlasBuilder(unsigned int width, unsigned int max_height)
+  : impl(new Impl(width, max_height))
+{
+}
+
+AtlasBuilder::~AtlasBuilder()
+{
+}
+
+bool AtlasBuilder::add(sf::Image const& image,
+                       std::string const& name,
+                       sf::IntRect& rect)
+{
+  ProfileTimer timer;
+
+  unsigned int w = image.getSize().x;
+  unsigned int h = image.getSize().y;
+  size_t index = 0;
+  unsigned int y = 0;
+
+  if ((w == 0) || (h == 0))
+  {
+    rect = sf::IntRect(0, 0, 0, 0);
+  }
+  else
+  {
+    if ((w > impl->width) || !impl->find_spot(w, h, index, y))
+    {
+      return false;
+    }
+
+    unsigned int x = impl->skyline[index].x;
+    impl->place(index, y, w, h);
+    impl->grow(y + h);
+    impl->image.copy(image, x, y);
+    impl->used_height = std::max(impl->used_height, y + h);
+
+    rect = sf::IntRect(x, y, w, h);
+  }
+
+  if (!name.empty())
+  {
+    Impl::Entry& entry = impl->entries[name];
+    entry.rect = rect;
+    Impl::get_stamp(name, entry.size, entry.modified);
+  }
+
+  ++(impl->image_count);
+  impl->image_area += (uint64_t) w * h;
+  impl->packing_ms += timer.get_elapsed_ms();
+
+  return true;
+}
+
+bool AtlasBuilder::find(std::string const& name, sf::IntRect& rect) const
+{
+  auto iter = impl->entries.find(name);
+  if (iter == impl->entries.end())
+  {
+    return false;
+  }
+
+  uintmax_t size;
+  std::time_t modified;
+  Impl::get_stamp(name, size, modified);
+  if ((size != iter->second.size) || (modified != iter->second.modified))
+  {
+    return false;
+  }
+
+  rect = iter->second.rect;
+  return true;
+}
+
+bool AtlasBuilder::find_any_version(std::string const& name,
+                                    sf::IntRect& rect) const
+{
+  auto iter = impl->entries.find(name);
+  if (iter == impl->entries.end())
+  {
+    return false;
+  }
+
+  rect = iter->second.rect;
+  return true;
+}
+
+bool AtlasBuilder::replace(sf::Image const& image,
+                           std::string const& name,
+                           sf::IntRect& rect)
+{
+  ProfileTimer timer;
+
+  auto iter = impl->entries.find(name);
+  if ((iter == impl->entries.end()) ||
+      (image.getSize().x != (unsigned int) iter->second.rect.width) ||
+      (image.getSize().y != (unsigned int) iter->second.rect.height))
+  {
+    return false;
+  }
+
+  Impl::Entry& entry = iter->second;
+  if ((entry.rect.width != 0) && (entry.rect.height != 0))
+  {
+    impl->image.copy(image, entry.rect.left, entry.rect.top);
+  }
+  Impl::get_stamp(name, entry.size, entry.modified);
+
+  rect = entry.rect;
+  impl->packing_ms += timer.get_elapsed_ms();
+
+  return true;
+}
+
+sf::Image const& AtlasBuilder::get_image() const
+{
+  return impl->image;
+}
+
+unsigned int AtlasBuilder::get_width() const
+{
+  return impl->width;
+}
+
+unsigned int AtlasBuilder::get_used_height() const
+{
+  return impl->used_height;
+}
+
+unsigned int AtlasBuilder::get_image_count() const
+{
+  return impl->image_count;
+}
+
+double AtlasBuilder::get_efficiency() const
+{
+  if (impl->used_height == 0)
+  {
+    return 0;
+  }
+
+  return (double) impl->image_area /
+         ((double) impl->width * impl->used_height);
+}
+
+double AtlasBuilder::get_packing_ms() const
+{
+  return impl->packing_ms;
+}
+
+bool AtlasBuilder::bake(std::string const& image_path,
+                        std::string const& table_path) const
+{
+  if (impl->used_height == 0)
+  {
+    std::cout << "Texture atlas is empty; nothing to bake." << std::endl;
+    return false;
+  }
+
+  // Only the used part of the atlas is written.
+  sf::Image cropped;
+  cropped.create(impl->width, impl->used_height);
+  cropped.copy(impl->image, 0, 0,
+               sf::IntRect(0, 0, impl->width, impl->used_height));
+
+  if (!cropped.saveToFile(image_path))
+  {
+    std::cout << "Can't write texture atlas image \"" << image_path << "\"."
+              << std::endl;
+    return false;
+  }
+
+  boost::property_tree::ptree table;
+  table.put("atlas.<xmlattr>.width", impl->width);
+  table.put("atlas.<xmlattr>.height", impl->used_height);
+  table.put("atlas.<xmlattr>.imagecount", impl->image_count);
+  table.put("atlas.<xmlattr>.imagearea", impl->image_area);
+
+  for (Impl::Segment const& segment : impl->skyline)
+  {
+    boost::property_tree::ptree& node = table.add("atlas.skyline.segment", "");
+    node.put("<xmlattr>.x", segment.x);
+    node.put("<xmlattr>.y", segment.y);
+    node.put("<xmlattr>.width", segment.width);
+  }
+
+  for (auto const& entry : impl->entries)
+  {
+    boost::property_tree::ptree& node = table.add("atlas.images.image", "");
+    node.put("<xmlattr>.name", entry.first);
+    node.put("<xmlattr>.x", entry.second.rect.left);
+    node.put("<xmlattr>.y", entry.second.rect.top);
+    node.put("<xmlattr>.width", entry.second.rect.width);
+    node.put("<xmlattr>.height", entry.second.rect.height);
+    node.put("<xmlattr>.size", entry.second.size);
+    node.put("<xmlattr>.modified", (int64_t) entry.second.modified);
+  }
+
+  try
+  {
+    boost::property_tree::write_xml(table_path, table);
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "Can't write texture atlas table \"" << table_path << "\": "
+              << e.what() << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool AtlasBuilder::load(std::string const& image_path,
+                        std::string const& table_path)
+{
+  impl->reset();
+
+  if (!boost::filesystem::exists(table_path) ||
+      !boost::filesystem::exists(image_path))
+  {
+    std::cout << "No baked texture atlas found." << std::endl;
+    return false;
+  }
+
+  boost::property_tree::ptree table;
+  sf::Image baked;
+  unsigned int height;
+
+  try
+  {
+    boost::property_tree::read_xml(table_path, table);
+
+    unsigned int width = table.get<unsigned int>("atlas.<xmlattr>.width");
+    height = table.get<unsigned int>("atlas.<xmlattr>.height");
+
+    if ((width != impl->width) || (height > impl->max_height))
+    {
+      std::cout << "Baked texture atlas is " << width << "x" << height
+                << "; need a width of " << impl->width
+                << " and a height of at most " << impl->max_height
+                << ", ignoring it." << std::endl;
+      return false;
+    }
+
+    if (!baked.loadFromFile(image_path) ||
+        (baked.getSize().x != width) || (baked.getSize().y != height))
+    {
+      std::cout << "Baked texture atlas image doesn't match its table, "
+                << "ignoring it." << std::endl;
+      return false;
+    }
+
+    std::vector<Impl::Segment> skyline;
+    unsigned int covered = 0;
+    for (auto const& v : table.get_child("atlas.skyline"))
+    {
+      if (v.first != "segment")
+      {
+        continue;
+      }
+
+      Impl::Segment segment;
+      segment.x = v.second.get<unsigned int>("<xmlattr>.x");
+      segment.y = v.second.get<unsigned int>("<xmlattr>.y");
+      segment.width = v.second.get<unsigned int>("<xmlattr>.width");
+
+      if ((segment.x != covered) || (segment.y > height))
+      {
+        covered = 0;
+        break;
+      }
+      covered += segment.width;
+      skyline.push_back(segment);
+    }
+
+    if (covered != width)
+    {
+      std::cout << "Baked texture atlas has a broken skyline, ignoring it."
+                << std::endl;
+      return false;
+    }
+
+    std::map<std::string, Impl::Entry> entries;
+    for (auto const& v : table.get_child("atlas.images"))
+    {
+      if (v.first != "image")
+      {
+        continue;
+      }
+
+      Impl::Entry entry;
+      entry.rect.left = v.second.get<int>("<xmlattr>.x");
+      entry.rect.top = v.second.get<int>("<xmlattr>.y");
+      entry.rect.width = v.second.get<int>("<xmlattr>.width");
+      entry.rect.height = v.second.get<int>("<xmlattr>.height");
+      entry.size = v.second.get<uintmax_t>("<xmlattr>.size");
+      entry.modified =
+        (std::time_t) v.second.get<int64_t>("<xmlattr>.modified");
+      entries[v.second.get<std::string>("<xmlattr>.name")] = entry;
+    }
+
+    impl->skyline = skyline;
+    impl->entries = entries;
+    impl->image_count = table.get<unsigned int>("atlas.<xmlattr>.imagecount",
+                                                entries.size());
+    impl->image_area = table.get<uint64_t>("atlas.<xmlattr>.imagearea", 0);
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "Can't read baked texture atlas: " << e.what() << std::endl;
+    impl->reset();
+    return false;
+  }
+
+  impl->grow(height);
+  impl->image.copy(baked, 0, 0);
+  impl->used_height = height;
+
+  return true;
+}
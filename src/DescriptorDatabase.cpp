@@ -0,0 +1,746 @@
+#include "DescriptorDatabase.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "ErrorMacros.h"
+
+namespace
+{
+  /// Bump this whenever the file layout changes.
+  const uint32_t format_version = 1;
+
+  /// Written as-is, so a file from a machine with different byte order is
+  /// recognized and ignored.
+  const uint32_t byte_order_mark = 0x01020304;
+
+  /// File header.  32 bytes, so the arrays that follow start 8-byte aligned.
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t source_count;
+    uint32_t record_count;
+    uint32_t node_count;
+    uint32_t string_bytes;
+    uint32_t reserved;
+  };
+
+  /// A source file the database was compiled from.
+  struct Source
+  {
+    uint32_t path;        ///< String offset of the path, relative to data/
+    uint32_t reserved;
+    uint64_t size;        ///< File size in bytes
+    int64_t modified;     ///< Last write time
+  };
+
+  /// One descriptor file.
+  struct Record
+  {
+    uint32_t section;     ///< DescriptorDatabase::Section
+    uint32_t name;        ///< String offset of the descriptor name
+    uint32_t first_node;  ///< Index of the root node of the property tree
+    uint32_t node_count;  ///< Number of nodes in the property tree
+  };
+
+  /// Details of a source file found on disk.
+  struct SourceInfo
+  {
+    DescriptorDatabase::Section section;
+    std::string name;
+    std::string path;
+    uint64_t size;
+    int64_t modified;
+
+    bool operator<(SourceInfo const& other) const
+    {
+      return path < other.path;
+    }
+  };
+
+  /// Return the read_xml flags used for a kind of descriptor.  These must
+  /// match what the loaders did before the database existed, since they
+  /// change the resulting trees.
+  int get_xml_flags(DescriptorDatabase::Section section)
+  {
+    if (section == DescriptorDatabase::Section::Substances)
+    {
+      return boost::property_tree::xml_parser::trim_whitespace;
+    }
+    else
+    {
+      return 0;
+    }
+  }
+
+  /// Return the path of a descriptor file, relative to the data directory.
+  std::string get_relative_path(DescriptorDatabase::Section section,
+                                std::string const& name)
+  {
+    switch (section)
+    {
+    case DescriptorDatabase::Section::Substances:
+      return "substances/" + name + ".xml";
+
+    case DescriptorDatabase::Section::Props:
+      return "props/" + name + ".xml";
+
+    default:
+      return "verbs.xml";
+    }
+  }
+
+  /// Add details of a source file to a list.
+  void add_source(std::vector<SourceInfo>& sources,
+                  std::string const& data_path,
+                  DescriptorDatabase::Section section,
+                  std::string const& name)
+  {
+    SourceInfo info;
+    info.section = section;
+    info.name = name;
+    info.path = get_relative_path(section, name);
+
+    boost::filesystem::path full_path(data_path + "/" + info.path);
+    info.size = boost::filesystem::file_size(full_path);
+    info.modified = boost::filesystem::last_write_time(full_path);
+
+    sources.push_back(info);
+  }
+
+  /// Find every descriptor file under the data directory, in the same way
+  /// the loaders do.
+  std::vector<SourceInfo> find_sources(std::string const& data_path)
+  {
+    std::vector<SourceInfo> sources;
+
+    DescriptorDatabase::Section const directory_sections[] =
+    {
+      DescriptorDatabase::Section::Substances,
+      DescriptorDatabase::Section::Props
+    };
+    char const* const directory_names[] = { "substances", "props" };
+
+    for (unsigned int index = 0; index < 2; ++index)
+    {
+      boost::filesystem::path directory(data_path + "/" +
+                                        directory_names[index]);
+      if (!boost::filesystem::is_directory(directory))
+      {
+        continue;
+      }
+
+      for (boost::filesystem::directory_iterator iter(directory);
+           iter != boost::filesystem::directory_iterator(); ++iter)
+      {
+        if ((boost::filesystem::is_regular_file(iter->path())) &&
+            (iter->path().filename().extension() == ".xml"))
+        {
+          add_source(sources, data_path, directory_sections[index],
+                     iter->path().filename().stem().generic_string());
+        }
+      }
+    }
+
+    if (boost::filesystem::is_regular_file(data_path + "/verbs.xml"))
+    {
+      add_source(sources, data_path, DescriptorDatabase::Section::Verbs,
+                 "verbs");
+    }
+
+    std::sort(sources.begin(), sources.end());
+    return sources;
+  }
+
+  /// Work out the type of a property value.
+  void classify(std::string const& text,
+                DescriptorDatabase::PropertyType& type,
+                double& number)
+  {
+    number = 0;
+
+    if (text.empty())
+    {
+      type = DescriptorDatabase::PropertyType::Empty;
+      return;
+    }
+
+    if ((text == "true") || (text == "false"))
+    {
+      type = DescriptorDatabase::PropertyType::Bool;
+      number = (text == "true") ? 1 : 0;
+      return;
+    }
+
+    char* end;
+    long integer = std::strtol(text.c_str(), &end, 10);
+    if (*end == '\0')
+    {
+      type = DescriptorDatabase::PropertyType::Int;
+      number = integer;
+      return;
+    }
+
+    double real = std::strtod(text.c_str(), &end);
+    if (*end == '\0')
+    {
+      type = DescriptorDatabase::PropertyType::Float;
+      number = real;
+      return;
+    }
+
+    type = DescriptorDatabase::PropertyType::String;
+  }
+
+  /// Collects the contents of a database while it is being compiled.
+  struct Builder
+  {
+    /// Return the offset of a string in the string table, adding it if
+    /// needed.
+    uint32_t add_string(std::string const& text)
+    {
+      auto iter = string_offsets.find(text);
+      if (iter != string_offsets.end())
+      {
+        return iter->second;
+      }
+
+      uint32_t offset = strings.size();
+      strings.insert(strings.end(), text.begin(), text.end());
+      strings.push_back('\0');
+      string_offsets[text] = offset;
+      return offset;
+    }
+
+    /// Add a property tree node and its children, depth first.
+    void add_node(std::string const& key,
+                  boost::property_tree::ptree const& tree)
+    {
+      uint32_t index = keys.size();
+
+      DescriptorDatabase::PropertyType type;
+      double number;
+      classify(tree.data(), type, number);
+
+      keys.push_back(add_string(key));
+      values.push_back(add_string(tree.data()));
+      types.push_back((uint8_t) type);
+      numbers.push_back(number);
+      spans.push_back(0);
+
+      for (auto const& child : tree)
+      {
+        add_node(child.first, child.second);
+      }
+
+      spans[index] = keys.size() - index;
+    }
+
+    std::vector<char> strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+
+    std::vector<Source> sources;
+    std::vector<Record> records;
+
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> spans;
+    std::vector<double> numbers;
+    std::vector<uint8_t> types;
+  };
+
+  /// Write the contents of a vector to a stream.
+  template <typename T>
+  void write_array(std::ofstream& stream, std::vector<T> const& data)
+  {
+    if (!data.empty())
+    {
+      stream.write(reinterpret_cast<char const*>(&(data[0])),
+                   data.size() * sizeof(T));
+    }
+  }
+}
+
+struct DescriptorDatabase::Impl
+{
+  Impl()
+    : data_path("data"), is_open(false)
+  {
+  }
+
+  /// Point an array at the next part of the mapped file.
+  /// @return False if the file is too short.
+  template <typename T>
+  bool take(T const*& array, uint32_t count, size_t& offset)
+  {
+    size_t bytes = sizeof(T) * (size_t) count;
+    if (offset + bytes > region.get_size())
+    {
+      return false;
+    }
+
+    array = reinterpret_cast<T const*>(
+              static_cast<char const*>(region.get_address()) + offset);
+    offset += bytes;
+    return true;
+  }
+
+  /// Check that every offset and span in the mapped file stays inside the
+  /// arrays it points into, so a damaged file can't send build_tree() or
+  /// find_child() off the end of the mapping, or into an endless loop.
+  /// @return True if the contents can be used.
+  bool check_contents() const
+  {
+    uint32_t string_bytes = header->string_bytes;
+
+    for (uint32_t index = 0; index < header->source_count; ++index)
+    {
+      if (sources[index].path >= string_bytes)
+      {
+        return false;
+      }
+    }
+
+    for (uint32_t index = 0; index < header->record_count; ++index)
+    {
+      Record const& record = records[index];
+      uint64_t end = (uint64_t) record.first_node + record.node_count;
+      if ((record.name >= string_bytes) || (record.node_count == 0) ||
+          (end > header->node_count))
+      {
+        return false;
+      }
+
+      // Each node's span has to cover at least the node itself, and must
+      // not run past the end of the record's tree.
+      for (uint32_t node = record.first_node; node < end; ++node)
+      {
+        if ((spans[node] == 0) || (spans[node] > end - node))
+        {
+          return false;
+        }
+      }
+    }
+
+    for (uint32_t index = 0; index < header->node_count; ++index)
+    {
+      if ((keys[index] >= string_bytes) || (values[index] >= string_bytes))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /// Get a string from the string table.
+  char const* get_string(uint32_t offset) const
+  {
+    return strings + offset;
+  }
+
+  /// Find a record by section and name.
+  Record const* find_record(Section section, std::string const& name) const
+  {
+    Record const* first = records;
+    Record const* last = records + header->record_count;
+    uint32_t section_number = (uint32_t) section;
+
+    Record const* iter =
+      std::lower_bound(first, last, name,
+                       [this, section_number](Record const& record,
+                                              std::string const& key)
+    {
+      if (record.section != section_number)
+      {
+        return record.section < section_number;
+      }
+      return std::strcmp(get_string(record.name), key.c_str()) < 0;
+    });
+
+    if ((iter != last) && (iter->section == section_number) &&
+        (name == get_string(iter->name)))
+    {
+      return iter;
+    }
+
+    return nullptr;
+  }
+
+  /// Rebuild a property tree from a node and its children.
+  void build_tree(uint32_t index, boost::property_tree::ptree& tree) const
+  {
+    tree.data() = get_string(values[index]);
+
+    uint32_t end = index + spans[index];
+    for (uint32_t child = index + 1; child < end; child += spans[child])
+    {
+      boost::property_tree::ptree& child_tree =
+        tree.push_back(std::make_pair(get_string(keys[child]),
+                                      boost::property_tree::ptree()))->second;
+      build_tree(child, child_tree);
+    }
+  }
+
+  /// Find the first child of a node with a particular key.
+  /// @return Index of the child, or 0 if there isn't one.
+  uint32_t find_child(uint32_t index, std::string const& key) const
+  {
+    uint32_t end = index + spans[index];
+    for (uint32_t child = index + 1; child < end; child += spans[child])
+    {
+      if (key == get_string(keys[child]))
+      {
+        return child;
+      }
+    }
+
+    return 0;
+  }
+
+  /// Data directory that descriptors are read from.
+  std::string data_path;
+
+  /// Mapping of the whole database file.
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+
+  /// True if the database is mapped and up to date.
+  bool is_open;
+
+  /// Parts of the mapped file.
+  Header const* header;
+  Source const* sources;
+  double const* numbers;
+  Record const* records;
+  uint32_t const* keys;
+  uint32_t const* values;
+  uint32_t const* spans;
+  uint8_t const* types;
+  char const* strings;
+};
+
+std::unique_ptr<DescriptorDatabase> DescriptorDatabase::instance_;
+
+DescriptorDatabase* DescriptorDatabase::instance()
+{
+  if (instance_.get() == nullptr)
+  {
+    instance_.reset(new DescriptorDatabase());
+  }
+
+  return instance_.get();
+}
+
+DescriptorDatabase::DescriptorDatabase()
+  : impl(new Impl())
+{
+}
+
+DescriptorDatabase::~DescriptorDatabase()
+{
+}
+
+bool DescriptorDatabase::compile(std::string data_path,
+                                 std::string database_path)
+{
+  Builder builder;
+  std::vector<SourceInfo> sources;
+
+  try
+  {
+    sources = find_sources(data_path);
+  }
+  catch (std::exception& e)
+  {
+    MAJOR_ERROR("Can't scan \"%s\" for descriptor files: %s",
+                data_path.c_str(), e.what());
+    return false;
+  }
+
+  for (SourceInfo const& info : sources)
+  {
+    boost::property_tree::ptree tree;
+
+    try
+    {
+      read_xml(data_path + "/" + info.path, tree,
+               get_xml_flags(info.section));
+    }
+    catch (std::exception& e)
+    {
+      MAJOR_ERROR("Can't parse \"%s\" descriptor file: %s",
+                  info.path.c_str(), e.what());
+      return false;
+    }
+
+    Source source;
+    source.path = builder.add_string(info.path);
+    source.reserved = 0;
+    source.size = info.size;
+    source.modified = info.modified;
+    builder.sources.push_back(source);
+
+    Record record;
+    record.section = (uint32_t) info.section;
+    record.name = builder.add_string(info.name);
+    record.first_node = builder.keys.size();
+    builder.add_node("", tree);
+    record.node_count = builder.keys.size() - record.first_node;
+    builder.records.push_back(record);
+  }
+
+  // Sort records by section and name, so they can be binary searched.
+  std::vector<char> const& strings = builder.strings;
+  std::sort(builder.records.begin(), builder.records.end(),
+            [&strings](Record const& a, Record const& b)
+  {
+    if (a.section != b.section)
+    {
+      return a.section < b.section;
+    }
+    return std::strcmp(&(strings[a.name]), &(strings[b.name])) < 0;
+  });
+
+  Header header;
+  std::memcpy(header.magic, "PDDB", 4);
+  header.version = format_version;
+  header.byte_order = byte_order_mark;
+  header.source_count = builder.sources.size();
+  header.record_count = builder.records.size();
+  header.node_count = builder.keys.size();
+  header.string_bytes = builder.strings.size();
+  header.reserved = 0;
+
+  std::ofstream stream(database_path.c_str(),
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!stream)
+  {
+    MAJOR_ERROR("Can't open \"%s\" for writing", database_path.c_str());
+    return false;
+  }
+
+  // Arrays go in order of decreasing alignment.
+  stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  write_array(stream, builder.sources);
+  write_array(stream, builder.numbers);
+  write_array(stream, builder.records);
+  write_array(stream, builder.keys);
+  write_array(stream, builder.values);
+  write_array(stream, builder.spans);
+  write_array(stream, builder.types);
+  write_array(stream, builder.strings);
+
+  if (!stream)
+  {
+    MAJOR_ERROR("Error writing \"%s\"", database_path.c_str());
+    return false;
+  }
+
+  std::cout << "Compiled " << header.record_count << " descriptors ("
+            << header.node_count << " properties, " << header.string_bytes
+            << " bytes of strings) into " << database_path << std::endl;
+  return true;
+}
+
+bool DescriptorDatabase::open(std::string data_path, std::string database_path)
+{
+  close();
+  impl->data_path = data_path;
+
+  if (!boost::filesystem::exists(database_path))
+  {
+    std::cout << "No descriptor database at " << database_path
+              << "; reading descriptor files." << std::endl;
+    return false;
+  }
+
+  try
+  {
+    impl->file = boost::interprocess::file_mapping(
+                   database_path.c_str(), boost::interprocess::read_only);
+    impl->region = boost::interprocess::mapped_region(
+                     impl->file, boost::interprocess::read_only);
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "Can't map descriptor database " << database_path << ": "
+              << e.what() << "; reading descriptor files." << std::endl;
+    return false;
+  }
+
+  size_t offset = 0;
+  if (!impl->take(impl->header, 1, offset) ||
+      (std::memcmp(impl->header->magic, "PDDB", 4) != 0) ||
+      (impl->header->version != format_version) ||
+      (impl->header->byte_order != byte_order_mark))
+  {
+    std::cout << "Descriptor database " << database_path
+              << " is from another version; reading descriptor files."
+              << std::endl;
+    close();
+    return false;
+  }
+
+  Header const& header = *(impl->header);
+  if (!impl->take(impl->sources, header.source_count, offset) ||
+      !impl->take(impl->numbers, header.node_count, offset) ||
+      !impl->take(impl->records, header.record_count, offset) ||
+      !impl->take(impl->keys, header.node_count, offset) ||
+      !impl->take(impl->values, header.node_count, offset) ||
+      !impl->take(impl->spans, header.node_count, offset) ||
+      !impl->take(impl->types, header.node_count, offset) ||
+      !impl->take(impl->strings, header.string_bytes, offset) ||
+      (offset != impl->region.get_size()) ||
+      (header.string_bytes == 0) ||
+      (impl->strings[header.string_bytes - 1] != '\0') ||
+      !impl->check_contents())
+  {
+    std::cout << "Descriptor database " << database_path
+              << " is damaged; reading descriptor files." << std::endl;
+    close();
+    return false;
+  }
+
+  // Check the database against the files it was compiled from.
+  std::vector<SourceInfo> sources;
+  try
+  {
+    sources = find_sources(data_path);
+  }
+  catch (std::exception& e)
+  {
+    sources.clear();
+  }
+
+  bool up_to_date = (sources.size() == header.source_count);
+  for (uint32_t index = 0; up_to_date && (index < header.source_count);
+       ++index)
+  {
+    Source const& source = impl->sources[index];
+    up_to_date = (sources[index].path == impl->get_string(source.path)) &&
+                 (sources[index].size == source.size) &&
+                 (sources[index].modified == source.modified);
+  }
+
+  if (!up_to_date)
+  {
+    std::cout << "Descriptor database " << database_path
+              << " is out of date; reading descriptor files." << std::endl;
+    close();
+    return false;
+  }
+
+  impl->is_open = true;
+
+  std::cout << "Using descriptor database " << database_path << " ("
+            << header.record_count << " descriptors)." << std::endl;
+  return true;
+}
+
+void DescriptorDatabase::close()
+{
+  impl->is_open = false;
+  impl->region = boost::interprocess::mapped_region();
+  impl->file = boost::interprocess::file_mapping();
+}
+
+bool DescriptorDatabase::is_open() const
+{
+  return impl->is_open;
+}
+
+void DescriptorDatabase::read(Section section,
+                              std::string const& name,
+                              boost::property_tree::ptree& properties) const
+{
+  if (!impl->is_open)
+  {
+    read_xml(impl->data_path + "/" + get_relative_path(section, name),
+             properties,
+             get_xml_flags(section));
+    return;
+  }
+
+  Record const* record = impl->find_record(section, name);
+  if (record == nullptr)
+  {
+    throw std::runtime_error("\"" + get_relative_path(section, name) +
+                             "\" is not in the descriptor database");
+  }
+
+  properties.clear();
+  impl->build_tree(record->first_node, properties);
+}
+
+bool DescriptorDatabase::get_property(Section section,
+                                      std::string const& name,
+                                      std::string const& path,
+                                      Property& property) const
+{
+  if (!impl->is_open)
+  {
+    return false;
+  }
+
+  Record const* record = impl->find_record(section, name);
+  if (record == nullptr)
+  {
+    return false;
+  }
+
+  uint32_t index = record->first_node;
+  size_t start = 0;
+  while (start <= path.size())
+  {
+    size_t end = path.find('.', start);
+    if (end == std::string::npos)
+    {
+      end = path.size();
+    }
+
+    index = impl->find_child(index, path.substr(start, end - start));
+    if (index == 0)
+    {
+      return false;
+    }
+
+    start = end + 1;
+  }
+
+  property.type = (PropertyType) impl->types[index];
+  property.text = impl->get_string(impl->values[index]);
+  property.number = impl->numbers[index];
+  return true;
+}
+
+std::vector<std::string> DescriptorDatabase::get_names(Section section) const
+{
+  std::vector<std::string> names;
+
+  if (impl->is_open)
+  {
+    for (uint32_t index = 0; index < impl->header->record_count; ++index)
+    {
+      if (impl->records[index].section == (uint32_t) section)
+      {
+        names.push_back(impl->get_string(impl->records[index].name));
+      }
+    }
+  }
+
+  return names;
+}
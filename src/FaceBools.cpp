@@ -7,6 +7,8 @@
 
 #include "FaceBools.h"
 
+const uint8_t FaceBools::all_mask;
+
 struct FaceBools::Impl
 {
   struct _faces
@@ -115,6 +117,26 @@ void FaceBools::set_front(bool value)
   impl->faces.front = value;
 }
 
+uint8_t FaceBools::get_mask() const
+{
+  return ((impl->faces.top ? 1 : 0) << (int) FaceName::Top) |
+         ((impl->faces.right ? 1 : 0) << (int) FaceName::Right) |
+         ((impl->faces.front ? 1 : 0) << (int) FaceName::Front) |
+         ((impl->faces.bottom ? 1 : 0) << (int) FaceName::Bottom) |
+         ((impl->faces.left ? 1 : 0) << (int) FaceName::Left) |
+         ((impl->faces.back ? 1 : 0) << (int) FaceName::Back);
+}
+
+void FaceBools::set_mask(uint8_t mask)
+{
+  impl->faces.top = ((mask & (1 << (int) FaceName::Top)) != 0);
+  impl->faces.right = ((mask & (1 << (int) FaceName::Right)) != 0);
+  impl->faces.front = ((mask & (1 << (int) FaceName::Front)) != 0);
+  impl->faces.bottom = ((mask & (1 << (int) FaceName::Bottom)) != 0);
+  impl->faces.left = ((mask & (1 << (int) FaceName::Left)) != 0);
+  impl->faces.back = ((mask & (1 << (int) FaceName::Back)) != 0);
+}
+
 FaceBools& FaceBools::operator=(const FaceBools& rhs)
 {
   if (this == &rhs)
@@ -0,0 +1,270 @@
+#include "FileWatcher.h"
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "ErrorMacros.h"
+
+struct FileWatcher::Impl
+{
+  /// Size and modification time of a file, as seen when polling.
+  struct FileStamp
+  {
+    uintmax_t size;
+    std::time_t modified;
+
+    bool operator!=(FileStamp const& other) const
+    {
+      return (size != other.size) || (modified != other.modified);
+    }
+  };
+
+  typedef std::map<std::string, FileStamp> Snapshot;
+
+  /// Return true if a file name has the extension being watched for.
+  bool matches(std::string const& name) const
+  {
+    return boost::filesystem::path(name).extension() == extension;
+  }
+
+  /// Note that a file has changed.
+  void add_change(std::string const& path)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      changes.insert(path);
+    }
+
+    if (on_change)
+    {
+      on_change();
+    }
+  }
+
+  /// Take a snapshot of every watched file.
+  Snapshot take_snapshot() const
+  {
+    Snapshot snapshot;
+    boost::system::error_code error;
+
+    for (std::string const& directory : directories)
+    {
+      for (boost::filesystem::directory_iterator iter(directory, error);
+           !error && (iter != boost::filesystem::directory_iterator());
+           iter.increment(error))
+      {
+        boost::filesystem::path const& path = iter->path();
+        if (boost::filesystem::is_regular_file(path) &&
+            matches(path.filename().string()))
+        {
+          FileStamp stamp;
+          stamp.size = boost::filesystem::file_size(path, error);
+          stamp.modified = boost::filesystem::last_write_time(path, error);
+          snapshot[directory + "/" + path.filename().string()] = stamp;
+        }
+      }
+    }
+
+    return snapshot;
+  }
+
+  /// Body of the thread, when polling.
+  void poll_loop()
+  {
+    Snapshot last = take_snapshot();
+
+    while (!stopping)
+    {
+      // Sleep in short steps, so stopping doesn't have to wait long.
+      for (unsigned int slept = 0; (slept < poll_ms) && !stopping; slept += 50)
+      {
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+      }
+
+      Snapshot current = take_snapshot();
+
+      for (auto const& entry : current)
+      {
+        auto iter = last.find(entry.first);
+        if ((iter == last.end()) || (iter->second != entry.second))
+        {
+          add_change(entry.first);
+        }
+      }
+
+      for (auto const& entry : last)
+      {
+        if (current.count(entry.first) == 0)
+        {
+          add_change(entry.first);
+        }
+      }
+
+      last.swap(current);
+    }
+  }
+
+#ifdef __linux__
+  /// Set up inotify.
+  /// @return True on success.
+  bool start_inotify()
+  {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+      return false;
+    }
+
+    for (std::string const& directory : directories)
+    {
+      int watch = inotify_add_watch(inotify_fd, directory.c_str(),
+                                    IN_CLOSE_WRITE | IN_MOVED_TO |
+                                    IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+      if (watch < 0)
+      {
+        close(inotify_fd);
+        inotify_fd = -1;
+        watched.clear();
+        return false;
+      }
+      watched[watch] = directory;
+    }
+
+    return true;
+  }
+
+  /// Body of the thread, when using inotify.
+  void inotify_loop()
+  {
+    // Buffer for events, aligned as the kernel expects.
+    alignas(struct inotify_event) char buffer[4096];
+    struct pollfd descriptor;
+    descriptor.fd = inotify_fd;
+    descriptor.events = POLLIN;
+
+    while (!stopping)
+    {
+      // Wake up now and again to see if we've been asked to stop.
+      if (poll(&descriptor, 1, 200) <= 0)
+      {
+        continue;
+      }
+
+      ssize_t length;
+      while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+      {
+        for (char* pointer = buffer; pointer < buffer + length; )
+        {
+          struct inotify_event const* event =
+            reinterpret_cast<struct inotify_event const*>(pointer);
+          pointer += sizeof(struct inotify_event) + event->len;
+
+          // A file that is only created hasn't been written yet; its
+          // IN_CLOSE_WRITE will follow.
+          if ((event->len == 0) || ((event->mask & IN_CREATE) != 0))
+          {
+            continue;
+          }
+
+          std::string name(event->name);
+          auto iter = watched.find(event->wd);
+          if ((iter != watched.end()) && matches(name))
+          {
+            add_change(iter->second + "/" + name);
+          }
+        }
+      }
+    }
+
+    close(inotify_fd);
+    inotify_fd = -1;
+  }
+
+  /// inotify file descriptor, or -1 if not in use.
+  int inotify_fd;
+
+  /// Watched directories, indexed by inotify watch descriptor.
+  std::map<int, std::string> watched;
+#endif
+
+  std::vector<std::string> directories;
+  std::string extension;
+  unsigned int poll_ms;
+  Callback on_change;
+  bool polling;
+
+  /// Set to ask the thread to stop.
+  std::atomic<bool> stopping;
+
+  /// Thread doing the watching.
+  boost::thread thread;
+
+  /// Changes not yet taken.
+  std::set<std::string> changes;
+
+  /// Protects changes.
+  boost::mutex mutex;
+};
+
+FileWatcher::FileWatcher(std::vector<std::string> const& directories,
+                         std::string const& extension,
+                         unsigned int poll_ms,
+                         Callback on_change)
+  : impl(new Impl())
+{
+  impl->directories = directories;
+  impl->extension = extension;
+  impl->poll_ms = poll_ms;
+  impl->on_change = on_change;
+  impl->stopping = false;
+  impl->polling = true;
+
+  Impl* pimpl = impl.get();
+
+#ifdef __linux__
+  if (impl->start_inotify())
+  {
+    impl->polling = false;
+    impl->thread = boost::thread([pimpl]() { pimpl->inotify_loop(); });
+  }
+  else
+  {
+    MINOR_ERROR("Couldn't set up inotify, so polling for file changes instead");
+  }
+#endif
+
+  if (impl->polling)
+  {
+    impl->thread = boost::thread([pimpl]() { pimpl->poll_loop(); });
+  }
+}
+
+FileWatcher::~FileWatcher()
+{
+  impl->stopping = true;
+  impl->thread.join();
+}
+
+std::vector<std::string> FileWatcher::take_changes()
+{
+  boost::mutex::scoped_lock lock(impl->mutex);
+
+  std::vector<std::string> result(impl->changes.begin(), impl->changes.end());
+  impl->changes.clear();
+  return result;
+}
+
+bool FileWatcher::is_polling() const
+{
+  return impl->polling;
+}
@@ -0,0 +1,499 @@
+#include "FluidSimulator.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "Application.h"
+#include "ErrorMacros.h"
+#include "JobSystem.h"
+#include "Stage.h"
+#include "StageBlock.h"
+#include "StageChunk.h"
+#include "SubstanceLibrary.h"
+
+struct FluidSimulator::Impl
+{
+  /// Width and depth of a chunk slab.
+  static const int side = StageChunk::chunk_side_length;
+
+  /// Number of blocks in a chunk slab.
+  static const int cells = side * side;
+
+  /// Width of a chunk slab plus a one-block border on each side.
+  static const int border_side = side + 2;
+
+  /// A block passes this fraction of its level difference to each lower
+  /// neighbor per tick.  Must be more than 4 so that a block can never give
+  /// away more liquid than it has.
+  static const int lateral_divisor = 5;
+
+  /// Number of chunk slabs handed to each job in a tick.  Ticks with fewer
+  /// slabs than this run on the calling thread.
+  static const unsigned int slabs_per_job = 8;
+
+  /// Simulation state for one chunk slab.
+  struct ChunkState
+  {
+    /// Liquid levels, double-buffered.
+    uint8_t level[2][cells];
+
+    /// Liquid in each block, or SUBSTANCEID_NULL if the level is zero.
+    SubstanceID liquid[2][cells];
+
+    /// Nonzero for blocks liquid can't enter (solid, or off the stage).
+    uint8_t blocked[cells];
+
+    /// Which buffer is current.
+    uint8_t current;
+  };
+
+  Impl(Stage& stage_)
+    : stage(stage_)
+  {
+    size = stage.size();
+    chunks_x = (size.x + side - 1) / side;
+    chunks_y = (size.y + side - 1) / side;
+    chunks_z = size.z;
+    chunks.resize(chunks_x * chunks_y * chunks_z);
+    in_tick_list.assign(chunks.size(), 0);
+
+    cache_liquid_flags();
+    air_id = SL->get_id("air");
+  }
+
+  /// Cache which substances count as liquid.
+  void cache_liquid_flags()
+  {
+    SubstanceLibraryShPtr library = SL;
+    unsigned int substance_count = library->get_substance_count();
+    liquid_flags.resize(substance_count);
+    for (unsigned int id = 0; id < substance_count; ++id)
+    {
+      Phase phase = library->get(id)->get_data().phase;
+      liquid_flags[id] = ((phase == Phase::Liquid) || (phase == Phase::Viscous));
+    }
+  }
+
+  unsigned int get_chunk_index(int chunk_x, int chunk_y, int z) const
+  {
+    return (((z * chunks_y) + chunk_y) * chunks_x) + chunk_x;
+  }
+
+  bool in_bounds(int x, int y, int z) const
+  {
+    return ((x >= 0) && (y >= 0) && (z >= 0) &&
+            (x < size.x) && (y < size.y) && (z < size.z));
+  }
+
+  /// Get the current level of a block.
+  /// @return False if liquid can't enter the block.
+  bool read(int x, int y, int z, int& level) const
+  {
+    if (!in_bounds(x, y, z))
+    {
+      return false;
+    }
+
+    ChunkState const& chunk = chunks[get_chunk_index(x / side, y / side, z)];
+    int cell = ((y % side) * side) + (x % side);
+    if (chunk.blocked[cell] != 0)
+    {
+      return false;
+    }
+
+    level = chunk.level[chunk.current][cell];
+    return true;
+  }
+
+  /// Get the current liquid in a block.
+  SubstanceID read_liquid(int x, int y, int z) const
+  {
+    ChunkState const& chunk = chunks[get_chunk_index(x / side, y / side, z)];
+    return chunk.liquid[chunk.current][((y % side) * side) + (x % side)];
+  }
+
+  /// Amount that falls out of an open block into the one below it.
+  int get_fall(int x, int y, int z, int level) const
+  {
+    int below;
+    if ((level == 0) || !read(x, y, z - 1, below))
+    {
+      return 0;
+    }
+    return std::min(level, max_level - below);
+  }
+
+  /// Amount that falls into an open block from the one above it.
+  int get_fall_in(int x, int y, int z, int level) const
+  {
+    int above;
+    if (!read(x, y, z + 1, above))
+    {
+      return 0;
+    }
+    return std::min(above, max_level - level);
+  }
+
+  /// Read the current state of a chunk slab from the stage's blocks.
+  /// @return True if the slab contains any liquid.
+  bool load_chunk(unsigned int chunk_index)
+  {
+    ChunkState& chunk = chunks[chunk_index];
+    int base_x = (chunk_index % chunks_x) * side;
+    int base_y = ((chunk_index / chunks_x) % chunks_y) * side;
+    int z = chunk_index / (chunks_x * chunks_y);
+    bool any_liquid = false;
+
+    chunk.current = 0;
+
+    for (int cell = 0; cell < cells; ++cell)
+    {
+      int x = base_x + (cell % side);
+      int y = base_y + (cell / side);
+      uint8_t level = 0;
+      SubstanceID liquid = SUBSTANCEID_NULL;
+
+      chunk.blocked[cell] = 1;
+
+      if (in_bounds(x, y, z))
+      {
+        StageBlock& block = stage.get_block(x, y, z);
+        if ((block.get_summary() & StageBlock::SummarySolid) == 0)
+        {
+          chunk.blocked[cell] = 0;
+
+          SubstanceID fluid = block.get_substance_id(BlockLayer::Fluid);
+          if ((fluid < liquid_flags.size()) && liquid_flags[fluid])
+          {
+            level = max_level;
+            liquid = fluid;
+            any_liquid = true;
+          }
+        }
+      }
+
+      chunk.level[0][cell] = chunk.level[1][cell] = level;
+      chunk.liquid[0][cell] = chunk.liquid[1][cell] = liquid;
+    }
+
+    return any_liquid;
+  }
+
+  /// Calculate the next state of a chunk slab into its other buffer.
+  /// Only reads current buffers, so any number of these can run at once.
+  /// @return True if any liquid moved into, out of, or within the slab.
+  bool tick_chunk(unsigned int chunk_index)
+  {
+    ChunkState& chunk = chunks[chunk_index];
+    int base_x = (chunk_index % chunks_x) * side;
+    int base_y = ((chunk_index / chunks_x) % chunks_y) * side;
+    int z = chunk_index / (chunks_x * chunks_y);
+    int next = 1 - chunk.current;
+    bool flow = false;
+
+    // Levels after vertical flow, for the slab plus a one-block border.
+    // -1 marks blocks liquid can't enter.
+    int settled[border_side * border_side];
+
+    for (int add_y = 0; add_y < border_side; ++add_y)
+    {
+      for (int add_x = 0; add_x < border_side; ++add_x)
+      {
+        int x = base_x + add_x - 1;
+        int y = base_y + add_y - 1;
+        int level;
+
+        if (read(x, y, z, level))
+        {
+          settled[(add_y * border_side) + add_x] =
+            level - get_fall(x, y, z, level) + get_fall_in(x, y, z, level);
+        }
+        else
+        {
+          settled[(add_y * border_side) + add_x] = -1;
+        }
+      }
+    }
+
+    // Now spread sideways.
+    static const int neighbor_x[4] = { -1, 1, 0, 0 };
+    static const int neighbor_y[4] = { 0, 0, -1, 1 };
+
+    for (int cell = 0; cell < cells; ++cell)
+    {
+      int add_x = (cell % side) + 1;
+      int add_y = (cell / side) + 1;
+      int center = settled[(add_y * border_side) + add_x];
+
+      if (center < 0)
+      {
+        chunk.level[next][cell] = 0;
+        chunk.liquid[next][cell] = SUBSTANCEID_NULL;
+        continue;
+      }
+
+      int x = base_x + add_x - 1;
+      int y = base_y + add_y - 1;
+      int level = chunk.level[chunk.current][cell];
+      int fall_in = get_fall_in(x, y, z, level);
+      int result = center;
+
+      // Track where new liquid comes from, in case this block was empty.
+      int best_inflow = fall_in;
+      SubstanceID best_source =
+        (fall_in > 0) ? read_liquid(x, y, z + 1) : SUBSTANCEID_NULL;
+
+      if ((fall_in > 0) || (get_fall(x, y, z, level) > 0))
+      {
+        flow = true;
+      }
+
+      for (int n = 0; n < 4; ++n)
+      {
+        int other = settled[((add_y + neighbor_y[n]) * border_side) +
+                            add_x + neighbor_x[n]];
+        if (other < 0)
+        {
+          continue;
+        }
+
+        if (center > other)
+        {
+          int amount = (center - other) / lateral_divisor;
+          result -= amount;
+          flow = flow || (amount > 0);
+        }
+        else if (other > center)
+        {
+          int amount = (other - center) / lateral_divisor;
+          result += amount;
+          if (amount > best_inflow)
+          {
+            best_inflow = amount;
+            best_source = read_liquid(x + neighbor_x[n], y + neighbor_y[n], z);
+          }
+          flow = flow || (amount > 0);
+        }
+      }
+
+      chunk.level[next][cell] = result;
+      if (result == 0)
+      {
+        chunk.liquid[next][cell] = SUBSTANCEID_NULL;
+      }
+      else if (level > 0)
+      {
+        chunk.liquid[next][cell] = chunk.liquid[chunk.current][cell];
+      }
+      else
+      {
+        chunk.liquid[next][cell] = best_source;
+      }
+    }
+
+    return flow;
+  }
+
+  /// Tick a range of the tick list.
+  void tick_range(unsigned int first, unsigned int last)
+  {
+    for (unsigned int i = first; i < last; ++i)
+    {
+      flow_results[i] = tick_chunk(tick_list[i]);
+    }
+  }
+
+  /// Update stage blocks that gained or lost liquid on the last tick.
+  void write_back(unsigned int chunk_index)
+  {
+    ChunkState const& chunk = chunks[chunk_index];
+    int base_x = (chunk_index % chunks_x) * side;
+    int base_y = ((chunk_index / chunks_x) % chunks_y) * side;
+    int z = chunk_index / (chunks_x * chunks_y);
+    int previous = 1 - chunk.current;
+
+    for (int cell = 0; cell < cells; ++cell)
+    {
+      SubstanceID liquid = chunk.liquid[chunk.current][cell];
+      if (liquid != chunk.liquid[previous][cell])
+      {
+        StageBlock& block = stage.get_block(base_x + (cell % side),
+                                            base_y + (cell / side), z);
+        block.set_substance(BlockLayer::Fluid,
+                            (liquid == SUBSTANCEID_NULL) ? air_id : liquid);
+      }
+    }
+  }
+
+  /// Add a chunk slab to the tick list, if it exists and isn't there yet.
+  void add_to_tick_list(int chunk_x, int chunk_y, int z)
+  {
+    if ((chunk_x < 0) || (chunk_y < 0) || (z < 0) ||
+        (chunk_x >= chunks_x) || (chunk_y >= chunks_y) || (z >= chunks_z))
+    {
+      return;
+    }
+
+    unsigned int chunk_index = get_chunk_index(chunk_x, chunk_y, z);
+    if (in_tick_list[chunk_index] == 0)
+    {
+      in_tick_list[chunk_index] = 1;
+      tick_list.push_back(chunk_index);
+    }
+  }
+
+  /// Reference to the stage.
+  Stage& stage;
+
+  /// Size of the stage.
+  StageCoord3 size;
+
+  /// Number of chunk slabs along each axis.
+  int chunks_x, chunks_y, chunks_z;
+
+  /// State of every chunk slab on the stage.
+  std::vector<ChunkState> chunks;
+
+  /// Chunk slabs that had flow on the last tick or were woken, sorted.
+  std::vector<unsigned int> active_list;
+
+  /// Chunk slabs being updated on this tick, sorted.
+  std::vector<unsigned int> tick_list;
+
+  /// Nonzero for chunk slabs in tick_list.
+  std::vector<uint8_t> in_tick_list;
+
+  /// Whether each chunk slab in tick_list had any flow.
+  std::vector<uint8_t> flow_results;
+
+  /// Nonzero for each SubstanceID that is a liquid.
+  std::vector<uint8_t> liquid_flags;
+
+  /// Substance that fills a block's fluid layer when the liquid leaves.
+  SubstanceID air_id;
+};
+
+FluidSimulator::FluidSimulator(Stage& stage)
+  : impl(new Impl(stage))
+{
+}
+
+FluidSimulator::~FluidSimulator()
+{
+}
+
+void FluidSimulator::load()
+{
+  impl->active_list.clear();
+
+  for (unsigned int chunk_index = 0; chunk_index < impl->chunks.size();
+       ++chunk_index)
+  {
+    if (impl->load_chunk(chunk_index))
+    {
+      impl->active_list.push_back(chunk_index);
+    }
+  }
+
+  std::cout << "Fluid simulation loaded: " << impl->active_list.size()
+            << " of " << impl->chunks.size() << " chunk slabs have liquid."
+            << std::endl;
+}
+
+void FluidSimulator::refresh_substances()
+{
+  impl->cache_liquid_flags();
+}
+
+void FluidSimulator::wake(StageCoord x, StageCoord y, StageCoord z)
+{
+  if (!impl->in_bounds(x, y, z))
+  {
+    MINOR_ERROR("Attempt to wake fluids at (%d, %d, %d), which is off the stage",
+                x, y, z);
+    return;
+  }
+
+  unsigned int chunk_index = impl->get_chunk_index(x / Impl::side,
+                                                   y / Impl::side, z);
+  impl->load_chunk(chunk_index);
+
+  std::vector<unsigned int>::iterator iter =
+    std::lower_bound(impl->active_list.begin(), impl->active_list.end(),
+                     chunk_index);
+  if ((iter == impl->active_list.end()) || (*iter != chunk_index))
+  {
+    impl->active_list.insert(iter, chunk_index);
+  }
+}
+
+unsigned int FluidSimulator::tick()
+{
+  // Liquid can only start moving between two blocks if one of them, or a
+  // block directly above or below one of them, changed on the last tick.  So
+  // update the active chunk slabs, the slabs next to and above/below them,
+  // and the slabs next to those above/below.  Both sides of any flow are then
+  // always updated together, and no liquid is lost.
+  impl->tick_list.clear();
+  for (unsigned int chunk_index : impl->active_list)
+  {
+    int chunk_x = chunk_index % impl->chunks_x;
+    int chunk_y = (chunk_index / impl->chunks_x) % impl->chunks_y;
+    int z = chunk_index / (impl->chunks_x * impl->chunks_y);
+
+    for (int add_z = -1; add_z <= 1; ++add_z)
+    {
+      impl->add_to_tick_list(chunk_x, chunk_y, z + add_z);
+      impl->add_to_tick_list(chunk_x - 1, chunk_y, z + add_z);
+      impl->add_to_tick_list(chunk_x + 1, chunk_y, z + add_z);
+      impl->add_to_tick_list(chunk_x, chunk_y - 1, z + add_z);
+      impl->add_to_tick_list(chunk_x, chunk_y + 1, z + add_z);
+    }
+  }
+  std::sort(impl->tick_list.begin(), impl->tick_list.end());
+
+  unsigned int tick_count = impl->tick_list.size();
+  impl->flow_results.assign(tick_count, 0);
+
+  // Calculate the next state.  Each slab only writes its own back buffer, so
+  // splitting the list between jobs doesn't change the results.
+  if (tick_count > Impl::slabs_per_job)
+  {
+    App::instance().get_jobs().parallel_for(tick_count, Impl::slabs_per_job,
+        [this](unsigned int first, unsigned int last)
+    {
+      impl->tick_range(first, last);
+    }, JobSystem::Priority::High);
+  }
+  else
+  {
+    impl->tick_range(0, tick_count);
+  }
+
+  // Swap buffers and update the stage, in a fixed order.
+  impl->active_list.clear();
+  for (unsigned int i = 0; i < tick_count; ++i)
+  {
+    unsigned int chunk_index = impl->tick_list[i];
+    impl->chunks[chunk_index].current ^= 1;
+    impl->write_back(chunk_index);
+    impl->in_tick_list[chunk_index] = 0;
+
+    if (impl->flow_results[i] != 0)
+    {
+      impl->active_list.push_back(chunk_index);
+    }
+  }
+
+  return tick_count;
+}
+
+unsigned int FluidSimulator::get_active_chunk_count() const
+{
+  return impl->active_list.size();
+}
+
+unsigned int FluidSimulator::get_thread_count() const
+{
+  return App::instance().get_jobs().get_worker_count();
+}
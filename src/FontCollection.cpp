@@ -1,5 +1,6 @@
 #include "ErrorMacros.h"
 #include "SimpleMatrixFont.h"
+#include "TextLayout.h"
 #include "TextureFont.h"
 
 #include <boost/container/map.hpp>
@@ -10,6 +11,7 @@
 struct FontCollection::Impl
 {
   boost::container::map<std::string, boost::shared_ptr<TextureFont> > fontCollection;
+  TextLayoutCache layouts;
 };
 
 FontCollection::FontCollection()
@@ -65,3 +67,8 @@ TextureFont& FontCollection::get_default()
 {
   return *(impl->fontCollection["default"].get());
 }
+
+TextLayoutCache& FontCollection::get_layouts()
+{
+  return impl->layouts;
+}
@@ -36,6 +36,10 @@ struct GUIElement::Impl
 
   /// Boolean indicating whether render data needs to be updated.
   bool dirty_;
+
+  /// Boolean indicating whether render data for something under this element
+  /// needs to be updated.
+  bool child_dirty_;
 };
 
 GUIElement::GUIElement(GUIElement* parent,
@@ -58,6 +62,7 @@ GUIElement::GUIElement(GUIElement* parent,
   impl->back_color_ = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
   impl->fore_color_ = glm::vec4(1.0f);
   impl->dirty_ = true;
+  impl->child_dirty_ = false;
 }
 
 GUIElement::~GUIElement()
@@ -80,6 +85,11 @@ std::string GUIElement::getElementName()
   return impl->name_;
 }
 
+GUIElement* GUIElement::get_parent()
+{
+  return impl->parent_;
+}
+
 glm::vec2 GUIElement::getAbsoluteLocation()
 {
   glm::vec2 absSize = getAbsoluteSize();
@@ -174,18 +184,25 @@ bool GUIElement::get_absolute_visibility()
 void GUIElement::clear_dirty()
 {
   clear_dirty_flag();
+  impl->child_dirty_ = false;
+}
+
+void GUIElement::clear_child_dirty()
+{
+  impl->child_dirty_ = false;
 }
 
 void GUIElement::set_dirty()
 {
   set_dirty_flag();
-  if ((impl->parent_ != nullptr) && (impl->parent_->is_dirty() != true))
-  {
-    impl->parent_->set_dirty();
-  }
 }
 
 bool GUIElement::is_dirty()
+{
+  return impl->dirty_ || impl->child_dirty_;
+}
+
+bool GUIElement::is_self_dirty()
 {
   return is_dirty_flag_set();
 }
@@ -254,9 +271,12 @@ void GUIElement::set_dirty_flag()
 {
   impl->dirty_ = true;
 
-  if (impl->parent_ != nullptr)
+  // Let the ancestors know, stopping at the first one that already knows.
+  GUIElement* ancestor = impl->parent_;
+  while ((ancestor != nullptr) && (ancestor->impl->child_dirty_ != true))
   {
-    impl->parent_->set_dirty();
+    ancestor->impl->child_dirty_ = true;
+    ancestor = ancestor->impl->parent_;
   }
 }
 
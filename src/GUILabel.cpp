@@ -1,10 +1,21 @@
 #include "GUILabel.h"
 
+#include "Application.h"
+#include "FontCollection.h"
 #include "GUIElementVisitor.h"
+#include "TextLayout.h"
 
 struct GUILabel::Impl
 {
   std::u32string   text_;
+  bool             outlined_;
+
+  /// Layout of text_, or null if it hasn't been laid out since it changed.
+  std::shared_ptr<TextLayout const> layout_;
+
+  /// Font and width layout_ was made for.
+  TextureFont*     layout_font_;
+  float            layout_width_;
 };
 
 GUILabel::GUILabel(GUIElement* parent,
@@ -16,7 +27,9 @@ GUILabel::GUILabel(GUIElement* parent,
                element_size, element_visible),
     impl(new Impl())
 {
-  //ctor
+  impl->outlined_ = false;
+  impl->layout_font_ = nullptr;
+  impl->layout_width_ = 0.0f;
 }
 
 GUILabel::~GUILabel()
@@ -41,5 +54,40 @@ std::u32string GUILabel::getText()
 
 void GUILabel::setText(std::u32string text)
 {
-  impl->text_ = text;
+  if (text != impl->text_)
+  {
+    impl->text_ = text;
+    impl->layout_.reset();
+    set_dirty();
+  }
+}
+
+bool GUILabel::getOutlined()
+{
+  return impl->outlined_;
+}
+
+void GUILabel::setOutlined(bool outlined)
+{
+  if (outlined != impl->outlined_)
+  {
+    impl->outlined_ = outlined;
+    set_dirty();
+  }
+}
+
+TextLayout const& GUILabel::getLayout(TextureFont& font, float wrap_width)
+{
+  if (!impl->layout_ ||
+      (impl->layout_font_ != &font) ||
+      (impl->layout_width_ != wrap_width))
+  {
+    impl->layout_ = App::instance().get_fonts().get_layouts().get(font,
+                                                                  wrap_width,
+                                                                  impl->text_);
+    impl->layout_font_ = &font;
+    impl->layout_width_ = wrap_width;
+  }
+
+  return *(impl->layout_);
 }
@@ -139,7 +139,7 @@ unsigned int GUIParentElement::get_child_count()
 
 void GUIParentElement::clear_dirty()
 {
-  clear_dirty_flag();
+  GUIElement::clear_dirty();
 
   boost::ptr_map<std::string, GUIElement>::iterator iter;
 
@@ -1,14 +1,21 @@
 #include "GUIRenderData.h"
 
+#include <algorithm>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "GUIElement.h"
 #include "GUIVertexRenderData.h"
 
+/// Spare room left after each span, in vertices (eight quads).  Padding is
+/// made of zero-area triangles, so it draws nothing.
+static const unsigned int span_slack = 48;
+
 GUIRenderData::GUIRenderData()
 {
   glGenVertexArrays(1, &vao_id);
   glGenBuffers(1, &vbo_id);
+  emitted_count = 0;
   clear_vertices();
 }
 
@@ -22,6 +29,77 @@ void GUIRenderData::clear_vertices()
 {
   vertices.clear();
   vertex_count = 0;
+
+  spans.clear();
+  open.clear();
+  scratch.clear();
+  scratch_spans.clear();
+
+  rebuilding = true;
+  overflowed = false;
+  upload_all = true;
+  upload_first = 0;
+  upload_last = 0;
+}
+
+void GUIRenderData::begin_pass()
+{
+  emitted_count = 0;
+  open.clear();
+}
+
+bool GUIRenderData::begin_element(GUIElement& element)
+{
+  // Anything open that this element isn't under is finished.
+  while (!open.empty() && (open.back().element != element.get_parent()))
+  {
+    close_span();
+  }
+
+  // When rebuilding, or when re-emitting something this element is under,
+  // it gets emitted regardless.
+  if (rebuilding || !open.empty())
+  {
+    OpenSpan span = { &element, (unsigned int)target().size() };
+    open.push_back(span);
+    return true;
+  }
+
+  if (!element.is_self_dirty())
+  {
+    return false;
+  }
+
+  if (spans.count(&element) == 0)
+  {
+    // Never emitted before, so there is nowhere to put it.
+    overflowed = true;
+    return false;
+  }
+
+  scratch.clear();
+  scratch_spans.clear();
+  OpenSpan span = { &element, 0 };
+  open.push_back(span);
+  return true;
+}
+
+bool GUIRenderData::end_pass()
+{
+  while (!open.empty())
+  {
+    close_span();
+  }
+
+  if (overflowed)
+  {
+    clear_vertices();
+    return false;
+  }
+
+  rebuilding = false;
+  vertex_count = vertices.size();
+  return true;
 }
 
 void GUIRenderData::add_vertex(glm::vec2 vertex,
@@ -34,49 +112,141 @@ void GUIRenderData::add_vertex(glm::vec2 vertex,
                              color.r, color.g, color.b, color.a,
                              tex_coord_x, tex_coord_y, (textured ? 1.0 : 0.0));
 
-  vertices.push_back(newVertex);
-  ++vertex_count;
+  target().push_back(newVertex);
+  ++emitted_count;
 }
 
 void GUIRenderData::update_VAO()
 {
+  if (!upload_all && (upload_last <= upload_first))
+  {
+    return;
+  }
+
   // bind the solid VAO.
   glBindVertexArray(vao_id);
 
   // bind the solid VBO.
   glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
 
-  // Copy the data to the solid VBO.
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GUIVertexRenderData),
-               &(vertices[0]), GL_STATIC_DRAW);
-
-  // Set up attribute 0 to be the vertex's position.
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
-                        sizeof(GUIVertexRenderData),
-                        (const void*) offsetof(GUIVertexRenderData, x));
-
-  // Set up attribute 1 to be the vertex's color.
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE,
-                        sizeof(GUIVertexRenderData),
-                        (const void*) offsetof(GUIVertexRenderData, r));
-
-  // Set up attribute 2 to be the vertex's texture coordinates.
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-                        sizeof(GUIVertexRenderData),
-                        (const void*) offsetof(GUIVertexRenderData, s));
-
-  // Set up attribute 3 to be whether the vertex is textured.
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE,
-                        sizeof(GUIVertexRenderData),
-                        (const void*) offsetof(GUIVertexRenderData, textured));
-
-  // Clear the vertex data, but keep the count.
-  vertices.clear();
+  if (upload_all)
+  {
+    // Copy the data to the solid VBO.
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GUIVertexRenderData),
+                 vertices.empty() ? nullptr : &(vertices[0]), GL_DYNAMIC_DRAW);
+
+    // Set up attribute 0 to be the vertex's position.
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(GUIVertexRenderData),
+                          (const void*) offsetof(GUIVertexRenderData, x));
+
+    // Set up attribute 1 to be the vertex's color.
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(GUIVertexRenderData),
+                          (const void*) offsetof(GUIVertexRenderData, r));
+
+    // Set up attribute 2 to be the vertex's texture coordinates.
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(GUIVertexRenderData),
+                          (const void*) offsetof(GUIVertexRenderData, s));
+
+    // Set up attribute 3 to be whether the vertex is textured.
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE,
+                          sizeof(GUIVertexRenderData),
+                          (const void*) offsetof(GUIVertexRenderData, textured));
+  }
+  else
+  {
+    // Copy just the patched part.
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    upload_first * sizeof(GUIVertexRenderData),
+                    (upload_last - upload_first) * sizeof(GUIVertexRenderData),
+                    &(vertices[upload_first]));
+  }
+
+  upload_all = false;
+  upload_first = 0;
+  upload_last = 0;
 
   // unbind the VAO (for now).
   glBindVertexArray(0);
 }
+
+boost::container::vector<GUIVertexRenderData>& GUIRenderData::target()
+{
+  return rebuilding ? vertices : scratch;
+}
+
+void GUIRenderData::close_span()
+{
+  OpenSpan top = open.back();
+  open.pop_back();
+
+  boost::container::vector<GUIVertexRenderData>& buffer = target();
+  unsigned int count = buffer.size() - top.first;
+
+  if (rebuilding || !open.empty())
+  {
+    Span span = { top.first, count + span_slack };
+    buffer.resize(top.first + span.capacity);
+
+    if (rebuilding)
+    {
+      spans[top.element] = span;
+    }
+    else
+    {
+      scratch_spans[top.element] = span;
+    }
+    return;
+  }
+
+  // This was an element being re-emitted; see if it still fits.
+  Span old_span = spans[top.element];
+  if (count > old_span.capacity)
+  {
+    overflowed = true;
+    return;
+  }
+
+  buffer.resize(old_span.capacity);
+  std::copy(buffer.begin(), buffer.end(), vertices.begin() + old_span.first);
+
+  // Spans lying inside the old one belonged to what used to be under the
+  // element.  Ancestors sharing its start are always larger, so they stay.
+  unsigned int old_end = old_span.first + old_span.capacity;
+  for (auto iter = spans.begin(); iter != spans.end(); )
+  {
+    if ((iter->first != top.element) &&
+        (iter->second.first >= old_span.first) &&
+        (iter->second.first + iter->second.capacity <= old_end))
+    {
+      iter = spans.erase(iter);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+
+  for (auto& entry : scratch_spans)
+  {
+    Span span = { old_span.first + entry.second.first, entry.second.capacity };
+    spans[entry.first] = span;
+  }
+
+  if (upload_last <= upload_first)
+  {
+    upload_first = old_span.first;
+    upload_last = old_end;
+  }
+  else
+  {
+    upload_first = std::min(upload_first, old_span.first);
+    upload_last = std::max(upload_last, old_end);
+  }
+}
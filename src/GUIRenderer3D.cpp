@@ -16,10 +16,14 @@
 #include "GUIParentElement.h"
 #include "GUIRenderData.h"
 #include "GLShaderProgram.h"
+#include "TextLayout.h"
 #include "TextureFont.h"
 
 struct GUIRenderer3D::Impl
 {
+  /// Color that outlined text is outlined in.
+  static const glm::vec4 outline_color;
+
   void draw_rect(float left,
                 float right,
                 float top,
@@ -87,6 +91,32 @@ struct GUIRenderer3D::Impl
     }
   }
 
+  /// Work out what to do with an element being visited, and clear its
+  /// dirty flags.
+  /// @param element  Element being visited.
+  /// @param redraw   Set to true if the element's vertices should be emitted.
+  /// @return True if the element's children should be visited.
+  bool begin_visit(GUIElement& element, bool& redraw)
+  {
+    redraw = render_data->begin_element(element);
+    bool visible = element.get_absolute_visibility();
+    bool visit_children = visible && (redraw || element.is_dirty());
+
+    // Something hidden is re-emitted in full once it is shown again, so
+    // changes under it can be forgotten.
+    if (redraw || !visible)
+    {
+      element.clear_dirty();
+    }
+    else
+    {
+      element.clear_child_dirty();
+    }
+
+    redraw = redraw && visible;
+    return visit_children;
+  }
+
   std::unique_ptr<GUIRenderData> render_data;
   std::unique_ptr<GLShaderProgram> shader_program; ///< Rendering program
 
@@ -94,9 +124,13 @@ struct GUIRenderer3D::Impl
   GLuint window_size_id;
   GLuint frame_counter_id;
 
-  bool vao_dirty;  ///< Boolean indicating whether VAO needs updating
+  /// GUI visited last, so it can be visited again if the vertex data has to
+  /// be rebuilt.
+  GUI* gui;
 };
 
+const glm::vec4 GUIRenderer3D::Impl::outline_color = glm::vec4(0.0f, 0.0f, 0.0f, 0.5f);
+
 GUIRenderer3D::GUIRenderer3D()
   : impl(new Impl())
 {
@@ -111,7 +145,7 @@ GUIRenderer3D::GUIRenderer3D()
   impl->window_size_id = impl->shader_program->get_uniform_id("window_size");
   impl->frame_counter_id = impl->shader_program->get_uniform_id("frame_counter");
 
-  impl->vao_dirty = true;
+  impl->gui = nullptr;
 }
 
 GUIRenderer3D::~GUIRenderer3D()
@@ -121,54 +155,45 @@ GUIRenderer3D::~GUIRenderer3D()
 
 bool GUIRenderer3D::visit(GUI& gui)
 {
-  if (gui.is_dirty())
-  {
-    gui.clear_dirty();
-    impl->vao_dirty = true;
-    impl->render_data->clear_vertices();
+  bool redraw;
 
-    return true;
-  }
-  else
-  {
-    return false;
-  }
+  impl->gui = &gui;
+  impl->render_data->begin_pass();
+  return impl->begin_visit(gui, redraw);
 }
 
 bool GUIRenderer3D::visit(GUIElement& element)
 {
-  element.clear_dirty();
-  if (element.get_absolute_visibility())
+  bool redraw;
+  bool visit_children = impl->begin_visit(element, redraw);
+
+  if (redraw)
   {
     // TODO: draw
-    return true;
-  }
-  else
-  {
-    DEEP_TRACE("GUIElement %p is invisible, so ignoring", (void*)&element);
-    return false;
   }
+
+  return visit_children;
 }
 
 bool GUIRenderer3D::visit(GUIParentElement& element)
 {
-  element.clear_dirty();
-  if (element.get_absolute_visibility())
+  bool redraw;
+  bool visit_children = impl->begin_visit(element, redraw);
+
+  if (redraw)
   {
     // TODO: draw
-    return true;
-  }
-  else
-  {
-    DEEP_TRACE("GUIParentElement %p is invisible, so ignoring", (void*)&element);
-    return false;
   }
+
+  return visit_children;
 }
 
 bool GUIRenderer3D::visit(GUIFrame& frame)
 {
-  frame.clear_dirty();
-  if (frame.get_absolute_visibility())
+  bool redraw;
+  bool visit_children = impl->begin_visit(frame, redraw);
+
+  if (redraw)
   {
     glm::vec2 element_location = frame.getAbsoluteLocation();
     glm::vec2 element_size = frame.getAbsoluteSize();
@@ -178,21 +203,19 @@ bool GUIRenderer3D::visit(GUIFrame& frame)
     impl->draw_rect(element_location.x, element_location.x + element_size.x - 1,
                     element_location.y, element_location.y + element_size.y - 1,
                     frame.get_bg_color(), 2, frame.get_fg_color());
-    return true;
-  }
-  else
-  {
-    DEEP_TRACE("GUIFrame %p is invisible, so ignoring", (void*)&frame);
-    return false;
   }
+
+  return visit_children;
 }
 
 bool GUIRenderer3D::visit(GUILabel& label)
 {
   TextureFont& font = App::instance().get_fonts().get_default();
 
-  label.clear_dirty();
-  if (label.get_absolute_visibility())
+  bool redraw;
+  bool visit_children = impl->begin_visit(label, redraw);
+
+  if (redraw)
   {
     glm::vec2 element_location = label.getAbsoluteLocation();
     glm::vec2 element_size = label.getAbsoluteSize();
@@ -203,44 +226,38 @@ bool GUIRenderer3D::visit(GUILabel& label)
                    element_location.y, element_location.y + element_size.y - 1,
                    label.get_bg_color(), 0, label.get_fg_color());
 
-    std::u32string text = label.getText();
-    glm::vec2 next_char_coords = glm::vec2(0.0);
+    TextLayout const& layout = label.getLayout(font, element_size.x);
 
-    for (unsigned int char_pos = 0; char_pos < text.size(); ++char_pos)
+    // Outlines all go first, so that no outline covers a neighboring glyph.
+    if (label.getOutlined())
     {
-      glm::vec4 char_texture_coords = font.getTextureCoordinates(text[char_pos]);
-      glm::vec2 rect_location = glm::vec2(element_location.x + next_char_coords.x,
-                                          element_location.y + next_char_coords.y);
-      glm::vec2 glyph_size = font.getGlyphSize(text[char_pos]);
+      for (TextLayout::Quad const& quad : layout.quads)
+      {
+        glm::vec2 rect_location = element_location + quad.position;
+
+        impl->draw_rect(rect_location.x,
+                        rect_location.x + quad.size.x,
+                        rect_location.y,
+                        rect_location.y + quad.size.y,
+                        label.get_bg_color(), 0, Impl::outline_color,
+                        quad.outline_texture_coords, true);
+      }
+    }
+
+    for (TextLayout::Quad const& quad : layout.quads)
+    {
+      glm::vec2 rect_location = element_location + quad.position;
 
       impl->draw_rect(rect_location.x,
-                      rect_location.x + glyph_size.x,
+                      rect_location.x + quad.size.x,
                       rect_location.y,
-                      rect_location.y + glyph_size.y,
+                      rect_location.y + quad.size.y,
                       label.get_bg_color(), 0, label.get_fg_color(),
-                      char_texture_coords, true);
-
-      glm::vec2 char_advance = glm::vec2(font.getXAdvance(text[char_pos]),
-                                         font.getLineHeight());
-
-      if (next_char_coords.x + char_advance.x > element_size.x)
-      {
-        next_char_coords.x = 0;
-        next_char_coords.y += char_advance.y;
-      }
-      else
-      {
-        next_char_coords.x += char_advance.x;
-      }
+                      quad.texture_coords, true);
     }
-
-    return true;
-  }
-  else
-  {
-    DEEP_TRACE("GUILabel %p is invisible, so ignoring", (void*)&label);
-    return false;
   }
+
+  return visit_children;
 }
 
 void GUIRenderer3D::draw()
@@ -251,14 +268,20 @@ void GUIRenderer3D::draw()
 
   static unsigned int frame_counter;
 
+  // Close off the pass; if something outgrew its space, go over the whole
+  // GUI again to rebuild the vertex data.
+  if (!impl->render_data->end_pass() && (impl->gui != nullptr))
+  {
+    impl->gui->accept(*this);
+    impl->render_data->end_pass();
+  }
+
+  DEEP_TRACE("GUI pass emitted %u vertices", impl->render_data->emitted_count);
+
   // Use our shader program.
   impl->shader_program->bind();
 
-  if (impl->vao_dirty)
-  {
-    impl->render_data->update_VAO();
-    impl->vao_dirty = false;
-  }
+  impl->render_data->update_VAO();
 
   // bind texture sampler to renderer.
   font.bind();
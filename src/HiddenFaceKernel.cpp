@@ -0,0 +1,114 @@
+#include "HiddenFaceKernel.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  /// Description of the neighbor across one face of a block.
+  struct Neighbor
+  {
+    FaceName face;  ///< Face the neighbor is across
+    int slab;       ///< Slab the neighbor is in
+    int offset;     ///< Offset of the neighbor within the slab
+  };
+
+  const Neighbor neighbors[6] =
+  {
+    { FaceName::Top,    StageChunkHalo::Above,   0 },
+    { FaceName::Right,  StageChunkHalo::Center,  1 },
+    { FaceName::Front,  StageChunkHalo::Center,  StageChunkHalo::side },
+    { FaceName::Bottom, StageChunkHalo::Below,   0 },
+    { FaceName::Left,   StageChunkHalo::Center, -1 },
+    { FaceName::Back,   StageChunkHalo::Center, -StageChunkHalo::side }
+  };
+}
+
+void HiddenFaceKernel::calculate_scalar(StageChunkHalo const& halo, Output& output)
+{
+  // A face is hidden if the block adjacent to it is:
+  // 1. Made of the same material.
+  // 2. Opaque.
+  for (int y = 0; y < StageChunk::chunk_side_length; ++y)
+  {
+    for (int x = 0; x < StageChunk::chunk_side_length; ++x)
+    {
+      int center = StageChunkHalo::index(x, y);
+      SubstanceID solid = halo.solid[StageChunkHalo::Center][center];
+      SubstanceID fluid = halo.fluid[StageChunkHalo::Center][center];
+      uint8_t solid_mask = 0;
+      uint8_t fluid_mask = 0;
+
+      for (Neighbor const& neighbor : neighbors)
+      {
+        int index = center + neighbor.offset;
+        bool opaque = (halo.opaque[neighbor.slab][index] != 0);
+        uint8_t bit = 1 << (int) neighbor.face;
+
+        if (opaque || (halo.solid[neighbor.slab][index] == solid))
+        {
+          solid_mask |= bit;
+        }
+        if (opaque || (halo.fluid[neighbor.slab][index] == fluid))
+        {
+          fluid_mask |= bit;
+        }
+      }
+
+      output.solid[(y * StageChunk::chunk_side_length) + x] = solid_mask;
+      output.fluid[(y * StageChunk::chunk_side_length) + x] = fluid_mask;
+    }
+  }
+}
+
+#ifdef __SSE2__
+void HiddenFaceKernel::calculate(StageChunkHalo const& halo, Output& output)
+{
+  // Same logic as calculate_scalar(), eight blocks per iteration.
+  for (int y = 0; y < StageChunk::chunk_side_length; ++y)
+  {
+    for (int x = 0; x < StageChunk::chunk_side_length; x += 8)
+    {
+      int center = StageChunkHalo::index(x, y);
+      __m128i solid = _mm_loadu_si128((__m128i const*) &halo.solid[StageChunkHalo::Center][center]);
+      __m128i fluid = _mm_loadu_si128((__m128i const*) &halo.fluid[StageChunkHalo::Center][center]);
+      __m128i solid_mask = _mm_setzero_si128();
+      __m128i fluid_mask = _mm_setzero_si128();
+
+      for (Neighbor const& neighbor : neighbors)
+      {
+        int index = center + neighbor.offset;
+        __m128i opaque =
+          _mm_loadu_si128((__m128i const*) &halo.opaque[neighbor.slab][index]);
+        __m128i other_solid =
+          _mm_loadu_si128((__m128i const*) &halo.solid[neighbor.slab][index]);
+        __m128i other_fluid =
+          _mm_loadu_si128((__m128i const*) &halo.fluid[neighbor.slab][index]);
+        __m128i bit = _mm_set1_epi16(1 << (int) neighbor.face);
+
+        __m128i solid_hidden =
+          _mm_or_si128(_mm_cmpeq_epi16(solid, other_solid), opaque);
+        __m128i fluid_hidden =
+          _mm_or_si128(_mm_cmpeq_epi16(fluid, other_fluid), opaque);
+
+        solid_mask = _mm_or_si128(solid_mask, _mm_and_si128(solid_hidden, bit));
+        fluid_mask = _mm_or_si128(fluid_mask, _mm_and_si128(fluid_hidden, bit));
+      }
+
+      // Masks fit in a byte, so pack solid into the low half and fluid into
+      // the high half, then store each.
+      __m128i packed = _mm_packus_epi16(solid_mask, fluid_mask);
+      int out = (y * StageChunk::chunk_side_length) + x;
+      _mm_storel_epi64((__m128i*) &output.solid[out], packed);
+      _mm_storel_epi64((__m128i*) &output.fluid[out],
+                       _mm_srli_si128(packed, 8));
+    }
+  }
+}
+#else
+void HiddenFaceKernel::calculate(StageChunkHalo const& halo, Output& output)
+{
+  calculate_scalar(halo, output);
+}
+#endif
@@ -1,25 +1,18 @@
 // *** ADDED BY HEADER FIXUP ***
 #include <algorithm>
-#include <set>
+#include <vector>
 // *** END ***
 #include "Inventory.h"
 
-#include "Prop.h"
 #include "Settings.h"
 
-struct Inventory::Impl
+Inventory::Inventory()
+  : count_(0), positioned_(false), spilled_(false), tracked_(true)
 {
-  /// Set of HasLocation objects under this one.
-  boost::container::set<HasLocation*> contents;
-
-  /// A static "Limbo" PropContainer.
-  static Inventory limbo;
-};
-
-Inventory Inventory::Impl::limbo;
+}
 
-Inventory::Inventory()
-  : impl(new Impl())
+Inventory::Inventory(bool tracked)
+  : count_(0), positioned_(false), spilled_(false), tracked_(tracked)
 {
 }
 
@@ -27,43 +20,136 @@ Inventory::~Inventory()
 {
 }
 
-bool Inventory::add(HasLocation* _object)
+bool Inventory::add(SerialNumber prop)
 {
-  if (_object != nullptr)
+  if (prop == SERIALNUMBER_NULL)
+  {
+    return false;
+  }
+
+  if (!tracked_)
+  {
+    return true;
+  }
+
+  if (spilled_)
+  {
+    std::vector<SerialNumber>::iterator iter =
+      std::lower_bound(spill_.begin(), spill_.end(), prop);
+    if ((iter == spill_.end()) || (*iter != prop))
+    {
+      spill_.insert(iter, prop);
+      ++count_;
+    }
+    return true;
+  }
+
+  SerialNumber* position = std::lower_bound(inline_, inline_ + count_, prop);
+  if ((position != inline_ + count_) && (*position == prop))
   {
-    impl->contents.insert(_object);
     return true;
   }
 
-  return false;
+  if (count_ < inline_capacity)
+  {
+    std::copy_backward(position, inline_ + count_, inline_ + count_ + 1);
+    *position = prop;
+  }
+  else
+  {
+    // Out of room, so move everything to the vector.
+    spill_.reserve(inline_capacity * 2);
+    spill_.assign(inline_, position);
+    spill_.push_back(prop);
+    spill_.insert(spill_.end(), position, inline_ + count_);
+    spilled_ = true;
+  }
+
+  ++count_;
+  return true;
 }
 
-bool Inventory::remove(HasLocation* _object)
+bool Inventory::remove(SerialNumber prop)
 {
-  if ((_object != nullptr) && (impl->contents.count(_object) != 0))
+  if (!tracked_)
   {
-    impl->contents.erase(_object);
+    return (prop != SERIALNUMBER_NULL);
+  }
+
+  if (spilled_)
+  {
+    std::vector<SerialNumber>::iterator iter =
+      std::lower_bound(spill_.begin(), spill_.end(), prop);
+    if ((iter == spill_.end()) || (*iter != prop))
+    {
+      return false;
+    }
+    spill_.erase(iter);
+    --count_;
+
+    // Back down to what fits inline, so give the heap storage back.
+    if (count_ <= inline_capacity)
+    {
+      std::copy(spill_.begin(), spill_.end(), inline_);
+      std::vector<SerialNumber>().swap(spill_);
+      spilled_ = false;
+    }
     return true;
   }
-  return false;
+
+  SerialNumber* position = std::lower_bound(inline_, inline_ + count_, prop);
+  if ((position == inline_ + count_) || (*position != prop))
+  {
+    return false;
+  }
+
+  std::copy(position + 1, inline_ + count_, position);
+  --count_;
+  return true;
+}
+
+void Inventory::set_position(StageCoord3 const& position)
+{
+  position_ = position;
+  positioned_ = true;
+}
+
+bool Inventory::get_position(StageCoord3& position) const
+{
+  if (positioned_)
+  {
+    position = position_;
+  }
+  return positioned_;
+}
+
+bool Inventory::contains(SerialNumber prop) const
+{
+  return std::binary_search(begin(), end(), prop);
+}
+
+int Inventory::Quantity() const
+{
+  return count_;
 }
 
-int Inventory::Quantity()
+bool Inventory::IsEmpty() const
 {
-  return (impl->contents.size());
+  return (count_ == 0);
 }
 
-bool Inventory::IsEmpty()
+SerialNumber const* Inventory::begin() const
 {
-  return (impl->contents.size() == 0);
+  return (spilled_ ? spill_.data() : inline_);
 }
 
-boost::container::set<HasLocation*> const& Inventory::getContents(void)
+SerialNumber const* Inventory::end() const
 {
-  return impl->contents;
+  return begin() + count_;
 }
 
 Inventory& Inventory::getLimbo()
 {
-  return Impl::limbo;
+  static Inventory limbo(false);
+  return limbo;
 }
@@ -0,0 +1,462 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <vector>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "ProfileTimer.h"
+
+namespace
+{
+  /// Index of the worker running on this thread, or -1 if this thread isn't
+  /// a worker.  Only meaningful alongside current_system.
+  thread_local int current_worker = -1;
+
+  /// Job system this thread is a worker for, if any.
+  thread_local void const* current_system = nullptr;
+}
+
+JobSystem::Counter::Counter()
+  : pending_(0)
+{
+}
+
+JobSystem::Counter::~Counter()
+{
+}
+
+bool JobSystem::Counter::is_done() const
+{
+  return (pending_.load() == 0);
+}
+
+struct JobSystem::Impl
+{
+  static const unsigned int priority_count = (unsigned int) Priority::Count;
+
+  /// A queued job, and the Counter it is tied to.
+  struct Task
+  {
+    Job job;
+    Counter* counter;
+  };
+
+  /// Queues, thread and statistics for one worker.
+  struct Worker
+  {
+    Worker()
+      : jobs_run(0), jobs_stolen(0), sleeps(0), busy_us(0)
+    {
+    }
+
+    /// Protects the queues.
+    boost::mutex mutex;
+
+    /// One queue per priority.  The owner takes from the back, and thieves
+    /// take from the front.
+    std::deque<Task> queues[priority_count];
+
+    boost::thread thread;
+
+    std::atomic<unsigned int> jobs_run;
+    std::atomic<unsigned int> jobs_stolen;
+    std::atomic<unsigned int> sleeps;
+    std::atomic<uint64_t> busy_us;
+  };
+
+  Impl()
+    : queued(0), next_worker(0), stopping(false),
+      helper_jobs_run(0), helper_busy_us(0)
+  {
+  }
+
+  /// Return the index of the calling thread's worker, or -1 if it isn't one
+  /// of ours.
+  int get_current_worker() const
+  {
+    return (current_system == this) ? current_worker : -1;
+  }
+
+  /// Put a job on a queue and wake a sleeping worker.
+  void push(Task const& task, Priority priority)
+  {
+    int index = get_current_worker();
+    if (index < 0)
+    {
+      index = next_worker.fetch_add(1) % workers.size();
+    }
+
+    // Count the job first, so queued never drops below the number of jobs
+    // actually sitting in the queues.
+    ++queued;
+
+    Worker& worker = workers[index];
+    {
+      boost::mutex::scoped_lock lock(worker.mutex);
+      worker.queues[(unsigned int) priority].push_back(task);
+    }
+
+    {
+      // Taking the lock means a worker that has just seen queued == 0 is
+      // already waiting, and won't miss the notification.
+      boost::mutex::scoped_lock lock(sleep_mutex);
+    }
+    sleep_condition.notify_one();
+  }
+
+  /// Take the best job available to a worker (or, if index is -1, to some
+  /// other thread).  Higher priorities come first; within a priority, the
+  /// worker's own newest job comes first, then the oldest job of the others.
+  bool pop(int index, Task& task, bool& stolen)
+  {
+    if (queued.load() == 0)
+    {
+      return false;
+    }
+
+    unsigned int worker_count = workers.size();
+
+    for (unsigned int priority = 0; priority < priority_count; ++priority)
+    {
+      if (index >= 0)
+      {
+        Worker& own = workers[index];
+        boost::mutex::scoped_lock lock(own.mutex);
+        std::deque<Task>& queue = own.queues[priority];
+        if (!queue.empty())
+        {
+          task = queue.back();
+          queue.pop_back();
+          --queued;
+          stolen = false;
+          return true;
+        }
+      }
+
+      unsigned int start = (index >= 0) ? index + 1 : 0;
+      for (unsigned int offset = 0; offset < worker_count; ++offset)
+      {
+        unsigned int victim_index = (start + offset) % worker_count;
+        if ((int) victim_index == index)
+        {
+          continue;
+        }
+
+        Worker& victim = workers[victim_index];
+        boost::mutex::scoped_lock lock(victim.mutex);
+        std::deque<Task>& queue = victim.queues[priority];
+        if (!queue.empty())
+        {
+          task = queue.front();
+          queue.pop_front();
+          --queued;
+          stolen = true;
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  /// Run a job, then count it off its Counter and release anything that was
+  /// waiting for that Counter.
+  void run(Task& task)
+  {
+    task.job();
+
+    if (task.counter != nullptr)
+    {
+      finish(*(task.counter));
+    }
+  }
+
+  /// Count one job off a Counter.
+  void finish(Counter& counter)
+  {
+    std::vector<Counter::Continuation> ready;
+
+    {
+      boost::mutex::scoped_lock lock(counter.mutex_);
+      if (--(counter.pending_) == 0)
+      {
+        ready.swap(counter.continuations_);
+      }
+      else
+      {
+        return;
+      }
+    }
+
+    // The counter may be destroyed by a waiter from here on; don't touch it.
+    for (Counter::Continuation& continuation : ready)
+    {
+      Task task = { continuation.job, continuation.counter };
+      push(task, continuation.priority);
+    }
+
+    // Wake anyone waiting for this counter.
+    {
+      boost::mutex::scoped_lock lock(sleep_mutex);
+    }
+    sleep_condition.notify_all();
+  }
+
+  /// Main loop of a worker thread.
+  void work(unsigned int index)
+  {
+    current_system = this;
+    current_worker = index;
+
+    Worker& worker = workers[index];
+    Task task;
+    bool stolen;
+
+    for (;;)
+    {
+      if (pop(index, task, stolen))
+      {
+        ProfileTimer timer;
+        run(task);
+        worker.busy_us += (uint64_t) (timer.get_elapsed_ms() * 1000);
+        ++(worker.jobs_run);
+        if (stolen)
+        {
+          ++(worker.jobs_stolen);
+        }
+        continue;
+      }
+
+      boost::mutex::scoped_lock lock(sleep_mutex);
+      if (queued.load() != 0)
+      {
+        continue;
+      }
+      if (stopping)
+      {
+        break;
+      }
+
+      ++(worker.sleeps);
+      sleep_condition.wait(lock);
+    }
+  }
+
+  /// Workers.  Their addresses must not change once the threads start.
+  boost::ptr_vector<Worker> workers;
+
+  /// Number of jobs sitting in queues, across all workers.
+  std::atomic<unsigned int> queued;
+
+  /// Worker to give the next job submitted from outside the pool to.
+  std::atomic<unsigned int> next_worker;
+
+  /// Protects stopping; idle workers and waiters sleep on sleep_condition.
+  boost::mutex sleep_mutex;
+  boost::condition_variable sleep_condition;
+
+  /// Set when the workers should exit once the queues are empty.
+  bool stopping;
+
+  /// Statistics for jobs run by threads waiting on a Counter.
+  std::atomic<unsigned int> helper_jobs_run;
+  std::atomic<uint64_t> helper_busy_us;
+};
+
+JobSystem::JobSystem(unsigned int worker_count)
+  : impl(new Impl())
+{
+  if (worker_count == 0)
+  {
+    worker_count = std::max(1u, boost::thread::hardware_concurrency());
+  }
+
+  for (unsigned int index = 0; index < worker_count; ++index)
+  {
+    impl->workers.push_back(new Impl::Worker());
+  }
+
+  Impl* pool = impl.get();
+  for (unsigned int index = 0; index < worker_count; ++index)
+  {
+    impl->workers[index].thread = boost::thread([pool, index]()
+    {
+      pool->work(index);
+    });
+  }
+
+  std::cout << "Job system started with " << worker_count << " workers."
+            << std::endl;
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    boost::mutex::scoped_lock lock(impl->sleep_mutex);
+    impl->stopping = true;
+  }
+  impl->sleep_condition.notify_all();
+
+  for (Impl::Worker& worker : impl->workers)
+  {
+    worker.thread.join();
+  }
+}
+
+void JobSystem::submit(Job job, Priority priority, Counter* counter)
+{
+  if (counter != nullptr)
+  {
+    ++(counter->pending_);
+  }
+
+  Impl::Task task = { job, counter };
+  impl->push(task, priority);
+}
+
+void JobSystem::submit_after(Counter& dependency,
+                             Job job,
+                             Priority priority,
+                             Counter* counter)
+{
+  if (counter != nullptr)
+  {
+    ++(counter->pending_);
+  }
+
+  {
+    boost::mutex::scoped_lock lock(dependency.mutex_);
+    if (dependency.pending_.load() != 0)
+    {
+      Counter::Continuation continuation = { job, priority, counter };
+      dependency.continuations_.push_back(continuation);
+      return;
+    }
+  }
+
+  Impl::Task task = { job, counter };
+  impl->push(task, priority);
+}
+
+void JobSystem::wait(Counter& counter)
+{
+  int index = impl->get_current_worker();
+  Impl::Task task;
+  bool stolen;
+
+  while (counter.pending_.load() != 0)
+  {
+    if (impl->pop(index, task, stolen))
+    {
+      ProfileTimer timer;
+      impl->run(task);
+      uint64_t busy_us = (uint64_t) (timer.get_elapsed_ms() * 1000);
+
+      if (index >= 0)
+      {
+        Impl::Worker& worker = impl->workers[index];
+        worker.busy_us += busy_us;
+        ++(worker.jobs_run);
+        if (stolen)
+        {
+          ++(worker.jobs_stolen);
+        }
+      }
+      else
+      {
+        impl->helper_busy_us += busy_us;
+        ++(impl->helper_jobs_run);
+      }
+      continue;
+    }
+
+    // Nothing to help with; sleep until a job is queued or a counter
+    // finishes.
+    boost::mutex::scoped_lock lock(impl->sleep_mutex);
+    if ((counter.pending_.load() != 0) && (impl->queued.load() == 0))
+    {
+      impl->sleep_condition.wait(lock);
+    }
+  }
+
+  // Make sure the thread that finished the last job is done with the
+  // counter before the caller is free to destroy it.
+  boost::mutex::scoped_lock lock(counter.mutex_);
+}
+
+void JobSystem::parallel_for(unsigned int count,
+                             unsigned int grain,
+                             std::function<void(unsigned int, unsigned int)> body,
+                             Priority priority)
+{
+  Counter counter;
+  grain = std::max(1u, grain);
+
+  for (unsigned int first = 0; first < count; first += grain)
+  {
+    unsigned int last = std::min(first + grain, count);
+    submit([&body, first, last]()
+    {
+      body(first, last);
+    }, priority, &counter);
+  }
+
+  wait(counter);
+}
+
+unsigned int JobSystem::get_worker_count() const
+{
+  return impl->workers.size();
+}
+
+std::vector<JobSystem::WorkerStats> JobSystem::get_stats() const
+{
+  std::vector<WorkerStats> stats;
+
+  for (Impl::Worker const& worker : impl->workers)
+  {
+    WorkerStats worker_stats;
+    worker_stats.jobs_run = worker.jobs_run.load();
+    worker_stats.jobs_stolen = worker.jobs_stolen.load();
+    worker_stats.sleeps = worker.sleeps.load();
+    worker_stats.busy_ms = worker.busy_us.load() / 1000.0;
+    stats.push_back(worker_stats);
+  }
+
+  WorkerStats helper_stats;
+  helper_stats.jobs_run = impl->helper_jobs_run.load();
+  helper_stats.jobs_stolen = 0;
+  helper_stats.sleeps = 0;
+  helper_stats.busy_ms = impl->helper_busy_us.load() / 1000.0;
+  stats.push_back(helper_stats);
+
+  return stats;
+}
+
+void JobSystem::report() const
+{
+  std::vector<WorkerStats> stats = get_stats();
+
+  for (unsigned int index = 0; index < stats.size(); ++index)
+  {
+    WorkerStats const& worker_stats = stats[index];
+
+    std::cout << "PROFILE: job ";
+    if (index < impl->workers.size())
+    {
+      std::cout << "worker " << index << ": ";
+    }
+    else
+    {
+      std::cout << "waiting threads: ";
+    }
+
+    std::cout << worker_stats.jobs_run << " jobs (" << worker_stats.jobs_stolen
+              << " stolen), " << worker_stats.busy_ms << " ms busy, "
+              << worker_stats.sleeps << " sleeps" << std::endl;
+  }
+}
@@ -0,0 +1,31 @@
+#include "ProfileTimer.h"
+
+#include <iostream>
+
+#include "Settings.h"
+
+ProfileTimer::ProfileTimer(std::string label)
+  : label_(label), start_(boost::chrono::steady_clock::now())
+{
+}
+
+ProfileTimer::~ProfileTimer()
+{
+  if (Settings::debugProfile && !label_.empty())
+  {
+    std::cout << "PROFILE: " << label_ << " took " << get_elapsed_ms()
+              << " ms" << std::endl;
+  }
+}
+
+void ProfileTimer::restart()
+{
+  start_ = boost::chrono::steady_clock::now();
+}
+
+double ProfileTimer::get_elapsed_ms() const
+{
+  boost::chrono::duration<double, boost::milli> elapsed =
+    boost::chrono::steady_clock::now() - start_;
+  return elapsed.count();
+}
@@ -5,34 +5,41 @@
 // *** END ***
 #include "Prop.h"
 
+#include <type_traits>
+
 #include "ErrorMacros.h"
 #include "Inventory.h"
+#include "ProfileTimer.h"
 #include "PropPrototype.h"
+#include "PropSpatialIndex.h"
 #include "Settings.h"
+#include "Stage.h"
 #include "Substance.h"
 
 // === Private Implementation =================================================
 struct Prop::Impl
 {
-  /// Prototype of this prop.
-  const PropPrototype* prototype_;
+  Impl(SerialNumber number)
+    : substance_(nullptr), serialNumber(number)
+  {
+  }
+
+  /// Index of this Prop's slot in the pool and in the hot data arrays.
+  unsigned int slot() const
+  {
+    return serialNumber & index_mask;
+  }
+
+  // --- Cold data ------------------------------------------------------------
+  // Per-Prop data that is rarely touched lives here.  Location, prototype and
+  // flags are in the hot data arrays below, indexed by slot.
 
   /// Material this prop is made out of.
   /// @todo Actually use this -- right now it is ignored.
   const Substance* substance_;
 
-  struct CachedData
-  {
-    /// Boolean indicating wither the prop is solid.
-    bool solid;
-
-    /// Prop's offset within its location, for drawing purposes.
-    sf::Vector3f offset;
-  };
-
-  /// Prop data that is cached from the Prototype instance.
-  /// Members within can be changed independently from the Prototype.
-  CachedData cached_;
+  /// Prop's offset within its location, for drawing purposes.
+  sf::Vector3f offset_;
 
   /// Prop's inventory.
   Inventory inventory_;
@@ -40,36 +47,172 @@ struct Prop::Impl
   /// This Prop's serial number.
   SerialNumber serialNumber;
 
-  /// Location of this Prop.  Must not be null.
-  Inventory* location_;
+  // --- Prop pool ------------------------------------------------------------
+  // Props live in fixed-size pages of raw storage and are constructed in
+  // place, so a Prop never moves once created and creating one doesn't hit
+  // the heap unless a new page is needed.  A SerialNumber packs the slot
+  // index into the low bits and the slot's generation into the high bits;
+  // destroying a Prop bumps the generation, so stale serial numbers are
+  // rejected instead of silently referring to whatever reuses the slot.
 
-  /// Collection of all Props in the game.
-  static boost::ptr_map<SerialNumber, Prop> collection;
+  typedef std::aligned_storage<sizeof(Prop), alignof(Prop)>::type PropStorage;
 
-  /// Next serial number to be allocated to a Prop.
-  static SerialNumber nextSerialNumber;
-};
+  /// Per-slot bookkeeping.
+  struct Slot
+  {
+    /// Current generation of this slot.  Never 0, so 0 is never a valid
+    /// serial number.
+    uint8_t generation;
 
-boost::ptr_map<SerialNumber, Prop> Prop::Impl::collection;
+    /// Position of this slot's serial number in the live list.
+    unsigned int live_position;
+  };
 
-SerialNumber Prop::Impl::nextSerialNumber = 1;
+  /// Number of Props stored per page.
+  static const unsigned int page_size = 4096;
 
-Prop::Prop()
-  : StageComponent(), impl(new Impl())
-{
-  set_prototype("anomaly");
-  move_to(Inventory::getLimbo());
-}
+  /// Number of SerialNumber bits used for the slot index.
+  static const unsigned int index_bits = 24;
+
+  /// Mask for the slot index part of a SerialNumber.
+  static const SerialNumber index_mask = (1u << index_bits) - 1;
+
+  /// Highest generation used before wrapping back to 1.  Kept below 0xFF so
+  /// that no valid serial number can equal SERIALNUMBER_NULL.
+  static const uint8_t max_generation = 0xFE;
+
+  /// Pages of Prop storage.
+  static std::vector<std::unique_ptr<PropStorage[]>> pages;
+
+  /// Bookkeeping for every slot in every page.
+  static std::vector<Slot> slots;
+
+  /// Indices of slots that are free for reuse.
+  static std::vector<unsigned int> free_slots;
 
-Prop::Prop(std::string typeName)
-  : StageComponent(), impl(new Impl())
+  /// Serial numbers of all live Props, packed for linear iteration.
+  static std::vector<SerialNumber> live;
+
+  // --- Hot data -------------------------------------------------------------
+  // Parallel arrays, one entry per slot, holding the fields that per-frame
+  // and per-tick code needs.  Dead slots have no flags set.
+
+  /// Location of the Prop in each slot.  Must not be null for a live Prop
+  /// once it has been constructed.
+  static std::vector<Inventory*> locations;
+
+  /// Prototype ID of the Prop in each slot.
+  static std::vector<PropPrototypeID> prototypes;
+
+  /// HotFlags of the Prop in each slot.
+  static std::vector<uint8_t> flags;
+
+  /// Return a pointer to the storage for a slot.
+  static Prop* slot_pointer(unsigned int index)
+  {
+    return reinterpret_cast<Prop*>(&(pages[index / page_size][index % page_size]));
+  }
+
+  /// Make sure storage exists for at least the requested number of slots.
+  static void grow_to(unsigned int slot_count)
+  {
+    if (slot_count > index_mask + 1)
+    {
+      FATAL_ERROR("Prop pool cannot hold %u Props", slot_count);
+    }
+
+    while (pages.size() * page_size < slot_count)
+    {
+      pages.emplace_back(new PropStorage[page_size]);
+    }
+  }
+
+  /// Claim a free slot and return the serial number it will be known by.
+  /// The Prop itself must then be constructed with slot_pointer().
+  static SerialNumber allocate_slot()
+  {
+    unsigned int index;
+
+    if (!free_slots.empty())
+    {
+      index = free_slots.back();
+      free_slots.pop_back();
+    }
+    else
+    {
+      index = slots.size();
+      grow_to(index + 1);
+      Slot slot;
+      slot.generation = 1;
+      slot.live_position = 0;
+      slots.push_back(slot);
+      locations.push_back(nullptr);
+      prototypes.push_back(PROPPROTOTYPEID_NULL);
+      flags.push_back(0);
+    }
+
+    Slot& slot = slots[index];
+    slot.live_position = live.size();
+    locations[index] = nullptr;
+    flags[index] = FlagAlive;
+
+    SerialNumber number = (((SerialNumber)slot.generation) << index_bits) | index;
+    live.push_back(number);
+    return number;
+  }
+
+  /// Release a slot whose Prop has already been destroyed.
+  static void release_slot(unsigned int index)
+  {
+    Slot& slot = slots[index];
+
+    // Swap the last live serial number into this one's place.
+    SerialNumber moved = live.back();
+    live[slot.live_position] = moved;
+    slots[moved & index_mask].live_position = slot.live_position;
+    live.pop_back();
+
+    locations[index] = nullptr;
+    prototypes[index] = PROPPROTOTYPEID_NULL;
+    flags[index] = 0;
+    slot.generation = (slot.generation == max_generation) ?
+                      1 : slot.generation + 1;
+    free_slots.push_back(index);
+  }
+
+  /// Return the slot index for a serial number, or -1 if it doesn't refer to
+  /// a live Prop.
+  static int find_slot(SerialNumber number)
+  {
+    unsigned int index = number & index_mask;
+    if ((index < slots.size()) && ((flags[index] & FlagAlive) != 0) &&
+        (slots[index].generation == (number >> index_bits)))
+    {
+      return (int)index;
+    }
+    return -1;
+  }
+};
+
+std::vector<std::unique_ptr<Prop::Impl::PropStorage[]>> Prop::Impl::pages;
+std::vector<Prop::Impl::Slot> Prop::Impl::slots;
+std::vector<unsigned int> Prop::Impl::free_slots;
+std::vector<SerialNumber> Prop::Impl::live;
+std::vector<Inventory*> Prop::Impl::locations;
+std::vector<PropPrototypeID> Prop::Impl::prototypes;
+std::vector<uint8_t> Prop::Impl::flags;
+
+Prop::Prop(SerialNumber number,
+           const PropPrototype& type,
+           Inventory& location)
+  : StageComponent(), impl(new Impl(number))
 {
-  set_prototype(typeName);
-  move_to(Inventory::getLimbo());
+  set_prototype(type);
+  move_to(location);
 }
 
-Prop::Prop(Prop& _other)
-  : StageComponent(), impl(new Impl())
+Prop::Prop(SerialNumber number, Prop& _other)
+  : StageComponent(), impl(new Impl(number))
 {
   set_prototype(_other.get_prototype());
   move_to(Inventory::getLimbo());
@@ -86,14 +229,10 @@ void Prop::accept(StageComponentVisitor& visitor)
 
   if (visitChildren)
   {
-    // Visit this block's contents.
-    for (HasLocation* object : impl->inventory_.getContents())
+    // Visit this prop's contents.
+    for (SerialNumber number : impl->inventory_)
     {
-      StageComponent* component = dynamic_cast<StageComponent*>(object);
-      if (component != nullptr)
-      {
-        component->accept(visitor);
-      }
+      Prop::get(number).accept(visitor);
     }
   }
 }
@@ -103,33 +242,70 @@ Inventory& Prop::get_inventory()
   return impl->inventory_;
 }
 
+SerialNumber Prop::get_serial_number() const
+{
+  return impl->serialNumber;
+}
+
 void Prop::set_prototype(std::string typeName)
 {
-  impl->prototype_ = &(PropPrototype::get(typeName));
-  impl->cached_.solid = impl->prototype_->properties.get<bool>("physical.solid",
-                        false);
+  set_prototype(PropPrototype::get(typeName));
 }
 
 void Prop::set_prototype(const PropPrototype& type)
 {
-  impl->prototype_ = &type;
-  impl->cached_.solid = impl->prototype_->properties.get<bool>("physical.solid",
-                        false);
+  unsigned int slot = impl->slot();
+  uint8_t slot_flags = Impl::flags[slot] & FlagAlive;
+
+  if (type.is_solid())
+  {
+    slot_flags |= FlagSolid;
+  }
+
+  switch (type.get_visibility())
+  {
+  case Visibility::Opaque:
+    slot_flags |= FlagVisible | FlagOpaque;
+    break;
+
+  case Visibility::Translucent:
+    slot_flags |= FlagVisible;
+    break;
+
+  default:
+    break;
+  }
+
+  Impl::prototypes[slot] = type.get_id();
+  Impl::flags[slot] = slot_flags;
 }
 
 Visibility Prop::get_visibility(void) const
 {
-  return impl->prototype_->get_visibility();
+  uint8_t slot_flags = Impl::flags[impl->slot()];
+
+  if ((slot_flags & FlagOpaque) != 0)
+  {
+    return Visibility::Opaque;
+  }
+  else if ((slot_flags & FlagVisible) != 0)
+  {
+    return Visibility::Translucent;
+  }
+  else
+  {
+    return Visibility::Invisible;
+  }
 }
 
 bool Prop::is_solid(void)
 {
-  return impl->cached_.solid;
+  return ((Impl::flags[impl->slot()] & FlagSolid) != 0);
 }
 
 const PropPrototype& Prop::get_prototype() const
 {
-  return *(impl->prototype_);
+  return PropPrototype::get(Impl::prototypes[impl->slot()]);
 }
 
 const Substance& Prop::get_substance() const
@@ -139,23 +315,28 @@ const Substance& Prop::get_substance() const
 
 Inventory& Prop::get_location() const
 {
-  return *(impl->location_);
+  return *(Impl::locations[impl->slot()]);
 }
 
 bool Prop::move_to(Inventory& new_location)
 {
+  Inventory*& location = Impl::locations[impl->slot()];
+  StageCoord3 old_position;
+  bool old_position_valid = ((location != nullptr) &&
+                             location->get_position(old_position));
+
   // If current location == new location, just exit!
-  if (impl->location_ == &new_location)
+  if (location == &new_location)
   {
     return true;
   }
 
   // Make sure current location is not NULL; this happens with newly-
   // created objects.
-  if (impl->location_ != nullptr)
+  if (location != nullptr)
   {
     // Try removing it from its current location.
-    if (impl->location_->remove(this) == false)
+    if (location->remove(impl->serialNumber) == false)
     {
       MINOR_ERROR("Could not remove Prop #%u from its current location",
                   impl->serialNumber);
@@ -164,15 +345,15 @@ bool Prop::move_to(Inventory& new_location)
   }
 
   // Try adding to the new location.
-  if (new_location.add(this) == false)
+  if (new_location.add(impl->serialNumber) == false)
   {
     // Couldn't add to new location, so re-add to old one.
     MINOR_ERROR("Could not add Prop #%u to its new location",
                 impl->serialNumber);
 
-    if (impl->location_ != nullptr)
+    if (location != nullptr)
     {
-      impl->location_->add(this);
+      location->add(impl->serialNumber);
     }
     else
     {
@@ -183,29 +364,86 @@ bool Prop::move_to(Inventory& new_location)
     return false;
   }
 
-  impl->location_ = &new_location;
+  location = &new_location;
+
+  // Keep the spatial index up to date.
+  StageCoord3 position;
+  if (new_location.get_position(position))
+  {
+    Stage::get_instance()->get_prop_index().update(impl->serialNumber,
+                                                   position);
+  }
+  else if (old_position_valid)
+  {
+    Stage::get_instance()->get_prop_index().remove(impl->serialNumber);
+  }
+
   return true;
 }
 
 SerialNumber Prop::create(std::string name)
 {
-  Prop* newProp = new Prop(name);
-  SerialNumber propNumber = Impl::nextSerialNumber;
-  newProp->impl->serialNumber = propNumber;
-  Impl::collection.insert(propNumber, newProp);
-  ++(Impl::nextSerialNumber);
+  const PropPrototype& type = PropPrototype::get(name);
+  SerialNumber propNumber = Impl::allocate_slot();
+  new (Impl::slot_pointer(propNumber & Impl::index_mask))
+    Prop(propNumber, type, Inventory::getLimbo());
 
   // Return the new prop's number.
   return propNumber;
 }
 
+void Prop::create(std::string name,
+                  unsigned int count,
+                  std::vector<SerialNumber>& numbers)
+{
+  // Look the prototype up once for the whole batch.
+  const PropPrototype& type = PropPrototype::get(name);
+
+  reserve(count);
+  numbers.reserve(numbers.size() + count);
+
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    SerialNumber propNumber = Impl::allocate_slot();
+    new (Impl::slot_pointer(propNumber & Impl::index_mask))
+      Prop(propNumber, type, Inventory::getLimbo());
+    numbers.push_back(propNumber);
+  }
+}
+
+void Prop::place(std::string name,
+                 std::vector<Inventory*> const& locations,
+                 std::vector<SerialNumber>* numbers)
+{
+  // Look the prototype up once for the whole batch.
+  const PropPrototype& type = PropPrototype::get(name);
+
+  reserve(locations.size());
+  if (numbers != nullptr)
+  {
+    numbers->reserve(numbers->size() + locations.size());
+  }
+
+  for (Inventory* location : locations)
+  {
+    // Construct each Prop straight into its location, skipping limbo.
+    SerialNumber propNumber = Impl::allocate_slot();
+    new (Impl::slot_pointer(propNumber & Impl::index_mask))
+      Prop(propNumber, type, *location);
+
+    if (numbers != nullptr)
+    {
+      numbers->push_back(propNumber);
+    }
+  }
+}
+
 SerialNumber Prop::clone(SerialNumber number)
 {
-  Prop* newProp = new Prop(Prop::get(number));
-  SerialNumber propNumber = Impl::nextSerialNumber;
-  newProp->impl->serialNumber = propNumber;
-  Impl::collection.insert(propNumber, newProp);
-  ++(Impl::nextSerialNumber);
+  Prop& original = Prop::get(number);
+  SerialNumber propNumber = Impl::allocate_slot();
+  new (Impl::slot_pointer(propNumber & Impl::index_mask))
+    Prop(propNumber, original);
 
   // Return the new prop's number.
   return propNumber;
@@ -213,13 +451,35 @@ SerialNumber Prop::clone(SerialNumber number)
 
 bool Prop::destroy(SerialNumber number)
 {
-  if (exists(number))
+  int index = Impl::find_slot(number);
+
+  if (index >= 0)
   {
-    // Try to remove the prop from whatever inventory is might be in.
-    Prop::get(number).move_to(Inventory::getLimbo());
+    Prop* prop = Impl::slot_pointer(index);
+    StageCoord3 position;
+
+    // Anything inside the prop goes to limbo rather than being left with a
+    // dangling location.
+    std::vector<SerialNumber> contents(prop->impl->inventory_.begin(),
+                                       prop->impl->inventory_.end());
+    for (SerialNumber content : contents)
+    {
+      Prop::get(content).move_to(Inventory::getLimbo());
+    }
+
+    // Take the prop out of whatever inventory it is in.
+    if (Impl::locations[index] != nullptr)
+    {
+      Impl::locations[index]->remove(number);
+      if (Impl::locations[index]->get_position(position))
+      {
+        Stage::get_instance()->get_prop_index().remove(number);
+      }
+    }
 
     // Erase the prop from existence.
-    Impl::collection.erase(number);
+    prop->~Prop();
+    Impl::release_slot(index);
     return true;
   }
   else
@@ -233,17 +493,139 @@ bool Prop::destroy(SerialNumber number)
 
 bool Prop::exists(SerialNumber number)
 {
-  return (Impl::collection.count(number) != 0);
+  return (Impl::find_slot(number) >= 0);
 }
 
 Prop& Prop::get(SerialNumber number)
 {
-  if (exists(number))
+  int index = Impl::find_slot(number);
+
+  if (index >= 0)
   {
-    return Impl::collection.at(number);
+    return *(Impl::slot_pointer(index));
   }
   else
   {
     return get(create("anomaly"));
   }
 }
+
+void Prop::reserve(unsigned int count)
+{
+  unsigned int needed = Impl::live.size() + count;
+  Impl::grow_to(needed);
+  Impl::live.reserve(needed);
+
+  // Reserved here rather than as each page is added, so that creating Props
+  // one at a time still grows the slot tables geometrically.
+  unsigned int slot_count = Impl::pages.size() * Impl::page_size;
+  Impl::slots.reserve(slot_count);
+  Impl::locations.reserve(slot_count);
+  Impl::prototypes.reserve(slot_count);
+  Impl::flags.reserve(slot_count);
+}
+
+unsigned int Prop::get_count()
+{
+  return Impl::live.size();
+}
+
+std::vector<SerialNumber> const& Prop::get_all()
+{
+  return Impl::live;
+}
+
+unsigned int Prop::get_slot_index(SerialNumber prop)
+{
+  return prop & Impl::index_mask;
+}
+
+unsigned int Prop::get_slot_count()
+{
+  return Impl::slots.size();
+}
+
+uint8_t const* Prop::get_flags_data()
+{
+  return Impl::flags.data();
+}
+
+PropPrototypeID const* Prop::get_prototype_data()
+{
+  return Impl::prototypes.data();
+}
+
+Inventory* const* Prop::get_location_data()
+{
+  return Impl::locations.data();
+}
+
+Prop& Prop::get_at_slot(unsigned int slot)
+{
+  return *(Impl::slot_pointer(slot));
+}
+
+unsigned int Prop::refresh_prototype(PropPrototypeID id)
+{
+  PropPrototype const& type = PropPrototype::get(id);
+  unsigned int count = 0;
+
+  for (unsigned int slot = 0; slot < Impl::slots.size(); ++slot)
+  {
+    if (((Impl::flags[slot] & FlagAlive) != 0) &&
+        (Impl::prototypes[slot] == id))
+    {
+      get_at_slot(slot).set_prototype(type);
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+void Prop::benchmark(unsigned int count)
+{
+  std::cout << "Benchmarking " << count << " Props..." << std::endl;
+
+  std::vector<SerialNumber> numbers;
+  unsigned int solid_count = 0;
+  ProfileTimer timer;
+
+  create("grass", count, numbers);
+  std::cout << "  Bulk create: " << timer.get_elapsed_ms() << " ms"
+            << std::endl;
+
+  timer.restart();
+  for (SerialNumber number : numbers)
+  {
+    solid_count += get(number).is_solid() ? 1 : 0;
+  }
+  std::cout << "  Lookup by serial number: " << timer.get_elapsed_ms()
+            << " ms" << std::endl;
+
+  timer.restart();
+  for (SerialNumber number : get_all())
+  {
+    solid_count += get(number).is_solid() ? 1 : 0;
+  }
+  std::cout << "  Iterate over all: " << timer.get_elapsed_ms() << " ms"
+            << std::endl;
+
+  timer.restart();
+  unsigned int slot_count = get_slot_count();
+  uint8_t const* slot_flags = get_flags_data();
+  for (unsigned int slot = 0; slot < slot_count; ++slot)
+  {
+    solid_count += ((slot_flags[slot] & FlagSolid) != 0) ? 1 : 0;
+  }
+  std::cout << "  Scan hot flags: " << timer.get_elapsed_ms() << " ms"
+            << std::endl;
+
+  timer.restart();
+  for (SerialNumber number : numbers)
+  {
+    destroy(number);
+  }
+  std::cout << "  Destroy: " << timer.get_elapsed_ms() << " ms ("
+            << solid_count << " solid lookups)" << std::endl;
+}
@@ -11,11 +11,14 @@
 
 #include "PropPrototype.h"
 
+#include "DescriptorDatabase.h"
 #include "ErrorMacros.h"
 #include "Settings.h"
+#include "SubstanceLibrary.h"
 #include "TextureAtlas.h"
 
 boost::ptr_map<std::string, PropPrototype> PropPrototype::collection;
+std::vector<PropPrototype*> PropPrototype::collection_by_id;
 
 typedef boost::filesystem::path TypePath;
 typedef boost::container::vector<std::string> NameVector;
@@ -32,8 +35,7 @@ void PropPrototype::initialize()
             << std::endl;
 
   // Before anything else we create the "anomaly" prop type.
-  std::string tag = "anomaly";
-  collection.insert(tag, new PropPrototype("anomaly"));
+  add("anomaly");
 
   // Scan through the "./data/props" directory to find all prop type descriptors.
   TypePath typePath
@@ -72,12 +74,14 @@ void PropPrototype::initialize()
 
       if (names.size() != 0)
       {
+        // Sort the names so IDs don't depend on directory order.
+        std::sort(names.begin(), names.end());
+
         // Attempt to load data for each file seen.
         for (NameIterator iter
       { names.begin() }; iter != names.end(); ++iter)
         {
-          std::string tag = *iter;
-          collection.insert(tag, new PropPrototype(tag));
+          add(*iter);
         }
       }
       else
@@ -110,18 +114,81 @@ PropPrototype& PropPrototype::get(std::string name)
   }
 }
 
+PropPrototype& PropPrototype::get(PropPrototypeID id)
+{
+  if (id < collection_by_id.size())
+  {
+    return *(collection_by_id[id]);
+  }
+  else
+  {
+    MINOR_ERROR("Unable to find prop prototype #%u, returning \"anomaly\"",
+                (unsigned int)id);
+    return *(collection_by_id[0]);
+  }
+}
+
+unsigned int PropPrototype::get_count()
+{
+  return collection_by_id.size();
+}
+
+bool PropPrototype::reload(std::string name)
+{
+  if (collection.count(name) == 0)
+  {
+    MINOR_ERROR("Prop prototype \"%s\" is new; restart to load it",
+                name.c_str());
+    return false;
+  }
+
+  boost::property_tree::ptree properties;
+
+  // A file that doesn't parse is most likely still being edited, so the old
+  // type is kept until it is saved again.
+  try
+  {
+    DescriptorDatabase::instance()->read(DescriptorDatabase::Section::Props,
+                                         name, properties);
+  }
+  catch (std::exception& e)
+  {
+    MINOR_ERROR("Can't reload \"%s\" descriptor file: %s",
+                name.c_str(), e.what());
+    return false;
+  }
+
+  // The descriptor is parsed outside the lock; only the swap holds up the
+  // renderer.
+  boost::mutex::scoped_lock lock(SL->get_reload_mutex());
+  PropPrototype& type = collection.at(name);
+  type.properties.swap(properties);
+  type.cache_properties();
+  return true;
+}
+
 // *** Private Methods ********************************************************
 
-PropPrototype::PropPrototype(std::string _name)
+void PropPrototype::add(std::string name)
 {
-  bool is_opaque, is_visible;
+  if (collection.count(name) == 0)
+  {
+    PropPrototype* type = new PropPrototype(name);
+    type->id = collection_by_id.size();
+    collection_by_id.push_back(type);
+    collection.insert(name, type);
+  }
+}
 
+PropPrototype::PropPrototype(std::string _name)
+{
   name = _name;
 
   // Attempt to load the property tree for this prop.
   try
   {
-    read_xml("data/props/" + name + ".xml", properties);
+    DescriptorDatabase::instance()->read(DescriptorDatabase::Section::Props,
+                                         name, properties);
   }
   catch (std::exception& e)
   {
@@ -129,6 +196,16 @@ PropPrototype::PropPrototype(std::string _name)
                 _name.c_str(), e.what());
   }
 
+  cache_properties();
+}
+
+void PropPrototype::cache_properties()
+{
+  bool is_opaque, is_visible;
+
+  materialMustBe.clear();
+  materialShouldBe.clear();
+
   // Determine visibility.
   // TODO: replace display.opaque, display.visible with single "display.visibility" attribute.
   is_opaque = properties.get<bool>("display.opaque", true);
@@ -167,6 +244,8 @@ PropPrototype::PropPrototype(std::string _name)
 
   cached_colorize = properties.get<bool>("display.colorize", false);
 
+  cached_solid = properties.get<bool>("physical.solid", false);
+
   // Cache substance "must be" category information.
   try
   {
@@ -227,38 +306,3 @@ const sf::Font& PropPrototype::getUnicodeFont()
 
   return _font;
 }
-
-void PropPrototype::drawTextOntoTexture(sf::Text& renderText,
-                                        sf::RenderTexture& renderTexture,
-                                        bool outline,
-                                        bool invert)
-{
-  sf::FloatRect textBounds = renderText.getGlobalBounds();
-
-  sf::Color textColor = (invert ? sf::Color::Transparent : sf::Color::White);
-  sf::Color backColor = (invert ? sf::Color::White : sf::Color::Transparent);
-  sf::Color outlineColor = sf::Color(0, 0, 0, 128);
-
-  renderTexture.create(textBounds.width, textBounds.height);
-  renderTexture.clear(backColor);
-
-  if (outline)
-  {
-    // Draw an outline by copying silhouettes U/D/L/R.
-    renderText.setColor(outlineColor);
-    renderText.setPosition(-textBounds.left + 1, -textBounds.top);
-    renderTexture.draw(renderText);
-    renderText.setPosition(-textBounds.left, -textBounds.top + 1);
-    renderTexture.draw(renderText);
-    renderText.setPosition(-textBounds.left - 1, -textBounds.top);
-    renderTexture.draw(renderText);
-    renderText.setPosition(-textBounds.left, -textBounds.top - 1);
-    renderTexture.draw(renderText);
-  }
-
-  renderText.setColor(textColor);
-  renderText.setPosition(-textBounds.left, -textBounds.top);
-  renderTexture.draw(renderText);
-
-  renderTexture.display();
-}
@@ -0,0 +1,329 @@
+#include "PropSpatialIndex.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "ErrorMacros.h"
+#include "ProfileTimer.h"
+#include "Prop.h"
+#include "StageChunk.h"
+
+struct PropSpatialIndex::Impl
+{
+  /// A Prop and its position, as stored in a cell.
+  struct Entry
+  {
+    SerialNumber prop;
+    StageCoord3 position;
+  };
+
+  /// Where a Prop's entry is, indexed by Prop slot.
+  struct EntryLocation
+  {
+    unsigned int cell;
+    unsigned int position_in_cell;
+  };
+
+  /// Value of EntryLocation::cell for Props that aren't indexed.
+  static const unsigned int no_cell = (unsigned int)(-1);
+
+  /// Width and depth of a cell.  Divides StageChunk::chunk_side_length, so
+  /// cells never straddle a chunk boundary.
+  static const int cell_side_length = 8;
+
+  Impl(StageCoord3 stage_size)
+    : size(stage_size), count(0)
+  {
+    cells_x = (size.x + cell_side_length - 1) /
+              cell_side_length;
+    cells_y = (size.y + cell_side_length - 1) /
+              cell_side_length;
+    cells_z = size.z;
+    cells.resize(cells_x * cells_y * cells_z);
+  }
+
+  bool in_bounds(StageCoord3 const& position) const
+  {
+    return ((position.x >= 0) && (position.y >= 0) && (position.z >= 0) &&
+            (position.x < size.x) && (position.y < size.y) &&
+            (position.z < size.z));
+  }
+
+  unsigned int get_cell_index(StageCoord3 const& position) const
+  {
+    return (((position.z * cells_y) +
+             (position.y / cell_side_length)) * cells_x) +
+           (position.x / cell_side_length);
+  }
+
+  EntryLocation* find(SerialNumber prop)
+  {
+    unsigned int slot = Prop::get_slot_index(prop);
+    if ((slot < locations.size()) && (locations[slot].cell != no_cell) &&
+        (cells[locations[slot].cell][locations[slot].position_in_cell].prop ==
+         prop))
+    {
+      return &(locations[slot]);
+    }
+    return nullptr;
+  }
+
+  /// Call a functor for every entry within a box (inclusive).
+  template <typename Functor>
+  void for_each_in_box(StageCoord3 const& min_corner,
+                       StageCoord3 const& max_corner,
+                       Functor functor) const
+  {
+    int min_x = std::max<int>(min_corner.x, 0);
+    int min_y = std::max<int>(min_corner.y, 0);
+    int min_z = std::max<int>(min_corner.z, 0);
+    int max_x = std::min<int>(max_corner.x, size.x - 1);
+    int max_y = std::min<int>(max_corner.y, size.y - 1);
+    int max_z = std::min<int>(max_corner.z, size.z - 1);
+
+    if ((min_x > max_x) || (min_y > max_y) || (min_z > max_z))
+    {
+      return;
+    }
+
+    int cell_min_x = min_x / cell_side_length;
+    int cell_min_y = min_y / cell_side_length;
+    int cell_max_x = max_x / cell_side_length;
+    int cell_max_y = max_y / cell_side_length;
+
+    for (int z = min_z; z <= max_z; ++z)
+    {
+      for (int cell_y = cell_min_y; cell_y <= cell_max_y; ++cell_y)
+      {
+        for (int cell_x = cell_min_x; cell_x <= cell_max_x; ++cell_x)
+        {
+          std::vector<Entry> const& cell =
+            cells[(((z * cells_y) + cell_y) * cells_x) + cell_x];
+
+          for (Entry const& entry : cell)
+          {
+            if ((entry.position.x >= min_x) && (entry.position.x <= max_x) &&
+                (entry.position.y >= min_y) && (entry.position.y <= max_y))
+            {
+              functor(entry);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /// Take an entry out of its cell, moving the cell's last entry into the gap.
+  void erase(EntryLocation& location)
+  {
+    std::vector<Entry>& cell = cells[location.cell];
+    Entry& last = cell.back();
+    cell[location.position_in_cell] = last;
+    locations[Prop::get_slot_index(last.prop)].position_in_cell =
+      location.position_in_cell;
+    cell.pop_back();
+    location.cell = no_cell;
+    --count;
+  }
+
+  /// Stage size covered by the index.
+  StageCoord3 size;
+
+  /// Number of cells along each axis.
+  int cells_x, cells_y, cells_z;
+
+  /// Entries in each cell, in no particular order.
+  std::vector<std::vector<Entry>> cells;
+
+  /// Location of each Prop's entry, indexed by Prop slot.
+  std::vector<EntryLocation> locations;
+
+  /// Total number of entries.
+  unsigned int count;
+};
+
+PropSpatialIndex::PropSpatialIndex(StageCoord3 stage_size)
+  : impl(new Impl(stage_size))
+{
+}
+
+PropSpatialIndex::~PropSpatialIndex()
+{
+}
+
+bool PropSpatialIndex::update(SerialNumber prop, StageCoord3 const& position)
+{
+  if (!impl->in_bounds(position))
+  {
+    MINOR_ERROR("Prop #%u position (%d, %d, %d) is outside the stage",
+                prop, position.x, position.y, position.z);
+    return false;
+  }
+
+  unsigned int cell_index = impl->get_cell_index(position);
+  Impl::EntryLocation* location = impl->find(prop);
+
+  if (location != nullptr)
+  {
+    if (location->cell == cell_index)
+    {
+      // Same cell, so just update the position.
+      impl->cells[cell_index][location->position_in_cell].position = position;
+      return true;
+    }
+    impl->erase(*location);
+  }
+  else
+  {
+    unsigned int slot = Prop::get_slot_index(prop);
+    if (slot >= impl->locations.size())
+    {
+      Impl::EntryLocation empty = { Impl::no_cell, 0 };
+      impl->locations.resize(slot + 1, empty);
+    }
+    location = &(impl->locations[slot]);
+  }
+
+  std::vector<Impl::Entry>& cell = impl->cells[cell_index];
+  Impl::Entry entry = { prop, position };
+  location->cell = cell_index;
+  location->position_in_cell = cell.size();
+  cell.push_back(entry);
+  ++(impl->count);
+  return true;
+}
+
+bool PropSpatialIndex::remove(SerialNumber prop)
+{
+  Impl::EntryLocation* location = impl->find(prop);
+  if (location == nullptr)
+  {
+    return false;
+  }
+  impl->erase(*location);
+  return true;
+}
+
+bool PropSpatialIndex::contains(SerialNumber prop) const
+{
+  return (impl->find(prop) != nullptr);
+}
+
+unsigned int PropSpatialIndex::get_count() const
+{
+  return impl->count;
+}
+
+void PropSpatialIndex::query_box(StageCoord3 const& min_corner,
+                                 StageCoord3 const& max_corner,
+                                 std::vector<SerialNumber>& props) const
+{
+  impl->for_each_in_box(min_corner, max_corner,
+                        [&](Impl::Entry const& entry)
+  {
+    props.push_back(entry.prop);
+  });
+}
+
+void PropSpatialIndex::query_radius(StageCoord3 const& center,
+                                    int radius,
+                                    std::vector<SerialNumber>& props) const
+{
+  StageCoord3 min_corner(std::max(center.x - radius, -1),
+                         std::max(center.y - radius, -1),
+                         std::max(center.z - radius, -1));
+  StageCoord3 max_corner(std::min<int>(center.x + radius, impl->size.x),
+                         std::min<int>(center.y + radius, impl->size.y),
+                         std::min<int>(center.z + radius, impl->size.z));
+  int radius_squared = radius * radius;
+
+  // Walk the bounding box, keeping only what's inside the sphere.
+  impl->for_each_in_box(min_corner, max_corner,
+                        [&](Impl::Entry const& entry)
+  {
+    int dx = entry.position.x - center.x;
+    int dy = entry.position.y - center.y;
+    int dz = entry.position.z - center.z;
+    if ((dx * dx) + (dy * dy) + (dz * dz) <= radius_squared)
+    {
+      props.push_back(entry.prop);
+    }
+  });
+}
+
+void PropSpatialIndex::benchmark(StageCoord3 stage_size, unsigned int count)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  std::cout << "Benchmarking spatial index with " << count << " entries..."
+            << std::endl;
+
+  PropSpatialIndex index(stage_size);
+  boost::random::mt19937 twister(1);
+  boost::random::uniform_int_distribution<> random_x(0, stage_size.x - 1);
+  boost::random::uniform_int_distribution<> random_y(0, stage_size.y - 1);
+  boost::random::uniform_int_distribution<> random_z(0, stage_size.z - 1);
+  boost::random::uniform_int_distribution<> random_step(-1, 1);
+
+  // Dummy serial numbers.  These have a generation of 0, so they can't
+  // belong to a real Prop, but they map to slots just the same.
+  std::vector<SerialNumber> props(count);
+  std::vector<StageCoord3> positions(count);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    props[i] = i;
+    positions[i] = StageCoord3(random_x(twister), random_y(twister),
+                               random_z(twister));
+  }
+
+  ProfileTimer timer;
+
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    index.update(props[i], positions[i]);
+  }
+  std::cout << "  Insert: " << timer.get_elapsed_ms() << " ms" << std::endl;
+
+  // Move everything by up to one block in each direction.
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    StageCoord3& position = positions[i];
+    position.x = std::min(std::max(position.x + random_step(twister), 0),
+                          stage_size.x - 1);
+    position.y = std::min(std::max(position.y + random_step(twister), 0),
+                          stage_size.y - 1);
+  }
+  timer.restart();
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    index.update(props[i], positions[i]);
+  }
+  std::cout << "  Move: " << timer.get_elapsed_ms() << " ms" << std::endl;
+
+  std::vector<SerialNumber> found;
+  unsigned int query_count = 10000;
+  unsigned int found_count = 0;
+  timer.restart();
+  for (unsigned int i = 0; i < query_count; ++i)
+  {
+    found.clear();
+    index.query_radius(positions[i % count], 8, found);
+    found_count += found.size();
+  }
+  std::cout << "  " << query_count << " radius-8 queries: "
+            << timer.get_elapsed_ms() << " ms (" << found_count
+            << " found)" << std::endl;
+
+  timer.restart();
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    index.remove(props[i]);
+  }
+  std::cout << "  Remove: " << timer.get_elapsed_ms() << " ms" << std::endl;
+}
@@ -13,6 +13,13 @@ bool Settings::debugMapRevealAll;
 bool Settings::debugDieOnMinorError;
 bool Settings::debugDieOnMajorError;
 bool Settings::debugShowVerboseInfo;
+bool Settings::debugProfile;
+unsigned int Settings::debugBenchmarkProps;
+bool Settings::debugHotReload;
+unsigned int Settings::debugHotReloadPollMs;
+
+BlockLayout Settings::stageBlockLayout;
+bool Settings::stageSubstanceIndex;
 
 StageCoord3 Settings::terrainSize;
 StageCoord Settings::terrainStageHeight;
@@ -32,7 +39,16 @@ int Settings::terrainVeinDensity;
 int Settings::terrainSingleDensity;
 bool Settings::terrainGanguePresent;
 
+double Settings::simulationColumnRate;
+double Settings::simulationColumnBudget;
+double Settings::simulationFluidRate;
+double Settings::simulationFluidBudget;
+unsigned int Settings::simulationMaxCatchUp;
+
+unsigned int Settings::jobsWorkerCount;
+
 bool Settings::renderLoadTextures;
+unsigned int Settings::renderFrameRateLimit;
 unsigned int Settings::renderGeneratedTextureSize;
 
 void Settings::Initialize()
@@ -63,6 +79,29 @@ void Settings::Initialize()
   debugDieOnMajorError = properties.get<bool>("debug.code.dieonmajorerror",
                          false);
   debugShowVerboseInfo = properties.get<bool>("debug.code.verbose", false);
+  debugProfile = properties.get<bool>("debug.code.profile", false);
+  debugBenchmarkProps = properties.get<unsigned int>("debug.code.benchmarkprops",
+                        0);
+  debugHotReload = properties.get<bool>("debug.code.hotreload", false);
+  debugHotReloadPollMs = properties.get<unsigned int>(
+                           "debug.code.hotreloadpollms", 500);
+
+  std::string block_layout = properties.get<std::string>("stage.blocklayout",
+                             "linear");
+  if (block_layout == "tiled")
+  {
+    stageBlockLayout = BlockLayout::Tiled;
+  }
+  else if (block_layout == "morton")
+  {
+    stageBlockLayout = BlockLayout::Morton;
+  }
+  else
+  {
+    stageBlockLayout = BlockLayout::Linear;
+  }
+
+  stageSubstanceIndex = properties.get<bool>("stage.substanceindex", true);
 
   terrainSize.x = properties.get<StageCoord>("terrain.size.x", 128);
   terrainSize.y = properties.get<StageCoord>("terrain.size.y", 128);
@@ -88,7 +127,19 @@ void Settings::Initialize()
   terrainSingleDensity = properties.get<int>("terrain.singledensity", 5);
   terrainGanguePresent = properties.get<bool>("terrain.ganguepresent", true);
 
+  simulationColumnRate = properties.get<double>("simulation.columns.rate", 10);
+  simulationColumnBudget = properties.get<double>("simulation.columns.budget",
+                           5);
+  simulationFluidRate = properties.get<double>("simulation.fluids.rate", 10);
+  simulationFluidBudget = properties.get<double>("simulation.fluids.budget", 20);
+  simulationMaxCatchUp = properties.get<unsigned int>("simulation.maxcatchup",
+                         4);
+
+  jobsWorkerCount = properties.get<unsigned int>("jobs.workers", 0);
+
   renderLoadTextures = properties.get<bool>("render.loadtextures", true);
+  renderFrameRateLimit = properties.get<unsigned int>("render.frameratelimit",
+                                                      60);
   renderGeneratedTextureSize = properties.get("render.generatedtexturesize", 64);
 }
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <SFML/Graphics.hpp>
 
 #include "SimpleMatrixFont.h"
@@ -35,7 +36,46 @@ bool SimpleMatrixFont::load(std::string name)
   // TODO: setting choosing whether "magic purple" should be treated as a mask
   image.createMaskFromColor(sf::Color(255, 0, 255));
 
-  return impl->font_texture.loadFromImage(image);
+  // Build the glyph atlas: the glyphs on top, and their outlines below.
+  // Only alpha is used when drawing, so an outline is just each glyph's
+  // alpha spread one pixel up, down, left and right, without crossing into
+  // the neighboring glyph.
+  sf::Vector2u size = image.getSize();
+  sf::Image atlas;
+  atlas.create(size.x, size.y * 2, sf::Color(255, 255, 255, 0));
+  atlas.copy(image, 0, 0);
+
+  for (unsigned int y = 0; y < size.y; ++y)
+  {
+    unsigned int cell_y = y % impl->glyph_size.y;
+
+    for (unsigned int x = 0; x < size.x; ++x)
+    {
+      unsigned int cell_x = x % impl->glyph_size.x;
+      sf::Uint8 alpha = image.getPixel(x, y).a;
+
+      if (cell_x > 0)
+      {
+        alpha = std::max(alpha, image.getPixel(x - 1, y).a);
+      }
+      if (cell_x + 1 < impl->glyph_size.x)
+      {
+        alpha = std::max(alpha, image.getPixel(x + 1, y).a);
+      }
+      if (cell_y > 0)
+      {
+        alpha = std::max(alpha, image.getPixel(x, y - 1).a);
+      }
+      if (cell_y + 1 < impl->glyph_size.y)
+      {
+        alpha = std::max(alpha, image.getPixel(x, y + 1).a);
+      }
+
+      atlas.setPixel(x, size.y + y, sf::Color(255, 255, 255, alpha));
+    }
+  }
+
+  return impl->font_texture.loadFromImage(atlas);
 }
 
 void SimpleMatrixFont::bind()
@@ -53,12 +93,20 @@ glm::vec4 SimpleMatrixFont::getTextureCoordinates(char32_t character)
   unsigned int xLocation = (unsigned int)character % impl->glyph_count.x;
   unsigned int yLocation = (unsigned int)character / impl->glyph_count.x;
   float xCoord = (float)xLocation / (float)impl->glyph_count.x;
-  float yCoord = (float)yLocation / (float)impl->glyph_count.y;
+  float yCoord = (float)yLocation / (float)(impl->glyph_count.y * 2);
   float xSize = 1 / (float)impl->glyph_count.x;
-  float ySize = 1 / (float)impl->glyph_count.y;
+  float ySize = 1 / (float)(impl->glyph_count.y * 2);
   return glm::vec4(xCoord, yCoord, xSize, ySize);
 }
 
+glm::vec4 SimpleMatrixFont::getOutlineTextureCoordinates(char32_t character)
+{
+  // The outlines are in the bottom half of the texture.
+  glm::vec4 coords = getTextureCoordinates(character);
+  coords.t += 0.5f;
+  return coords;
+}
+
 glm::vec2 SimpleMatrixFont::getGlyphSize(char32_t character)
 {
   return glm::vec2(impl->glyph_size.x, impl->glyph_size.y);
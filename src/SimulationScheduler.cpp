@@ -0,0 +1,200 @@
+#include "SimulationScheduler.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/chrono.hpp>
+
+#include "ErrorMacros.h"
+#include "ProfileTimer.h"
+
+struct SimulationScheduler::Impl
+{
+  typedef boost::chrono::steady_clock Clock;
+
+  /// Scheduling data for one system.
+  struct System
+  {
+    /// Function called to tick the system.
+    TickFunction tick;
+
+    /// Time between ticks.
+    Clock::duration step;
+
+    /// Time owed to the system that hasn't been ticked yet.
+    Clock::duration owed;
+  };
+
+  /// Systems, in the order they were added.
+  std::vector<System> systems;
+
+  /// Statistics, in the same order as systems.
+  std::vector<SystemStats> stats;
+
+  /// Most ticks a system may run in one update().
+  unsigned int max_catch_up;
+
+  /// Time of the last update().
+  Clock::time_point last_update;
+
+  /// False until the first update() after construction or reset().
+  bool started;
+};
+
+SimulationScheduler::SimulationScheduler(unsigned int max_catch_up)
+  : impl(new Impl())
+{
+  impl->max_catch_up = std::max(1u, max_catch_up);
+  impl->started = false;
+}
+
+SimulationScheduler::~SimulationScheduler()
+{
+}
+
+void SimulationScheduler::add_system(std::string name,
+                                     double rate,
+                                     double budget_ms,
+                                     TickFunction tick)
+{
+  if (rate <= 0)
+  {
+    MAJOR_ERROR("Simulation system \"%s\" has invalid rate %f",
+                name.c_str(), rate);
+    return;
+  }
+
+  Impl::System system;
+  system.tick = tick;
+  system.step = boost::chrono::duration_cast<Impl::Clock::duration>(
+                  boost::chrono::duration<double>(1.0 / rate));
+  system.owed = Impl::Clock::duration::zero();
+  impl->systems.push_back(system);
+
+  SystemStats stats;
+  stats.name = name;
+  stats.rate = rate;
+  stats.budget_ms = budget_ms;
+  stats.ticks = 0;
+  stats.total_ms = 0;
+  stats.last_ms = 0;
+  stats.max_ms = 0;
+  stats.overruns = 0;
+  stats.catch_up_ticks = 0;
+  stats.dropped_ticks = 0;
+  impl->stats.push_back(stats);
+}
+
+void SimulationScheduler::update()
+{
+  Impl::Clock::time_point now = Impl::Clock::now();
+
+  if (!impl->started)
+  {
+    impl->last_update = now;
+    impl->started = true;
+    return;
+  }
+
+  Impl::Clock::duration elapsed = now - impl->last_update;
+  impl->last_update = now;
+
+  for (unsigned int index = 0; index < impl->systems.size(); ++index)
+  {
+    Impl::System& system = impl->systems[index];
+    SystemStats& stats = impl->stats[index];
+    unsigned int ticks_run = 0;
+
+    system.owed += elapsed;
+
+    while ((system.owed >= system.step) && (ticks_run < impl->max_catch_up))
+    {
+      ProfileTimer timer;
+      system.tick();
+      double elapsed_ms = timer.get_elapsed_ms();
+
+      ++(stats.ticks);
+      stats.total_ms += elapsed_ms;
+      stats.last_ms = elapsed_ms;
+      stats.max_ms = std::max(stats.max_ms, elapsed_ms);
+      if (elapsed_ms > stats.budget_ms)
+      {
+        ++(stats.overruns);
+      }
+
+      system.owed -= system.step;
+      ++ticks_run;
+    }
+
+    if (ticks_run > 1)
+    {
+      stats.catch_up_ticks += ticks_run - 1;
+    }
+
+    // Still behind after the catch-up limit?  Drop the rest.
+    if (system.owed >= system.step)
+    {
+      Impl::Clock::duration::rep dropped = system.owed / system.step;
+      stats.dropped_ticks += dropped;
+      system.owed -= system.step * dropped;
+    }
+  }
+}
+
+void SimulationScheduler::reset()
+{
+  impl->started = false;
+  for (Impl::System& system : impl->systems)
+  {
+    system.owed = Impl::Clock::duration::zero();
+  }
+}
+
+double SimulationScheduler::get_ms_until_next_tick() const
+{
+  if (impl->systems.empty())
+  {
+    return -1;
+  }
+
+  if (!impl->started)
+  {
+    return 0;
+  }
+
+  Impl::Clock::duration elapsed = Impl::Clock::now() - impl->last_update;
+  Impl::Clock::duration soonest = Impl::Clock::duration::max();
+
+  for (Impl::System const& system : impl->systems)
+  {
+    soonest = std::min(soonest, system.step - system.owed - elapsed);
+  }
+
+  if (soonest <= Impl::Clock::duration::zero())
+  {
+    return 0;
+  }
+
+  return boost::chrono::duration<double, boost::milli>(soonest).count();
+}
+
+std::vector<SimulationScheduler::SystemStats> const&
+SimulationScheduler::get_stats() const
+{
+  return impl->stats;
+}
+
+void SimulationScheduler::report() const
+{
+  for (SystemStats const& stats : impl->stats)
+  {
+    double average_ms = (stats.ticks > 0) ? (stats.total_ms / stats.ticks) : 0;
+
+    std::cout << "PROFILE: simulation system \"" << stats.name << "\": "
+              << stats.ticks << " ticks at " << stats.rate << "/s, "
+              << average_ms << " ms avg, " << stats.max_ms << " ms max, "
+              << stats.overruns << " over " << stats.budget_ms
+              << " ms budget, " << stats.catch_up_ticks << " catch-up, "
+              << stats.dropped_ticks << " dropped" << std::endl;
+  }
+}
@@ -6,12 +6,18 @@
 #include "Application.h"
 #include "ColumnData.h"
 #include "CubicBezier.h"
+#include "DescriptorDatabase.h"
 #include "ErrorMacros.h"
 #include "FaceBools.h"
+#include "FileWatcher.h"
+#include "FluidSimulator.h"
 #include "MathUtils.h"
 #include "NoiseField.h"
 #include "Prop.h"
+#include "PropPrototype.h"
+#include "PropSpatialIndex.h"
 #include "Settings.h"
+#include "SimulationScheduler.h"
 #include "StageBlock.h"
 #include "StageBuilderBeaches.h"
 #include "StageBuilderDeposits.h"
@@ -23,7 +29,11 @@
 #include "StageBuilderTerrain.h"
 #include "StageChunk.h"
 #include "StageChunkCollection.h"
+#include "SubstanceChunkIndex.h"
+#include "SubstanceLibrary.h"
 
+#include <atomic>
+#include <boost/filesystem.hpp>
 #include <stddef.h>
 #include <iostream>
 #include <cassert>
@@ -135,6 +145,106 @@ struct Stage::Impl
     min_terrain_height_ = min_height;
   }
 
+  /// Reload any substance and prop descriptors that have changed on disk,
+  /// and re-render only the chunks that have the reloaded substances in them.
+  /// This runs synchronously on the processing thread, so the simulation
+  /// waits while the changed files are parsed; the renderer only waits
+  /// while the results are swapped in.
+  void reload_changed_descriptors()
+  {
+    std::vector<std::string> changes = descriptor_watcher->take_changes();
+    if (changes.empty())
+    {
+      return;
+    }
+
+    std::vector<std::string> substance_names;
+    std::vector<std::string> prop_names;
+
+    for (std::string const& change : changes)
+    {
+      boost::filesystem::path path(change);
+      std::string name = path.stem().generic_string();
+
+      if (path.parent_path().generic_string() == "data/substances")
+      {
+        substance_names.push_back(name);
+      }
+      else
+      {
+        prop_names.push_back(name);
+      }
+    }
+
+    // The compiled database doesn't have the edits in it.
+    DescriptorDatabase* database = DescriptorDatabase::instance();
+    if (database->is_open())
+    {
+      std::cout << "Descriptor files have changed; reading descriptors from "
+                << "XML from now on." << std::endl;
+      database->close();
+    }
+
+    SubstanceLibraryShPtr library = SL;
+    std::vector<SubstanceID> substances = library->reload(substance_names);
+    unsigned int chunk_count = 0;
+
+    if (!substances.empty())
+    {
+      boost::dynamic_bitset<> reloaded(library->get_substance_count());
+      for (SubstanceID id : substances)
+      {
+        reloaded.set(id);
+      }
+
+      fluids->refresh_substances();
+
+      // Only chunks that have the substances in them need looking at; without
+      // the index, that means all of them.
+      SubstanceChunkIndex* index = chunks->get_substance_index();
+      boost::dynamic_bitset<> affected;
+      if (index != nullptr)
+      {
+        affected = index->get_chunks(reloaded);
+      }
+      else
+      {
+        affected.resize(chunks->get_chunk_count());
+        affected.set();
+      }
+
+      for (size_t chunk_index = affected.find_first();
+           chunk_index != boost::dynamic_bitset<>::npos;
+           chunk_index = affected.find_next(chunk_index))
+      {
+        StageChunk& chunk = chunks->getChunk(chunk_index);
+        if (chunk.refresh_substances(reloaded))
+        {
+          StageCoord3 const& coords = chunk.get_coords();
+          fluids->wake(coords.x, coords.y, coords.z);
+          ++chunk_count;
+        }
+      }
+    }
+
+    unsigned int type_count = 0;
+    unsigned int prop_count = 0;
+
+    for (std::string const& name : prop_names)
+    {
+      if (PropPrototype::reload(name))
+      {
+        prop_count += Prop::refresh_prototype(PropPrototype::get(name).get_id());
+        ++type_count;
+      }
+    }
+
+    std::cout << "Reloaded " << substances.size() << " substance(s), "
+              << "marking " << chunk_count << " chunk(s) for re-rendering, "
+              << "and " << type_count << " prop type(s), used by "
+              << prop_count << " prop(s)." << std::endl;
+  }
+
   /// This function returns true if the specified coordinates are in-bounds.
   inline bool valid_coordinates(StageCoord x, StageCoord y, StageCoord z) const
   {
@@ -148,6 +258,22 @@ struct Stage::Impl
   /// Collection of all chunks comprising the stage.
   std::unique_ptr<StageChunkCollection> chunks;
 
+  /// Spatial index of the Props on the stage.
+  std::unique_ptr<PropSpatialIndex> prop_index;
+
+  /// Liquid simulation, created once terrain generation is complete.
+  std::unique_ptr<FluidSimulator> fluids;
+
+  /// Scheduler for the systems that tick while the stage is running.
+  std::unique_ptr<SimulationScheduler> scheduler;
+
+  /// Watches the descriptor directories, if Settings::debugHotReload is set.
+  std::unique_ptr<FileWatcher> descriptor_watcher;
+
+  /// Set by the event thread to ask the processing thread to switch between
+  /// Paused and Running.
+  std::atomic<bool> pause_toggle_requested_;
+
   /// A vector of column data for the stage.
   boost::container::vector<ColumnData> column_data_;
 
@@ -174,6 +300,9 @@ struct Stage::Impl
 
   /// State of the processing state machine.
   ProcessingState processing_state_;
+
+  /// State the processing state machine was in on the last process() call.
+  ProcessingState last_processing_state_;
 }
 ;
 
@@ -182,6 +311,9 @@ StageShPtr Stage::Impl::instance_;
 Stage::Stage()
   : impl(new Impl())
 {
+  impl->pause_toggle_requested_ = false;
+  impl->processing_state_ = ProcessingState::Idle;
+  impl->last_processing_state_ = ProcessingState::Idle;
 }
 
 Stage::~Stage()
@@ -241,6 +373,7 @@ void Stage::build(StageCoord3 stage_size, int seed)
 
   std::cout << "Creating stage data structures..." << std::endl;
   impl->chunks.reset(new StageChunkCollection(impl->size_));
+  impl->prop_index.reset(new PropSpatialIndex(impl->size_));
 
   impl->column_data_.resize(impl->size_.x * impl->size_.y);
 
@@ -317,6 +450,15 @@ EventResult Stage::handle_key_down(sf::Event::KeyEvent key)
     this->move_cursor(0, 0, 1);
     return EventResult::Handled;
 
+  case sf::Keyboard::Space:
+    // Pause/unpause once the stage is built; the processing thread does the
+    // actual switch.
+    if (impl->okay_to_render_map_)
+    {
+      impl->pause_toggle_requested_ = true;
+    }
+    return EventResult::Handled;
+
   default:
     /* do nothing */
     return EventResult::Ignored;
@@ -384,6 +526,44 @@ bool Stage::at_edge_top(StageCoord3 const& coord) const
   return (coord.z == impl->size_.z - 1);
 }
 
+void Stage::add_chunk_listener(StageChunkListener* listener)
+{
+  impl->chunks->add_listener(listener);
+}
+
+void Stage::remove_chunk_listener(StageChunkListener* listener)
+{
+  if (impl->chunks)
+  {
+    impl->chunks->remove_listener(listener);
+  }
+}
+
+int Stage::get_chunk_count() const
+{
+  return impl->chunks->get_chunk_count();
+}
+
+PropSpatialIndex& Stage::get_prop_index()
+{
+  return *(impl->prop_index);
+}
+
+SubstanceChunkIndex* Stage::get_substance_index()
+{
+  if (!impl->chunks)
+  {
+    return nullptr;
+  }
+
+  return impl->chunks->get_substance_index();
+}
+
+StageChunk& Stage::get_chunk(int chunk_index)
+{
+  return impl->chunks->getChunk(chunk_index);
+}
+
 StageChunk& Stage::get_chunk_containing(StageCoord x, StageCoord y, StageCoord z)
 {
 #ifndef NDEBUG
@@ -416,15 +596,14 @@ StageBlock& Stage::get_block(StageCoord x, StageCoord y, StageCoord z)
 
 void Stage::process(void)
 {
-  static ProcessingState last_processing_state = ProcessingState::Idle;
   static std::unique_ptr<StageBuilder> builder;
   bool done = false;
 
   // Have we changed states?
-  if (impl->processing_state_ != last_processing_state)
+  if (impl->processing_state_ != impl->last_processing_state_)
   {
     // Clean up the last state if needed.
-    switch (last_processing_state)
+    switch (impl->last_processing_state_)
     {
     case ProcessingState::SmoothTerrain:
       impl->UpdateAllColumnData();
@@ -435,7 +614,7 @@ void Stage::process(void)
     }
 
     // Update the last processing state.
-    last_processing_state = impl->processing_state_;
+    impl->last_processing_state_ = impl->processing_state_;
 
     // Initialize the new state if needed.
     switch (impl->processing_state_)
@@ -568,17 +747,75 @@ void Stage::process(void)
       // At this point it's okay to do map rendering.
       impl->okay_to_render_map_ = true;
 
+      impl->fluids.reset(new FluidSimulator(*this));
+      impl->fluids->load();
+
+      impl->scheduler.reset(
+        new SimulationScheduler(Settings::simulationMaxCatchUp));
+      impl->scheduler->add_system("columns",
+                                  Settings::simulationColumnRate,
+                                  Settings::simulationColumnBudget,
+                                  [this]()
+      {
+        impl->UpdateAllColumnData();
+      });
+      impl->scheduler->add_system("fluids",
+                                  Settings::simulationFluidRate,
+                                  Settings::simulationFluidBudget,
+                                  [this]()
+      {
+        impl->fluids->tick();
+      });
+
+      if (Settings::debugHotReload)
+      {
+        impl->descriptor_watcher.reset(
+          new FileWatcher({ "data/substances", "data/props" }, ".xml",
+                          Settings::debugHotReloadPollMs,
+                          []()
+        {
+          App::instance().wake();
+        }));
+        std::cout << "Watching descriptor files for changes." << std::endl;
+      }
+
       impl->processing_state_ = ProcessingState::Paused;
     }
     break;
 
   case ProcessingState::Paused:
     // This is the state when world processing is paused.
+    if (impl->descriptor_watcher)
+    {
+      impl->reload_changed_descriptors();
+    }
+
+    if (impl->pause_toggle_requested_.exchange(false))
+    {
+      std::cout << "Moving to RUNNING state." << std::endl;
+      impl->scheduler->reset();
+      impl->processing_state_ = ProcessingState::Running;
+    }
     break;
 
   case ProcessingState::Running:
     // This is the state when world processing is running.
-    impl->UpdateAllColumnData();
+    if (impl->descriptor_watcher)
+    {
+      impl->reload_changed_descriptors();
+    }
+
+    impl->scheduler->update();
+
+    if (impl->pause_toggle_requested_.exchange(false))
+    {
+      std::cout << "Moving to PAUSED state." << std::endl;
+      if (Settings::debugProfile)
+      {
+        impl->scheduler->report();
+      }
+      impl->processing_state_ = ProcessingState::Paused;
+    }
     break;
 
   case ProcessingState::Halted:
@@ -590,6 +827,34 @@ void Stage::process(void)
   }
 }
 
+double Stage::get_sleep_ms()
+{
+  // A state change still has to be set up or cleaned up, or a pause toggle
+  // is waiting to be handled.
+  if ((impl->processing_state_ != impl->last_processing_state_) ||
+      impl->pause_toggle_requested_)
+  {
+    return 0;
+  }
+
+  switch (impl->processing_state_)
+  {
+  case ProcessingState::Idle:
+  case ProcessingState::Paused:
+  case ProcessingState::Halted:
+    // Nothing happens in these states until something outside the stage
+    // changes it.
+    return -1;
+
+  case ProcessingState::Running:
+    return impl->scheduler->get_ms_until_next_tick();
+
+  default:
+    // Still building the stage.
+    return 0;
+  }
+}
+
 bool Stage::valid_coordinates(StageCoord x, StageCoord y, StageCoord z) const
 {
   return impl->valid_coordinates(x, y, z);
@@ -13,11 +13,17 @@ StageBlock::StageBlock(StageCoord x, StageCoord y, StageCoord z)
   coord_.x = x;
   coord_.y = y;
   coord_.z = z;
+  inventory_.set_position(coord_);
+  chunk_ = nullptr;
   hidden_faces_dirty_ = false;
   known_ = false;
-  substance_[(unsigned int) BlockLayer::Solid] = "nothing";
-  substance_[(unsigned int) BlockLayer::Fluid] = "air";
-  substance_[(unsigned int) BlockLayer::Cover] = "nothing";
+  substance_[(unsigned int) BlockLayer::Solid] = SL->get_id("nothing");
+  substance_[(unsigned int) BlockLayer::Fluid] = SL->get_id("air");
+  substance_[(unsigned int) BlockLayer::Cover] = SL->get_id("nothing");
+
+  // Faces start out all visible and clean.
+  summary_ = SummaryVisibleFaces;
+  refresh_substance_summary();
 }
 
 StageBlock::~StageBlock()
@@ -31,13 +37,9 @@ void StageBlock::accept(StageComponentVisitor& visitor)
   if (visitChildren)
   {
     // Visit this block's contents.
-    for (HasLocation* object : inventory_.getContents())
+    for (SerialNumber number : inventory_)
     {
-      StageComponent* component = dynamic_cast<StageComponent*>(object);
-      if (component != nullptr)
-      {
-        component->accept(visitor);
-      }
+      Prop::get(number).accept(visitor);
     }
   }
 }
@@ -48,52 +50,62 @@ Inventory& StageBlock::get_inventory()
 }
 
 std::string StageBlock::get_substance(BlockLayer _layer) const
+{
+  return SL->get_name(substance_[(unsigned int) _layer]);
+}
+
+SubstanceID StageBlock::get_substance_id(BlockLayer _layer) const
 {
   return substance_[(unsigned int) _layer];
 }
 
 void StageBlock::set_substance(BlockLayer layer, std::string substance)
+{
+  set_substance(layer, SL->get_id(substance));
+}
+
+void StageBlock::set_substance(BlockLayer layer, SubstanceID substance)
 {
   bool change = (substance_[(unsigned int) layer] != substance);
   if (change)
   {
-    StageChunk& chunk = Stage::get_instance()->get_chunk_containing(coord_.x,
-                                                                    coord_.y,
-                                                                    coord_.z);
+    chunk_->update_block_substance(substance_[(unsigned int) layer], substance);
     substance_[(unsigned int) layer] = substance;
+    refresh_substance_summary();
     invalidate_neighboring_faces();
     Stage::get_instance()->set_column_dirty(coord_.x, coord_.y);
-    chunk.set_render_data_dirty(true);
+    chunk_->set_render_data_dirty(true);
   }
 }
 
 void StageBlock::set_substance_quickly(BlockLayer layer, std::string substance)
 {
-  StageChunk& chunk = Stage::get_instance()->get_chunk_containing(coord_.x,
-                                                                  coord_.y,
-                                                                  coord_.z);
+  set_substance_quickly(layer, SL->get_id(substance));
+}
+
+void StageBlock::set_substance_quickly(BlockLayer layer, SubstanceID substance)
+{
+  chunk_->update_block_substance(substance_[(unsigned int) layer], substance);
   substance_[(unsigned int) layer] = substance;
-  hidden_faces_dirty_ = true;
+  refresh_substance_summary();
+  set_face_data_dirty(true);
   Stage::get_instance()->set_column_dirty(coord_.x, coord_.y);
-  chunk.set_render_data_dirty(true);
+  chunk_->set_render_data_dirty(true);
 }
 
-bool StageBlock::is_opaque(void) const
+bool StageBlock::is_face_data_dirty() const
 {
-  Visibility solid_visibility =
-    SL->get(substance_[(unsigned int) BlockLayer::Solid])->get_visibility();
-  Visibility fluid_visibility =
-    SL->get(substance_[(unsigned int) BlockLayer::Fluid])->get_visibility();
+  return hidden_faces_dirty_;
+}
 
-  return (solid_visibility == Visibility::Opaque
-          || fluid_visibility == Visibility::Opaque);
+bool StageBlock::is_opaque(void) const
+{
+  return ((summary_ & SummaryOpaque) != 0);
 }
 
 bool StageBlock::is_solid(void) const
 {
-  Phase solid_phase =
-    SL->get(substance_[(unsigned int) BlockLayer::Solid])->get_data().phase;
-  return (solid_phase == Phase::Solid);
+  return ((summary_ & SummarySolid) != 0);
 }
 
 bool StageBlock::is_traversable(void) const
@@ -103,13 +115,7 @@ bool StageBlock::is_traversable(void) const
 
 bool StageBlock::is_visible(void) const
 {
-  Visibility solid_visibility =
-    SL->get(substance_[(unsigned int) BlockLayer::Solid])->get_visibility();
-  Visibility fluid_visibility =
-    SL->get(substance_[(unsigned int) BlockLayer::Fluid])->get_visibility();
-
-  return (solid_visibility != Visibility::Invisible
-          || fluid_visibility != Visibility::Invisible);
+  return ((summary_ & SummaryVisible) != 0);
 }
 
 bool StageBlock::is_known(void) const
@@ -122,20 +128,38 @@ void StageBlock::set_known(bool known)
   bool change = (known_ != known);
   if (change)
   {
-    StageChunk& chunk = Stage::get_instance()->get_chunk_containing(coord_.x,
-                                                                    coord_.y,
-                                                                    coord_.z);
     known_ = known;
+    set_summary(known ? (summary_ | SummaryKnown) : (summary_ & ~SummaryKnown));
     invalidate_neighboring_faces();
     Stage::get_instance()->set_column_dirty(coord_.x, coord_.y);
-    chunk.set_render_data_dirty(true);
+    chunk_->set_render_data_dirty(true);
   }
 }
 
 void StageBlock::set_known_quickly(bool known)
 {
   known_ = known;
-  hidden_faces_dirty_ = true;
+  set_summary(known ? (summary_ | SummaryKnown) : (summary_ & ~SummaryKnown));
+  set_face_data_dirty(true);
+}
+
+uint8_t StageBlock::get_summary() const
+{
+  return summary_;
+}
+
+void StageBlock::set_chunk(StageChunk* chunk)
+{
+  chunk_ = chunk;
+  chunk_->update_block_summary(0, summary_);
+  for (unsigned int layer = 0; layer < (unsigned int) BlockLayer::Count; ++layer)
+  {
+    chunk_->update_block_substance(SUBSTANCEID_NULL, substance_[layer]);
+  }
+  if (hidden_faces_dirty_)
+  {
+    chunk_->update_dirty_face_count(1);
+  }
 }
 
 FaceBools StageBlock::get_hidden_faces(BlockLayer _layer)
@@ -147,9 +171,20 @@ FaceBools StageBlock::get_hidden_faces(BlockLayer _layer)
   return hidden_faces_[(unsigned int) _layer];
 }
 
+void StageBlock::set_hidden_faces(uint8_t solid_mask, uint8_t fluid_mask)
+{
+  hidden_faces_[(unsigned int) BlockLayer::Solid].set_mask(solid_mask);
+  hidden_faces_[(unsigned int) BlockLayer::Fluid].set_mask(fluid_mask);
+
+  bool any_visible = ((solid_mask & fluid_mask) != FaceBools::all_mask);
+  set_summary(any_visible ? (summary_ | SummaryVisibleFaces)
+                          : (summary_ & ~SummaryVisibleFaces));
+  set_face_data_dirty(false);
+}
+
 void StageBlock::invalidate_face_data()
 {
-  hidden_faces_dirty_ = true;
+  set_face_data_dirty(true);
 }
 
 bool StageBlock::has_any_visible_faces()
@@ -164,9 +199,8 @@ bool StageBlock::has_any_visible_faces()
 
 bool StageBlock::is_same_substance_as(StageBlock& other, BlockLayer layer)
 {
-  std::string my_substance = substance_[(unsigned int) layer];
-  std::string other_substance = other.get_substance(layer);
-  return (my_substance == other_substance);
+  return (substance_[(unsigned int) layer] ==
+          other.substance_[(unsigned int) layer]);
 }
 
 void StageBlock::calculate_hidden_faces()
@@ -267,7 +301,23 @@ void StageBlock::calculate_hidden_faces()
   // Write the new values back.  This also clears the dirty bit.
   hidden_faces_[(unsigned int) BlockLayer::Solid] = solid_hidden;
   hidden_faces_[(unsigned int) BlockLayer::Fluid] = fluid_hidden;
-  hidden_faces_dirty_ = false;
+
+  bool any_visible = (!solid_hidden.allTrue() || !fluid_hidden.allTrue());
+  set_summary(any_visible ? (summary_ | SummaryVisibleFaces)
+                          : (summary_ & ~SummaryVisibleFaces));
+  set_face_data_dirty(false);
+}
+
+void StageBlock::refresh_substances()
+{
+  uint8_t old_summary = summary_;
+  refresh_substance_summary();
+  if (summary_ != old_summary)
+  {
+    invalidate_neighboring_faces();
+    Stage::get_instance()->set_column_dirty(coord_.x, coord_.y);
+  }
+  chunk_->set_render_data_dirty(true);
 }
 
 StageCoord3 StageBlock::get_coords() const
@@ -280,7 +330,7 @@ void StageBlock::invalidate_neighboring_faces()
 {
   StageShPtr stage = Stage::get_instance();
 
-  hidden_faces_dirty_ = true;
+  set_face_data_dirty(true);
 
   if (!stage->at_edge_left(coord_))
   {
@@ -307,3 +357,55 @@ void StageBlock::invalidate_neighboring_faces()
     stage->get_block(coord_.x, coord_.y, coord_.z + 1).invalidate_face_data();
   }
 }
+
+void StageBlock::refresh_substance_summary()
+{
+  SubstanceLibraryShPtr library = SL;
+  SubstanceConstShPtr solid =
+    library->get(substance_[(unsigned int) BlockLayer::Solid]);
+  SubstanceConstShPtr fluid =
+    library->get(substance_[(unsigned int) BlockLayer::Fluid]);
+
+  uint8_t summary = summary_ & (SummaryKnown | SummaryVisibleFaces);
+
+  if (solid->get_visibility() == Visibility::Opaque ||
+      fluid->get_visibility() == Visibility::Opaque)
+  {
+    summary |= SummaryOpaque;
+  }
+  if (solid->get_visibility() != Visibility::Invisible ||
+      fluid->get_visibility() != Visibility::Invisible)
+  {
+    summary |= SummaryVisible;
+  }
+  if (solid->get_data().phase == Phase::Solid)
+  {
+    summary |= SummarySolid;
+  }
+
+  set_summary(summary);
+}
+
+void StageBlock::set_summary(uint8_t summary)
+{
+  if (summary != summary_)
+  {
+    if (chunk_ != nullptr)
+    {
+      chunk_->update_block_summary(summary_, summary);
+    }
+    summary_ = summary;
+  }
+}
+
+void StageBlock::set_face_data_dirty(bool dirty)
+{
+  if (dirty != hidden_faces_dirty_)
+  {
+    hidden_faces_dirty_ = dirty;
+    if (chunk_ != nullptr)
+    {
+      chunk_->update_dirty_face_count(dirty ? 1 : -1);
+    }
+  }
+}
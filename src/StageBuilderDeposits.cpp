@@ -2,6 +2,8 @@
 #include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <vector>
 // *** END ***
 /*
  * StageBuilderDeposits.cpp
@@ -12,9 +14,11 @@
 
 #include "../include/StageBuilderDeposits.h"
 
+#include "AliasTable.h"
 #include "Application.h"
 #include "ColumnData.h"
 #include "MathUtils.h"
+#include "ProfileTimer.h"
 #include "Settings.h"
 #include "Stage.h"
 #include "StageBlock.h"
@@ -40,10 +44,6 @@ struct StageBuilderDeposits::Impl
   {
     number_remaining_ = 0;  // This gets set later.
 
-    x_distribution_.reset(new RandDist(0, stage_.size().x - 1));
-    y_distribution_.reset(new RandDist(0, stage_.size().y - 1));
-    z_distribution_.reset(new RandDist(0, stage_.size().z - 1));
-
     // TODO: Define displacements in Settings instead of hardcoding.
     tiny_displacement_distribution_.reset(new RandDist(-1, 1));
     medium_displacement_distribution_.reset(new RandDist(-2, 2));
@@ -60,7 +60,7 @@ struct StageBuilderDeposits::Impl
                      StageCoord y,
                      StageCoord z,
                      BlockLayer layer,
-                     std::string substance)
+                     SubstanceID substance)
   {
     if (stage_.valid_coordinates(x, y, z))
     {
@@ -70,7 +70,7 @@ struct StageBuilderDeposits::Impl
 
   void draw_large_blob(StageCoord3 coord,
                        BlockLayer layer,
-                       std::string substance)
+                       SubstanceID substance)
   {
     /// Create a large-deposit blob.
     /// The blob created looks like the following:
@@ -129,7 +129,7 @@ struct StageBuilderDeposits::Impl
 
   void draw_small_blob(StageCoord3 coord,
                        BlockLayer layer,
-                       std::string substance)
+                       SubstanceID substance)
   {
     /// Create a small-deposit blob.
     /// The blob created looks like the following:
@@ -167,7 +167,7 @@ struct StageBuilderDeposits::Impl
   /// @todo Perhaps make this a series of lines, or a Bezier curve.
   void draw_vein(StageCoord3 const& src,
                  StageCoord3 const& dst,
-                 std::string substance)
+                 SubstanceID substance)
   {
     StageCoord3 d(dst.x - src.x, dst.y - src.y, dst.z - src.z);
     StageCoord3 a(abs(d.x) * 2, abs(d.y) * 2, abs(d.z) * 2);
@@ -262,6 +262,180 @@ struct StageBuilderDeposits::Impl
     }
   }
 
+  /// Get the names of the deposits of one type that a substance can host.
+  static std::vector<std::string> const& get_deposits(Substance const& host,
+                                                      DepositType type)
+  {
+    static std::vector<std::string> const none;
+
+    switch (type)
+    {
+    case DepositType::LargeDeposit:
+      return host.large_deposits;
+    case DepositType::SmallDeposit:
+      return host.small_deposits;
+    case DepositType::Vein:
+      return host.vein_deposits;
+    case DepositType::Single:
+      return host.single_deposits;
+    case DepositType::Gangue:
+      return host.gangue_deposits;
+    default:
+      return none;
+    }
+  }
+
+  /// Build the tables used to place one type of deposit: which deposits each
+  /// substance can host, and where the blocks that can host any of them are.
+  /// Called at the start of each placement phase, so deposits placed by
+  /// earlier phases can host later ones.
+  /// @return True if there is anywhere to put this type of deposit.
+  bool index_hosts(DepositType type)
+  {
+    ProfileTimer timer("Indexing deposit hosts");
+
+    unsigned int substance_count = SL->get_substance_count();
+
+    // For each host, the deposits it can contain.  A deposit's weight is
+    // the number of times it names the host.
+    host_deposits_.clear();
+    host_deposits_.resize(substance_count);
+
+    for (SubstanceID host = 0; host < substance_count; ++host)
+    {
+      std::map<SubstanceID, double> weights;
+      for (std::string const& name : get_deposits(*(SL->get(host)), type))
+      {
+        weights[SL->get_id(name)] += 1;
+      }
+
+      HostDeposits& entry = host_deposits_[host];
+      std::vector<double> weight_list;
+      for (auto const& weight : weights)
+      {
+        entry.deposits.push_back(weight.first);
+        weight_list.push_back(weight.second);
+      }
+      entry.table.build(weight_list);
+    }
+
+    // Find every run of blocks along X, within a Z-level, made of a single
+    // substance that can host something.
+    StageCoord3 stage_size = stage_.size();
+    std::vector<double> run_lengths;
+    host_runs_.clear();
+
+    for (StageCoord z = 0; z < stage_size.z; ++z)
+    {
+      for (StageCoord y = 0; y < stage_size.y; ++y)
+      {
+        HostRun run = { 0, y, z, 0, SUBSTANCEID_NULL };
+
+        for (StageCoord x = 0; x <= stage_size.x; ++x)
+        {
+          SubstanceID host = SUBSTANCEID_NULL;
+          if (x < stage_size.x)
+          {
+            host = stage_.get_block(x, y, z).get_substance_id(BlockLayer::Solid);
+            if ((host >= substance_count) || host_deposits_[host].table.empty())
+            {
+              host = SUBSTANCEID_NULL;
+            }
+          }
+
+          if (host == run.host)
+          {
+            ++run.length;
+            continue;
+          }
+
+          if (run.host != SUBSTANCEID_NULL)
+          {
+            host_runs_.push_back(run);
+            run_lengths.push_back(run.length);
+          }
+
+          run.x = x;
+          run.length = 1;
+          run.host = host;
+        }
+      }
+    }
+
+    host_run_table_.build(run_lengths);
+
+    if (Settings::debugShowVerboseInfo)
+    {
+      std::cout << "   " << host_runs_.size() << " runs of host blocks"
+                << std::endl;
+    }
+
+    return !host_run_table_.empty();
+  }
+
+  /// Pick a block that can host the current type of deposit, with every such
+  /// block equally likely, and pick a deposit for it.  index_hosts() must
+  /// have found somewhere to put the deposit.
+  void pick_host(StageCoord3& coord, SubstanceID& deposit)
+  {
+    boost::random::mt19937& twister = App::instance().twister();
+
+    HostRun const& run = host_runs_[host_run_table_.pick(twister)];
+    RandDist offset_distribution(0, run.length - 1);
+
+    coord = StageCoord3(run.x + offset_distribution(twister), run.y, run.z);
+
+    HostDeposits const& entry = host_deposits_[run.host];
+    deposit = entry.deposits[entry.table.pick(twister)];
+  }
+
+  /// Start a placement phase.
+  /// @param state    State for the phase.
+  /// @param type     Type of deposit the phase places.
+  /// @param density  Deposits to place per 2^18 blocks.
+  void begin_phase(PlacerState state, DepositType type, int density)
+  {
+    StageCoord3 stage_size = stage_.size();
+    int total_block_count = (int)stage_size.x *
+                            (int)stage_size.y *
+                            (int)stage_size.z;
+
+    placer_state_ = state;
+    number_remaining_ = (total_block_count * density) >> 18;
+
+    if (!index_hosts(type))
+    {
+      std::cout << "   (Nothing on the stage can host these.)" << std::endl;
+      number_remaining_ = 0;
+    }
+  }
+
+  /// A run of blocks along X that are all made of the same host substance.
+  struct HostRun
+  {
+    StageCoord x;
+    StageCoord y;
+    StageCoord z;
+    StageCoord length;
+    SubstanceID host;
+  };
+
+  /// Deposits a host substance can contain, and a table for choosing one.
+  struct HostDeposits
+  {
+    std::vector<SubstanceID> deposits;
+    AliasTable table;
+  };
+
+  /// Deposits for the current phase, indexed by host SubstanceID.
+  std::vector<HostDeposits> host_deposits_;
+
+  /// Runs of blocks that can host the current phase's deposits.
+  std::vector<HostRun> host_runs_;
+
+  /// Table for choosing a run, weighted by length.
+  AliasTable host_run_table_;
+
   /// Reference to the stage.
   Stage& stage_;
 
@@ -281,15 +455,6 @@ struct StageBuilderDeposits::Impl
   /// Number of the current feature left to place.
   int number_remaining_;
 
-  /// Random distribution across X axis.
-  std::unique_ptr<RandDist> x_distribution_;
-
-  /// Random distribution across Y axis.
-  std::unique_ptr<RandDist> y_distribution_;
-
-  /// Random distribution across Z axis.
-  std::unique_ptr<RandDist> z_distribution_;
-
   /// Tiny displacement distribution.
   std::unique_ptr<RandDist> tiny_displacement_distribution_;
 
@@ -324,9 +489,6 @@ bool StageBuilderDeposits::Build()
                                               stage_size.y - 1,
                                               stage_size.z - 1);
   static StageCoord3 zero_vector = StageCoord3(0);
-  static int total_block_count = (int)stage_size.x *
-                                 (int)stage_size.y *
-                                 (int)stage_size.z;
 
   if (impl->begin_)
   {
@@ -338,235 +500,141 @@ bool StageBuilderDeposits::Build()
   {
   case PlacerState::Start:
     std::cout << "-- Placing large deposits..." << std::endl;
-    impl->placer_state_ = PlacerState::LargeDeposits;
-    impl->number_remaining_ = (total_block_count
-                               * Settings::terrainLargeDepositDensity)
-                              >> 18;
+    impl->begin_phase(PlacerState::LargeDeposits, DepositType::LargeDeposit,
+                      Settings::terrainLargeDepositDensity);
     break;
 
   case PlacerState::LargeDeposits:
     if (impl->number_remaining_ != 0)
     {
-      StageCoord3 random = StageCoord3(
-                             impl->get_random(impl->x_distribution_),
-                             impl->get_random(impl->y_distribution_),
-                             impl->get_random(impl->z_distribution_));
-      StageBlock& chosen_block = impl->stage_.get_block(random.x,
-                                                        random.y,
-                                                        random.z);
-      SubstanceConstShPtr substance =
-        SL->get(chosen_block.get_substance(BlockLayer::Solid));
-
-      // Make sure the randomly selected block's substance can contain large deposits.
-      if (substance->large_deposits.size() != 0)
+      StageCoord3 random;
+      SubstanceID deposit_substance;
+      impl->pick_host(random, deposit_substance);
+
+      // Create the deposit out of 8 slightly-displaced large blobs.
+      // TODO: make the size of a deposit customizable?
+      for (int blob_pieces = 0; blob_pieces < 8; ++blob_pieces)
       {
-        // Create a distribution to choose one of the substances included.
-        RandDist substance_distribution(0, substance->large_deposits.size() - 1);
-        std::string deposit_substance =
-          substance->large_deposits[substance_distribution(
-                                    App::instance().twister())];
-
-        // Create the deposit out of 8 slightly-displaced large blobs.
-        // TODO: make the size of a deposit customizable?
-        for (int blob_pieces = 0; blob_pieces < 8; ++blob_pieces)
+        StageCoord3 coord = random;
+        StageCoord3 try_coord = coord;
+        do
         {
-          StageCoord3 coord = random;
-          StageCoord3 try_coord = coord;
-          do
-          {
-            StageCoord3 offset = StageCoord3(
-                                   impl->get_random(impl->medium_displacement_distribution_),
-                                   impl->get_random(impl->medium_displacement_distribution_),
-                                   impl->get_random(impl->tiny_displacement_distribution_));
-            try_coord.x = coord.x + offset.x;
-            try_coord.y = coord.y + offset.y;
-            try_coord.z = coord.z + offset.z;
-            try_coord = constrain_to_box(zero_vector, try_coord, max_vector);
-          }
-          while (!impl->stage_.get_block(try_coord.x,
-                                        try_coord.y,
-                                        try_coord.z).is_solid());
-
-          impl->draw_large_blob(coord, BlockLayer::Solid, deposit_substance);
+          StageCoord3 offset = StageCoord3(
+                                 impl->get_random(impl->medium_displacement_distribution_),
+                                 impl->get_random(impl->medium_displacement_distribution_),
+                                 impl->get_random(impl->tiny_displacement_distribution_));
+          try_coord.x = coord.x + offset.x;
+          try_coord.y = coord.y + offset.y;
+          try_coord.z = coord.z + offset.z;
+          try_coord = constrain_to_box(zero_vector, try_coord, max_vector);
         }
+        while (!impl->stage_.get_block(try_coord.x,
+                                      try_coord.y,
+                                      try_coord.z).is_solid());
 
-        --(impl->number_remaining_);
-      }
-      else
-      {
-        // TODO: substance has no large deposit types, increment "give up" counter
+        impl->draw_large_blob(coord, BlockLayer::Solid, deposit_substance);
       }
 
+      --(impl->number_remaining_);
     }
     else
     {
       std::cout << "-- Placing small deposits..." << std::endl;
-      impl->placer_state_ = PlacerState::SmallDeposits;
-      impl->number_remaining_ = (total_block_count
-                                 * Settings::terrainSmallDepositDensity)
-                                >> 18;
+      impl->begin_phase(PlacerState::SmallDeposits, DepositType::SmallDeposit,
+                        Settings::terrainSmallDepositDensity);
     }
     break;
 
   case PlacerState::SmallDeposits:
     if (impl->number_remaining_ != 0)
     {
-      StageCoord3 random = StageCoord3(
-                             impl->get_random(impl->x_distribution_),
-                             impl->get_random(impl->y_distribution_),
-                             impl->get_random(impl->z_distribution_));
-      StageBlock& chosen_block = impl->stage_.get_block(random.x, random.y, random.z);
-      SubstanceConstShPtr substance =
-        SL->get(chosen_block.get_substance(BlockLayer::Solid));
-
-      // Make sure the randomly selected block's substance can contain small deposits.
-      if (substance->small_deposits.size() != 0)
+      StageCoord3 random;
+      SubstanceID deposit_substance;
+      impl->pick_host(random, deposit_substance);
+
+      // Create the deposit out of 4 slightly-displaced small blobs.
+      // TODO: make the size of a deposit customizable?
+      for (int blob_pieces = 0; blob_pieces < 8; ++blob_pieces)
       {
-        // Create a distribution to choose one of the substances included.
-        boost::random::uniform_int_distribution<> substance_distribution(
-          0, substance->small_deposits.size() - 1);
-        std::string deposit_substance =
-          substance->small_deposits[substance_distribution(
-                                    App::instance().twister())];
-
-        // Create the deposit out of 4 slightly-displaced small blobs.
-        // TODO: make the size of a deposit customizable?
-        for (int blob_pieces = 0; blob_pieces < 8; ++blob_pieces)
+        StageCoord3 coord = random;
+        StageCoord3 try_coord = coord;
+        do
         {
-          StageCoord3 coord = random;
-          StageCoord3 try_coord = coord;
-          do
-          {
-            StageCoord3 offset = StageCoord3(
-                                   impl->get_random(impl->tiny_displacement_distribution_),
-                                   impl->get_random(impl->tiny_displacement_distribution_),
-                                   impl->get_random(impl->tiny_displacement_distribution_));
-            StageCoord3 try_coord;
-            try_coord.x = coord.x + offset.x;
-            try_coord.y = coord.y + offset.y;
-            try_coord.z = coord.z + offset.z;
-            try_coord = constrain_to_box(zero_vector, try_coord, max_vector);
-          }
-          while (!impl->stage_.get_block(try_coord.x,
-                                        try_coord.y,
-                                        try_coord.z).is_solid());
-
-          impl->draw_small_blob(coord, BlockLayer::Solid, deposit_substance);
+          StageCoord3 offset = StageCoord3(
+                                 impl->get_random(impl->tiny_displacement_distribution_),
+                                 impl->get_random(impl->tiny_displacement_distribution_),
+                                 impl->get_random(impl->tiny_displacement_distribution_));
+          StageCoord3 try_coord;
+          try_coord.x = coord.x + offset.x;
+          try_coord.y = coord.y + offset.y;
+          try_coord.z = coord.z + offset.z;
+          try_coord = constrain_to_box(zero_vector, try_coord, max_vector);
         }
+        while (!impl->stage_.get_block(try_coord.x,
+                                      try_coord.y,
+                                      try_coord.z).is_solid());
 
-        --(impl->number_remaining_);
-      }
-      else
-      {
-        // TODO: substance has no small deposit types, increment "give up" counter
+        impl->draw_small_blob(coord, BlockLayer::Solid, deposit_substance);
       }
+
+      --(impl->number_remaining_);
     }
     else
     {
       std::cout << "-- Placing veins..." << std::endl;
-      impl->placer_state_ = PlacerState::Veins;
-      impl->number_remaining_ = (total_block_count
-                                 * Settings::terrainVeinDensity)
-                                >> 18;
-
+      impl->begin_phase(PlacerState::Veins, DepositType::Vein,
+                        Settings::terrainVeinDensity);
     }
     break;
 
   case PlacerState::Veins:
     if (impl->number_remaining_ != 0)
     {
-      StageCoord3 random = StageCoord3(
-                             impl->get_random(impl->x_distribution_),
-                             impl->get_random(impl->y_distribution_),
-                             impl->get_random(impl->z_distribution_));
-      StageBlock& chosen_block = impl->stage_.get_block(random.x,
-                                                       random.y,
-                                                       random.z);
-      SubstanceConstShPtr substance =
-        SL->get(chosen_block.get_substance(BlockLayer::Solid));
-
-      // Make sure the randomly selected block's substance can contain veins.
-      if (substance->vein_deposits.size() != 0)
+      StageCoord3 random;
+      SubstanceID deposit_substance;
+      impl->pick_host(random, deposit_substance);
+
+      // Figure out the end of the vein.  We don't do any checking for
+      // the endpoint right now except to make sure it is solid.
+      StageCoord3 dest = random;
+      StageCoord3 try_dest = dest;
+      do
       {
+        StageCoord3 offset = StageCoord3(
+                               impl->get_random(impl->huge_displacement_distribution_),
+                               impl->get_random(impl->huge_displacement_distribution_),
+                               impl->get_random(impl->huge_displacement_distribution_));
+
+        try_dest.x = dest.x + offset.x;
+        try_dest.y = dest.y + offset.y;
+        try_dest.z = dest.z + offset.z;
+        try_dest = constrain_to_box(zero_vector, try_dest, max_vector);
+      }
+      while (!impl->stage_.get_block(try_dest.x, try_dest.y, try_dest.z).is_solid());
 
-        // Create a distribution to choose one of the substances included.
-        boost::random::uniform_int_distribution<> substance_distribution(
-          0, substance->vein_deposits.size() - 1);
-        std::string deposit_substance =
-          substance->vein_deposits[substance_distribution(
-                                   App::instance().twister())];
-
-        // Figure out the end of the vein.  We don't do any checking for
-        // the endpoint right now except to make sure it is solid.
-        StageCoord3 dest = random;
-        StageCoord3 try_dest = dest;
-        do
-        {
-          StageCoord3 offset = StageCoord3(
-                                 impl->get_random(impl->huge_displacement_distribution_),
-                                 impl->get_random(impl->huge_displacement_distribution_),
-                                 impl->get_random(impl->huge_displacement_distribution_));
-
-          try_dest.x = dest.x + offset.x;
-          try_dest.y = dest.y + offset.y;
-          try_dest.z = dest.z + offset.z;
-          try_dest = constrain_to_box(zero_vector, try_dest, max_vector);
-        }
-        while (!impl->stage_.get_block(try_dest.x, try_dest.y, try_dest.z).is_solid());
-
-        impl->draw_vein(random, try_dest, deposit_substance);
+      impl->draw_vein(random, try_dest, deposit_substance);
 
-        --(impl->number_remaining_);
-      }
-      else
-      {
-        // TODO: substance has no vein deposit types, increment "give up" counter
-      }
+      --(impl->number_remaining_);
     }
     else
     {
       std::cout << "-- Placing solitaires..." << std::endl;
-      impl->placer_state_ = PlacerState::Solitaires;
-      impl->number_remaining_ = (total_block_count
-                                 * Settings::terrainSingleDensity)
-                                >> 18;
-
+      impl->begin_phase(PlacerState::Solitaires, DepositType::Single,
+                        Settings::terrainSingleDensity);
     }
     break;
 
   case PlacerState::Solitaires:
     if (impl->number_remaining_ != 0)
     {
-      StageCoord3 random = StageCoord3(
-                             impl->get_random(impl->x_distribution_),
-                             impl->get_random(impl->y_distribution_),
-                             impl->get_random(impl->z_distribution_));
-      StageBlock& chosen_block = impl->stage_.get_block(random.x,
-                                                       random.y,
-                                                       random.z);
-      SubstanceConstShPtr substance =
-        SL->get(chosen_block.get_substance(BlockLayer::Solid));
-
-      // Make sure the randomly selected block's substance can contain solitaires.
-      if (substance->single_deposits.size() != 0)
-      {
-
-        // Create a distribution to choose one of the substances included.
-        boost::random::uniform_int_distribution<> substance_distribution(
-          0, substance->single_deposits.size() - 1);
-        std::string deposit_substance =
-          substance->single_deposits[substance_distribution(
-                                    App::instance().twister())];
+      StageCoord3 random;
+      SubstanceID deposit_substance;
+      impl->pick_host(random, deposit_substance);
 
-        impl->set_substance(random.x, random.y, random.z,
-                            BlockLayer::Solid, deposit_substance);
+      impl->set_substance(random.x, random.y, random.z,
+                          BlockLayer::Solid, deposit_substance);
 
-        --(impl->number_remaining_);
-      }
-      else
-      {
-        // TODO: substance has no solitaire deposit types, increment "give up" counter
-      }
+      --(impl->number_remaining_);
     }
     else
     {
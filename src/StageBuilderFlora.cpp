@@ -13,8 +13,10 @@
 #include "Application.h"
 #include "ColumnData.h"
 #include "ErrorMacros.h"
+#include "Inventory.h"
 #include "MathUtils.h"
 #include "NoiseField.h"
+#include "Prop.h"
 #include "Settings.h"
 #include "Stage.h"
 #include "StageBlock.h"
@@ -54,6 +56,13 @@ struct StageBuilderFlora::Impl
 
   /// Threshold for noise field generating forests.
   StageCoord forest_threshold_;
+
+  /// Blocks to put grass on in the current row.  Kept here so the storage
+  /// is reused from row to row.
+  std::vector<Inventory*> grass_locations_;
+
+  /// Blocks to put trees on in the current row.
+  std::vector<Inventory*> tree_locations_;
 };
 
 StageBuilderFlora::StageBuilderFlora(Stage& stage,
@@ -71,7 +80,6 @@ StageBuilderFlora::~StageBuilderFlora()
 bool StageBuilderFlora::Build()
 {
   static StageCoord3 stage_size = impl->stage_.size();
-  SerialNumber prop_number;
 
   // TODO: magic numbers, u haz them
   static NoiseField forest_noisefield(stage_size.x, 0, 100, 8192, impl->seed_);
@@ -88,6 +96,11 @@ bool StageBuilderFlora::Build()
 
   if (impl->column_.y < stage_size.y)
   {
+    // Locations for this row's props, placed in bulk at the end of the row.
+    std::vector<Inventory*>& grass_locations = impl->grass_locations_;
+    std::vector<Inventory*>& tree_locations = impl->tree_locations_;
+    grass_locations.clear();
+    tree_locations.clear();
 
     for (impl->column_.x = 0; impl->column_.x < stage_size.x;
          ++(impl->column_.x))
@@ -118,11 +131,11 @@ bool StageBuilderFlora::Build()
                                                       height);
 
       bool block_is_soil =
-        SL->get(block.get_substance(BlockLayer::Solid))->
-          get_bool_property("attributes.soil", false);
+        SL->get(block.get_substance_id(BlockLayer::Solid))->
+          get(SubstanceBoolProperty::IsSoil);
       bool above_is_water =
-        SL->get(block_above.get_substance(BlockLayer::Fluid))->
-          get_bool_property("attributes.water", false);
+        SL->get(block_above.get_substance_id(BlockLayer::Fluid))->
+          get(SubstanceBoolProperty::IsWater);
 
       // Make sure this chunk is soil.
       if (block_is_soil)
@@ -132,8 +145,7 @@ bool StageBuilderFlora::Build()
         {
           // First put down grass.
           // TODO: Smatterings of different grass types.
-          prop_number = Prop::create("grass");
-          Prop::get(prop_number).move_to(block.get_inventory());
+          grass_locations.push_back(&(block.get_inventory()));
 
           // TODO: Bushes, weeds.
 
@@ -154,13 +166,15 @@ bool StageBuilderFlora::Build()
           // TODO: different kinds of trees
           if (value >= chance)
           {
-            prop_number = Prop::create("tree");
-            Prop::get(prop_number).move_to(block.get_inventory());
+            tree_locations.push_back(&(block.get_inventory()));
           }
         }
       }
     }
 
+    Prop::place("grass", grass_locations);
+    Prop::place("tree", tree_locations);
+
     ++(impl->column_.y);
 
   }
@@ -14,6 +14,7 @@
 #include "Application.h"
 #include "ColumnData.h"
 #include "ErrorMacros.h"
+#include "JobSystem.h"
 #include "MathUtils.h"
 #include "Stage.h"
 #include "Settings.h"
@@ -196,17 +197,24 @@ bool StageBuilderTerrain::Build()
     scale_bias.SetBias(impl->stage_height_);
     scale_bias.SetScale(impl->feature_height_);
 
-    StageCoord2 column;
-    for (column.x = 0; column.x < stage_size.x; ++column.x)
+    // Noise modules are read-only once set up, and each column is written
+    // by one job only, so the rows can be generated in parallel.
+    Stage& stage = impl->stage_;
+    App::instance().get_jobs().parallel_for(stage_size.x, 8,
+        [&](unsigned int first, unsigned int last)
     {
-      for (column.y = 0; column.y < stage_size.y; ++column.y)
+      StageCoord2 column;
+      for (column.x = first; column.x < (StageCoord) last; ++column.x)
       {
-        double perlin_x = (double) column.x / (double) stage_size.x;
-        double perlin_y = (double) column.y / (double) stage_size.y;
-        int value = scale_bias.GetValue(perlin_x, perlin_y, perlin_seed);
-        impl->stage_.set_column_initial_height(column.x, column.y, value);
+        for (column.y = 0; column.y < stage_size.y; ++column.y)
+        {
+          double perlin_x = (double) column.x / (double) stage_size.x;
+          double perlin_y = (double) column.y / (double) stage_size.y;
+          int value = scale_bias.GetValue(perlin_x, perlin_y, perlin_seed);
+          stage.set_column_initial_height(column.x, column.y, value);
+        }
       }
-    }
+    });
 
     impl->builder_state_ = BuilderState::GenerateStrata;
 
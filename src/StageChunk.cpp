@@ -3,13 +3,17 @@
 #include <algorithm>
 
 #include "ErrorMacros.h"
+#include "HiddenFaceKernel.h"
 #include "Settings.h"
 #include "Stage.h"
 #include "StageBlock.h"
 #include "StageChunkCollection.h"
+#include "StageChunkHalo.h"
 #include "StageComponentVisitor.h"
+#include "SubstanceChunkIndex.h"
 
 const StageCoord StageChunk::chunk_side_length;
+const int StageChunk::blocks_per_chunk;
 
 StageChunk::StageChunk(StageChunkCollection* parent,
                        int chunk_index,
@@ -21,9 +25,32 @@ StageChunk::StageChunk(StageChunkCollection* parent,
 
   parent_ = parent;
   index_ = chunk_index;
+  substance_index_ = parent_->get_substance_index();
   coord_ = StageCoord3(block_x, block_y, block_z);
 
-  render_data_dirty_ = true;
+  // Chunks on the far edges may hang over the edge of the stage.
+  StageCoord3 const& stage_size = parent_->get_size();
+  blocks_x_ = std::min<StageCoord>(chunk_side_length, stage_size.x - block_x);
+  blocks_y_ = std::min<StageCoord>(chunk_side_length, stage_size.y - block_y);
+
+  opaque_count_ = 0;
+  solid_count_ = 0;
+  visible_count_ = 0;
+  known_count_ = 0;
+  visible_face_count_ = 0;
+  dirty_face_count_ = 0;
+
+  // Claim our blocks; each one adds itself to our running totals.
+  for (StageCoord add_y = 0; add_y < blocks_y_; ++add_y)
+  {
+    for (StageCoord add_x = 0; add_x < blocks_x_; ++add_x)
+    {
+      StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
+                                                            coord_.y + add_y,
+                                                            coord_.z);
+      block_location->set_chunk(this);
+    }
+  }
 }
 
 StageChunk::~StageChunk()
@@ -41,9 +68,9 @@ void StageChunk::accept(StageComponentVisitor& visitor)
   {
     // Visit the blocks existing underneath this chunk.
 
-    for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
+    for (StageCoord add_y = 0; add_y < blocks_y_; ++add_y)
     {
-      for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
+      for (StageCoord add_x = 0; add_x < blocks_x_; ++add_x)
       {
         // Figure out where in the block pool this block is.
         StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
@@ -69,145 +96,216 @@ StageCoord3 const& StageChunk::get_coords() const
 
 bool StageChunk::is_opaque(void)
 {
-  boost::mutex::scoped_lock lock(blocks_mutex_);
+  return (opaque_count_ == blocks_per_chunk);
+}
 
-  // Visit the blocks existing underneath this chunk.
+bool StageChunk::is_solid(void)
+{
+  return (solid_count_ == blocks_per_chunk);
+}
 
-  for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
-  {
-    for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
-    {
-      // Figure out where in the block pool this block is.
-      StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
-                                                            coord_.y + add_y,
-                                                            coord_.z);
+bool StageChunk::is_traversable(void)
+{
+  return (solid_count_ < blocks_per_chunk);
+}
 
-      if (!(block_location->is_opaque()))
-      {
-        return false;
-      }
-    }
-  }
-  return true;
+bool StageChunk::is_visible(void)
+{
+  return (visible_count_ > 0);
 }
 
-bool StageChunk::is_solid(void)
+bool StageChunk::is_known(void)
 {
-  boost::mutex::scoped_lock lock(blocks_mutex_);
+  return (known_count_ > 0);
+}
 
-  for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
+bool StageChunk::has_any_visible_faces()
+{
+  if (dirty_face_count_ > 0)
   {
-    for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
-    {
-      // Figure out where in the block pool this block is.
-      StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
-                                                            coord_.y + add_y,
-                                                            coord_.z);
-
-      if (!(block_location->is_solid()))
-      {
-        return false;
-      }
-    }
+    calculate_hidden_faces();
   }
-  return true;
+
+  return (visible_face_count_ > 0);
 }
 
-bool StageChunk::is_traversable(void)
+void StageChunk::calculate_hidden_faces()
 {
   boost::mutex::scoped_lock lock(blocks_mutex_);
+  calculate_hidden_faces_locked();
+}
 
-  for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
+void StageChunk::capture_halo(StageChunkHalo& halo)
+{
+  boost::mutex::scoped_lock lock(blocks_mutex_);
+  capture_halo_locked(halo);
+}
+
+void StageChunk::capture_halo_locked(StageChunkHalo& halo)
+{
+  StageCoord3 const& stage_size = parent_->get_size();
+
+  halo.coords = coord_;
+
+  for (int slab = 0; slab < StageChunkHalo::SlabCount; ++slab)
   {
-    for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
+    int block_z = coord_.z + slab - 1;
+    for (int add_y = -1; add_y <= chunk_side_length; ++add_y)
     {
-      // Figure out where in the block pool this block is.
-      StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
-                                                            coord_.y + add_y,
-                                                            coord_.z);
-
-      if (block_location->is_traversable())
+      int block_y = coord_.y + add_y;
+      for (int add_x = -1; add_x <= chunk_side_length; ++add_x)
       {
-        return true;
+        int block_x = coord_.x + add_x;
+        int index = StageChunkHalo::index(add_x, add_y);
+
+        if ((block_x < 0) || (block_y < 0) || (block_z < 0) ||
+            (block_x >= stage_size.x) ||
+            (block_y >= stage_size.y) ||
+            (block_z >= stage_size.z))
+        {
+          halo.solid[slab][index] = SUBSTANCEID_NULL;
+          halo.fluid[slab][index] = SUBSTANCEID_NULL;
+          halo.opaque[slab][index] = 0;
+          halo.summary[slab][index] = 0;
+        }
+        else
+        {
+          StageBlock* block = parent_->getBlockPointer(block_x,
+                                                       block_y,
+                                                       block_z);
+          halo.solid[slab][index] = block->get_substance_id(BlockLayer::Solid);
+          halo.fluid[slab][index] = block->get_substance_id(BlockLayer::Fluid);
+          halo.opaque[slab][index] = block->is_opaque() ? 0xFFFF : 0;
+          halo.summary[slab][index] = block->get_summary();
+        }
       }
     }
   }
-  return false;
 }
 
-bool StageChunk::is_visible(void)
+void StageChunk::calculate_hidden_faces_locked()
 {
-  boost::mutex::scoped_lock lock(blocks_mutex_);
+  // The halo is around 24 kB, so keep it off the stack.
+  std::unique_ptr<StageChunkHalo> halo(new StageChunkHalo());
+  HiddenFaceKernel::Output output;
+
+  capture_halo_locked(*halo);
+  HiddenFaceKernel::calculate(*halo, output);
 
-  for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
+  // Write the results back to the blocks.
+  for (StageCoord add_y = 0; add_y < blocks_y_; ++add_y)
   {
-    for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
+    for (StageCoord add_x = 0; add_x < blocks_x_; ++add_x)
     {
-      // Figure out where in the block pool this block is.
       StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
                                                             coord_.y + add_y,
                                                             coord_.z);
-
-      if (block_location->is_visible())
-      {
-        return true;
-      }
+      int index = (add_y * chunk_side_length) + add_x;
+      block_location->set_hidden_faces(output.solid[index],
+                                       output.fluid[index]);
     }
   }
-
-  return false;
 }
 
-bool StageChunk::is_known(void)
+bool StageChunk::refresh_substances(boost::dynamic_bitset<> const& substances)
 {
-  boost::mutex::scoped_lock lock(blocks_mutex_);
+  bool refreshed = false;
 
-  for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
+  for (StageCoord add_y = 0; add_y < blocks_y_; ++add_y)
   {
-    for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
+    for (StageCoord add_x = 0; add_x < blocks_x_; ++add_x)
     {
-      // Figure out where in the block pool this block is.
-      StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
-                                                            coord_.y + add_y,
-                                                            coord_.z);
+      StageBlock* block = parent_->getBlockPointer(coord_.x + add_x,
+                                                   coord_.y + add_y,
+                                                   coord_.z);
 
-      if (block_location->is_known())
+      for (unsigned int layer = 0;
+           layer < (unsigned int) BlockLayer::Count;
+           ++layer)
       {
-        return true;
+        SubstanceID id = block->get_substance_id((BlockLayer) layer);
+        if ((id < substances.size()) && substances[id])
+        {
+          block->refresh_substances();
+          refreshed = true;
+          break;
+        }
       }
     }
   }
-  return false;
+
+  return refreshed;
 }
 
-bool StageChunk::has_any_visible_faces()
+void StageChunk::update_block_summary(uint8_t old_summary,
+                                      uint8_t new_summary)
 {
-  boost::mutex::scoped_lock lock(blocks_mutex_);
+  uint8_t changed = old_summary ^ new_summary;
 
-  for (StageCoord add_y = 0; add_y < chunk_side_length; ++add_y)
+  if (changed & StageBlock::SummaryOpaque)
   {
-    for (StageCoord add_x = 0; add_x < chunk_side_length; ++add_x)
-    {
-      // Figure out where in the block pool this block is.
-      StageBlock* block_location = parent_->getBlockPointer(coord_.x + add_x,
-                                                            coord_.y + add_y,
-                                                            coord_.z);
+    opaque_count_ += (new_summary & StageBlock::SummaryOpaque) ? 1 : -1;
+  }
+  if (changed & StageBlock::SummarySolid)
+  {
+    solid_count_ += (new_summary & StageBlock::SummarySolid) ? 1 : -1;
+  }
+  if (changed & StageBlock::SummaryVisible)
+  {
+    visible_count_ += (new_summary & StageBlock::SummaryVisible) ? 1 : -1;
+  }
+  if (changed & StageBlock::SummaryKnown)
+  {
+    known_count_ += (new_summary & StageBlock::SummaryKnown) ? 1 : -1;
+  }
+  if (changed & StageBlock::SummaryVisibleFaces)
+  {
+    visible_face_count_ +=
+      (new_summary & StageBlock::SummaryVisibleFaces) ? 1 : -1;
+  }
+}
 
-      if (block_location->has_any_visible_faces())
-      {
-        return true;
-      }
-    }
+void StageChunk::update_block_substance(SubstanceID old_id, SubstanceID new_id)
+{
+  if (substance_index_ != nullptr)
+  {
+    substance_index_->replace(index_, old_id, new_id);
   }
-  return false;
+}
+
+void StageChunk::update_dirty_face_count(int delta)
+{
+  dirty_face_count_ += delta;
 }
 
 bool StageChunk::is_render_data_dirty()
 {
-  return render_data_dirty_;
+  return render_state_.is_dirty();
 }
 
 void StageChunk::set_render_data_dirty(bool dirty)
 {
-  render_data_dirty_ = dirty;
+  if (!dirty)
+  {
+    render_state_.clear_dirty();
+  }
+  else if (render_state_.set_dirty())
+  {
+    parent_->notify_chunk_dirty(*this);
+  }
+}
+
+bool StageChunk::try_mark_queued()
+{
+  return render_state_.try_mark_queued();
+}
+
+void StageChunk::clear_queued()
+{
+  render_state_.clear_queued();
+}
+
+void StageChunk::take_from_queue()
+{
+  render_state_.take();
 }
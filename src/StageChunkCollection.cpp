@@ -1,9 +1,20 @@
 #include "StageChunkCollection.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#include "ErrorMacros.h"
 #include "MathUtils.h"
+#include "Settings.h"
 #include "Stage.h"
 #include "StageChunk.h"
+#include "StageChunkListener.h"
 #include "StageComponentVisitor.h"
+#include "SubstanceChunkIndex.h"
+#include "SubstanceLibrary.h"
 
 struct StageChunkCollection::Impl
 {
@@ -15,8 +26,32 @@ struct StageChunkCollection::Impl
 
   inline int calc_block_index(int block_x, int block_y, int block_z)
   {
-    return (block_z * (int)num_of_blocks.x * (int)num_of_blocks.y) +
-           (block_y * (int)num_of_blocks.x) + block_x;
+    if (layout == BlockLayout::Linear)
+    {
+      return (block_z * (int)num_of_blocks.x * (int)num_of_blocks.y) +
+             (block_y * (int)num_of_blocks.x) + block_x;
+    }
+
+    // Tiled and Morton layouts store every chunk contiguously, so first find
+    // the chunk, then the block's offset within that chunk.
+    int chunk_index = calc_chunk_index(block_x / StageChunk::chunk_side_length,
+                                       block_y / StageChunk::chunk_side_length,
+                                       block_z);
+    int add_x = block_x % StageChunk::chunk_side_length;
+    int add_y = block_y % StageChunk::chunk_side_length;
+
+    return (chunk_index * StageChunk::blocks_per_chunk) +
+           calc_block_offset_in_chunk(add_x, add_y);
+  }
+
+  /// Get the offset of a block within its chunk, for Tiled/Morton layouts.
+  inline int calc_block_offset_in_chunk(int add_x, int add_y)
+  {
+    if (layout == BlockLayout::Morton)
+    {
+      return morton_spread[add_x] | (morton_spread[add_y] << 1);
+    }
+    return (add_y * StageChunk::chunk_side_length) + add_x;
   }
 
   inline int calc_block_index_of_chunk(int chunk_x, int chunk_y, int chunk_z)
@@ -63,16 +98,51 @@ struct StageChunkCollection::Impl
 
   Impl(StageCoord3 total_block_size)
   {
+    publish_listeners(new ListenerList());
+
     num_of_blocks = total_block_size;
+    layout = Settings::stageBlockLayout;
 
-    std::cout << "Allocating a " << num_of_blocks.x << "x" <<
-                                    num_of_blocks.y << "x" <<
-                                    num_of_blocks.z <<
-                                    " memory pool for StageBlocks...";
+    num_of_chunks.x = (num_of_blocks.x / StageChunk::chunk_side_length) +
+        ((num_of_blocks.x % StageChunk::chunk_side_length == 0) ? 0 : 1);
+    num_of_chunks.y = (num_of_blocks.y / StageChunk::chunk_side_length) +
+        ((num_of_blocks.y % StageChunk::chunk_side_length == 0) ? 0 : 1);
+    num_of_chunks.z = num_of_blocks.z;
+
+    // Build the bit-spreading table used for Z-order indexing.
+    for (int n = 0; n < StageChunk::chunk_side_length; ++n)
+    {
+      morton_spread[n] = 0;
+      for (int bit = 0; (1 << bit) < StageChunk::chunk_side_length; ++bit)
+      {
+        if (n & (1 << bit))
+        {
+          morton_spread[n] |= (1 << (bit * 2));
+        }
+      }
+    }
 
-    unsigned int block_pool_size = num_of_blocks.x *
-                                   num_of_blocks.y *
-                                   num_of_blocks.z *
+    // The tiled layouts need storage for whole chunks, even at the edges.
+    if (layout == BlockLayout::Linear)
+    {
+      num_of_stored_blocks = num_of_blocks;
+    }
+    else
+    {
+      num_of_stored_blocks.x = num_of_chunks.x * StageChunk::chunk_side_length;
+      num_of_stored_blocks.y = num_of_chunks.y * StageChunk::chunk_side_length;
+      num_of_stored_blocks.z = num_of_blocks.z;
+    }
+
+    std::cout << "Allocating a " << num_of_stored_blocks.x << "x" <<
+                                    num_of_stored_blocks.y << "x" <<
+                                    num_of_stored_blocks.z <<
+                                    " memory pool for StageBlocks (" <<
+                                    get_layout_name() << " layout)...";
+
+    unsigned int block_pool_size = num_of_stored_blocks.x *
+                                   num_of_stored_blocks.y *
+                                   num_of_stored_blocks.z *
                                    sizeof(StageBlock);
 
     std::cout << "  (" << (float)(block_pool_size / 1048576) << " MiB in size)" << std::endl;
@@ -84,13 +154,6 @@ struct StageChunkCollection::Impl
       throw new std::bad_alloc;
     }
 
-
-    num_of_chunks.x = (num_of_blocks.x / StageChunk::chunk_side_length) +
-        ((num_of_blocks.x % StageChunk::chunk_side_length == 0) ? 0 : 1);
-    num_of_chunks.y = (num_of_blocks.y / StageChunk::chunk_side_length) +
-        ((num_of_blocks.y % StageChunk::chunk_side_length == 0) ? 0 : 1);
-    num_of_chunks.z = num_of_blocks.z;
-
     std::cout << "Allocating a " << num_of_chunks.x << "x" <<
                                     num_of_chunks.y << "x" <<
                                     num_of_chunks.z <<
@@ -109,6 +172,24 @@ struct StageChunkCollection::Impl
     {
       throw new std::bad_alloc;
     }
+
+    // The chunks fill the substance index in as they claim their blocks.
+    if (Settings::stageSubstanceIndex)
+    {
+      unsigned int substance_count = SL->get_substance_count();
+      unsigned int chunk_count = num_of_chunks.x *
+                                 num_of_chunks.y *
+                                 num_of_chunks.z;
+
+      std::cout << "Allocating a substance index for " << substance_count <<
+                   " substances in " << chunk_count << " chunks...  (" <<
+                   (float)((substance_count * chunk_count *
+                            sizeof(uint16_t)) / 1024) <<
+                   " kiB in size.)" << std::endl;
+
+      substance_index.reset(new SubstanceChunkIndex(substance_count,
+                                                    chunk_count));
+    }
   }
 
   ~Impl()
@@ -148,17 +229,72 @@ struct StageChunkCollection::Impl
   /// Size of the stage, in StageChunks.
   StageCoord3 num_of_chunks;
 
+  /// Size of the block pool, in StageBlocks.  Same as num_of_blocks for the
+  /// Linear layout; rounded up to whole chunks for the others.
+  StageCoord3 num_of_stored_blocks;
+
+  /// Memory layout of the block pool.
+  BlockLayout layout;
+
+  /// Which chunks each substance appears in, if Settings::stageSubstanceIndex
+  /// is set.
+  std::unique_ptr<SubstanceChunkIndex> substance_index;
+
+  typedef std::vector<StageChunkListener*> ListenerList;
+
+  /// Objects to notify when chunks become dirty.  The list is never changed
+  /// once published; adding or removing a listener publishes a new copy, so
+  /// notify_chunk_dirty() can read it without taking a lock.
+  std::atomic<ListenerList const*> listeners;
+
+  /// Every listener list published so far.  Old lists are kept, as a
+  /// notification may still be reading one; listeners only come and go when
+  /// renderers are created and destroyed, so there are only ever a few.
+  std::vector<std::unique_ptr<ListenerList const> > listener_lists;
+
+  /// Serializes changes to the listener list.
+  boost::mutex listeners_mutex;
+
+  /// Publish a new listener list.  listeners_mutex must be held.
+  void publish_listeners(ListenerList* list)
+  {
+    listener_lists.emplace_back(list);
+    listeners.store(list, std::memory_order_release);
+  }
+
+  /// Table spreading the bits of a chunk-relative coordinate apart, so that
+  /// X and Y can be interleaved into a Z-order index.
+  int morton_spread[StageChunk::chunk_side_length];
+
+  /// Get a printable name for the layout in use.
+  char const* get_layout_name() const
+  {
+    switch (layout)
+    {
+    case BlockLayout::Linear:
+      return "linear";
+    case BlockLayout::Morton:
+      return "morton";
+    default:
+      return "tiled";
+    }
+  }
 };
 
 StageChunkCollection::StageChunkCollection(StageCoord3 total_block_size)
   : impl(new Impl(total_block_size))
 {
   std::cout << "Creating and initializing the StageBlock instances..." << std::endl;
-  for (int block_z = 0; block_z < impl->num_of_blocks.z; ++block_z)
+
+  // Padding blocks past the stage edges (in the tiled layouts) are constructed
+  // too, so the pool never holds uninitialized memory.  They belong to no
+  // chunk, and are never valid: getBlockPointer() refuses to hand them out,
+  // and chunks only walk the blocks inside the stage.
+  for (int block_z = 0; block_z < impl->num_of_stored_blocks.z; ++block_z)
   {
-    for (int block_y = 0; block_y < impl->num_of_blocks.y; ++block_y)
+    for (int block_y = 0; block_y < impl->num_of_stored_blocks.y; ++block_y)
     {
-      for (int block_x = 0; block_x < impl->num_of_blocks.x; ++block_x)
+      for (int block_x = 0; block_x < impl->num_of_stored_blocks.x; ++block_x)
       {
         int block_index = impl->calc_block_index(block_x, block_y, block_z);
 
@@ -224,6 +360,66 @@ void StageChunkCollection::accept(StageComponentVisitor& visitor)
   }
 }
 
+BlockLayout StageChunkCollection::get_layout() const
+{
+  return impl->layout;
+}
+
+std::string StageChunkCollection::get_layout_name() const
+{
+  return impl->get_layout_name();
+}
+
+StageCoord3 const& StageChunkCollection::get_size() const
+{
+  return impl->num_of_blocks;
+}
+
+void StageChunkCollection::add_listener(StageChunkListener* listener)
+{
+  boost::mutex::scoped_lock lock(impl->listeners_mutex);
+
+  Impl::ListenerList* list = new Impl::ListenerList(*(impl->listeners.load()));
+  list->push_back(listener);
+  impl->publish_listeners(list);
+
+  // Catch the new listener up on anything that is already dirty.  A chunk
+  // that becomes dirty meanwhile may be reported twice, which is harmless.
+  for (int chunk_index = 0; chunk_index < get_chunk_count(); ++chunk_index)
+  {
+    StageChunk* chunk = impl->get_chunk_location(chunk_index);
+    if (chunk->is_render_data_dirty())
+    {
+      listener->handle_chunk_dirty(*chunk);
+    }
+  }
+}
+
+void StageChunkCollection::remove_listener(StageChunkListener* listener)
+{
+  boost::mutex::scoped_lock lock(impl->listeners_mutex);
+
+  Impl::ListenerList* list = new Impl::ListenerList(*(impl->listeners.load()));
+  list->erase(std::remove(list->begin(), list->end(), listener), list->end());
+  impl->publish_listeners(list);
+}
+
+void StageChunkCollection::notify_chunk_dirty(StageChunk& chunk)
+{
+  Impl::ListenerList const* list =
+    impl->listeners.load(std::memory_order_acquire);
+
+  for (StageChunkListener* listener : *list)
+  {
+    listener->handle_chunk_dirty(chunk);
+  }
+}
+
+int StageChunkCollection::get_chunk_count() const
+{
+  return impl->num_of_chunks.x * impl->num_of_chunks.y * impl->num_of_chunks.z;
+}
+
 StageChunk& StageChunkCollection::getChunk(int idx)
 {
   return *(impl->get_chunk_location(idx));
@@ -256,12 +452,15 @@ StageBlock* StageChunkCollection::getBlockPointer(StageCoord block_x,
       (block_y >= impl->num_of_blocks.y) ||
       (block_z >= impl->num_of_blocks.z))
   {
-    std::cout << "Attempt to get block (" <<
-                  block_x << ", " <<
-                  block_y << ", " <<
-                  block_z << ")" << std::endl;
+    FATAL_ERROR("Attempt to get block (%d, %d, %d), outside the stage",
+                block_x, block_y, block_z);
   }
 
   int block_index = impl->calc_block_index(block_x, block_y, block_z);
   return impl->get_block_location(block_index);
 }
+
+SubstanceChunkIndex* StageChunkCollection::get_substance_index()
+{
+  return impl->substance_index.get();
+}
@@ -2,7 +2,6 @@
 
 #include <algorithm>
 #include <iterator>
-#include <list>
 #include <vector>
 #include <boost/container/list.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -15,42 +14,54 @@
 #include <glm/gtx/transform.hpp>
 
 #include "Application.h"
+#include "BoundedMPMCQueue.h"
 #include "ErrorMacros.h"
 #include "GLShaderProgram.h"
 #include "GLTexture.h"
+#include "HiddenFaceKernel.h"
+#include "JobSystem.h"
 #include "MathUtils.h"
+#include "ProfileTimer.h"
 #include "RenderData.h"
 #include "Settings.h"
 #include "Stage.h"
 #include "StageBlock.h"
 #include "StageChunk.h"
 #include "StageChunkCollection.h"
+#include "StageChunkHalo.h"
 #include "SubstanceLibrary.h"
 #include "VertexRenderData.h"
 
 struct StageRenderer3D::Impl
 {
-  /// Draws the stage block requested.
-  void draw_stage_block(StageBlock& block, RenderData& data)
+  /// Draws the stage block requested, using data from a chunk halo and the
+  /// face masks calculated from it.
+  void draw_stage_block(StageChunkHalo const& halo,
+                        HiddenFaceKernel::Output const& faces,
+                        StageCoord add_x,
+                        StageCoord add_y,
+                        RenderData& data)
   {
-    glm::vec3 coord = glm::vec3(block.get_coords().x,
-                                block.get_coords().y,
-                                block.get_coords().z);
-
-    FaceBools hiddenFacesSolid = block.get_hidden_faces(BlockLayer::Solid);
-    FaceBools hiddenFacesFluid = block.get_hidden_faces(BlockLayer::Fluid);
-
-    glm::vec4 colorSolid = SL->get(block.get_substance(BlockLayer::Solid))->get_data().color;
-    glm::vec4 colorFluid = SL->get(block.get_substance(BlockLayer::Fluid))->get_data().color;
+    int halo_index = StageChunkHalo::index(add_x, add_y);
+    int face_index = (add_y * StageChunk::chunk_side_length) + add_x;
+    uint8_t summary = halo.summary[StageChunkHalo::Center][halo_index];
+    uint8_t hiddenFacesSolid = faces.solid[face_index];
+    uint8_t hiddenFacesFluid = faces.fluid[face_index];
+
+    if ((Settings::debugMapRevealAll || (summary & StageBlock::SummaryKnown)) &&
+        (summary & StageBlock::SummaryVisible) &&
+        ((hiddenFacesSolid & hiddenFacesFluid) != FaceBools::all_mask))
+    {
+      glm::vec3 coord = glm::vec3(halo.coords.x + add_x,
+                                  halo.coords.y + add_y,
+                                  halo.coords.z);
 
-    glm::vec4 colorSpecularSolid = SL->get(block.get_substance(BlockLayer::Solid))->get_data().color_specular;
-    glm::vec4 colorSpecularFluid = SL->get(block.get_substance(BlockLayer::Fluid))->get_data().color_specular;
+      SubstanceLibraryShPtr library = SL;
+      SubstanceData solid = library->get(halo.solid[StageChunkHalo::Center][halo_index])->get_data();
+      SubstanceData fluid = library->get(halo.fluid[StageChunkHalo::Center][halo_index])->get_data();
 
-    if ((Settings::debugMapRevealAll || block.is_known()) &&
-        block.is_visible() && block.has_any_visible_faces())
-    {
-      draw_block(data, coord, colorSolid, colorSpecularSolid, hiddenFacesSolid);
-      draw_block(data, coord, colorFluid, colorSpecularFluid, hiddenFacesFluid);
+      draw_block(data, coord, solid.color, solid.color_specular, hiddenFacesSolid);
+      draw_block(data, coord, fluid.color, fluid.color_specular, hiddenFacesFluid);
     }
   }
 
@@ -113,11 +124,12 @@ struct StageRenderer3D::Impl
   }
 
   /// Draws a stage block, taking into account hidden faces.
+  /// Bit N of the hidden mask corresponds to FaceName N.
   void draw_block(RenderData& data,
                   glm::vec3 coord,
                   glm::vec4 color,
                   glm::vec4 color_spec,
-                  FaceBools hidden = FaceBools())
+                  uint8_t hidden = 0)
   {
     // Get the vertex coordinates; Z/Y are flipped because the game treats
     // Y as back-to-front and Z as top-to-bottom.
@@ -200,7 +212,7 @@ struct StageRenderer3D::Impl
     static glm::vec3 const point_U   = glm::vec3( 0.0f,  1.0f,  0.0f);
     static glm::vec3 const point_D   = glm::vec3( 0.0f, -1.0f,  0.0f);
 
-    if (hidden.back() != true)
+    if ((hidden & (1 << (int) FaceName::Back)) == 0)
     {
       data.add_vertex(coord, bkLoLt, point_N, color, color_spec, texCoord);
       data.add_vertex(coord, bkLoRt, point_N, color, color_spec, texCoord);
@@ -210,7 +222,7 @@ struct StageRenderer3D::Impl
       data.add_vertex(coord, bkLoLt, point_N, color, color_spec, texCoord);
     }
 
-    if (hidden.top() != true)
+    if ((hidden & (1 << (int) FaceName::Top)) == 0)
     {
       // Top
       data.add_vertex(coord, bkUpRt, point_U, color, color_spec, txUpRt);
@@ -311,7 +323,7 @@ struct StageRenderer3D::Impl
       data.add_vertex(coord, CapHiC, point_U, color, color_spec, texCoord);
     }
 
-    if (hidden.left() != true)
+    if ((hidden & (1 << (int) FaceName::Left)) == 0)
     {
       data.add_vertex(coord, ftUpLt, point_W, color, color_spec, txUpRt);
       data.add_vertex(coord, bkUpLt, point_W, color, color_spec, txUpLt);
@@ -321,7 +333,7 @@ struct StageRenderer3D::Impl
       data.add_vertex(coord, ftUpLt, point_W, color, color_spec, txUpRt);
     }
 
-    if (hidden.bottom() != true)
+    if ((hidden & (1 << (int) FaceName::Bottom)) == 0)
     {
       data.add_vertex(coord, bkLoRt, point_D, color, color_spec, txLoRt);
       data.add_vertex(coord, bkLoLt, point_D, color, color_spec, txLoLt);
@@ -331,7 +343,7 @@ struct StageRenderer3D::Impl
       data.add_vertex(coord, bkLoRt, point_D, color, color_spec, txLoRt);
     }
 
-    if (hidden.right() != true)
+    if ((hidden & (1 << (int) FaceName::Right)) == 0)
     {
       data.add_vertex(coord, ftUpRt, point_E, color, color_spec, txUpLt);
       data.add_vertex(coord, bkUpRt, point_E, color, color_spec, txUpRt);
@@ -341,7 +353,7 @@ struct StageRenderer3D::Impl
       data.add_vertex(coord, ftUpRt, point_E, color, color_spec, txUpLt);
     }
 
-    if (hidden.front() != true)
+    if ((hidden & (1 << (int) FaceName::Front)) == 0)
     {
       data.add_vertex(coord, ftLoLt, point_S, color, color_spec, txLoLt);
       data.add_vertex(coord, ftLoRt, point_S, color, color_spec, txLoRt);
@@ -352,11 +364,80 @@ struct StageRenderer3D::Impl
     }
   }
 
+  /// Prints and resets accumulated face calculation/meshing times.
+  void report_profile(std::string layout_name)
+  {
+    if (Settings::debugProfile && (profile_chunk_count > 0))
+    {
+      std::cout << "PROFILE: Refreshed " << profile_chunk_count <<
+                   " chunks (" << layout_name << " block layout): " <<
+                   "face calculation took " << profile_face_ms << " ms, " <<
+                   "meshing took " << profile_mesh_ms << " ms" << std::endl;
+    }
+
+    profile_face_ms = 0;
+    profile_mesh_ms = 0;
+    profile_chunk_count = 0;
+  }
+
+  /// A stale chunk being refreshed, and the scratch space used to mesh it.
+  struct MeshJob
+  {
+    StageChunk* chunk;              ///< Chunk being refreshed
+    RenderData* render_data;        ///< Rendering data for the chunk
+    bool needs_mesh;                ///< False if the chunk shows nothing
+    StageChunkHalo halo;            ///< Snapshot of the chunk
+    HiddenFaceKernel::Output faces; ///< Hidden faces of the chunk
+    double face_ms;                 ///< Time spent calculating faces
+    double mesh_ms;                 ///< Time spent meshing
+  };
+
+  /// Snapshots and meshes one stale chunk.  Runs on the job system, so it
+  /// must only touch its own MeshJob.
+  void mesh_chunk(MeshJob& job)
+  {
+    job.face_ms = 0;
+    job.mesh_ms = 0;
+
+    if (!job.needs_mesh)
+    {
+      return;
+    }
+
+    // Take a snapshot of the chunk and its surroundings, and work out hidden
+    // faces from that; the face calculation and meshing passes are timed
+    // separately.
+    ProfileTimer face_timer;
+    job.chunk->capture_halo(job.halo);
+    HiddenFaceKernel::calculate(job.halo, job.faces);
+    job.face_ms = face_timer.get_elapsed_ms();
+
+    ProfileTimer mesh_timer;
+    for (StageCoord add_y = 0; add_y < StageChunk::chunk_side_length; ++add_y)
+    {
+      for (StageCoord add_x = 0; add_x < StageChunk::chunk_side_length; ++add_x)
+      {
+        draw_stage_block(job.halo, job.faces, add_x, add_y, *(job.render_data));
+      }
+    }
+    job.mesh_ms = mesh_timer.get_elapsed_ms();
+  }
+
+  /// Most stale chunks refreshed per frame.  They are meshed in parallel on
+  /// the job system, then uploaded to the GPU on the rendering thread.
+  static const unsigned int max_chunks_per_frame = 8;
+
+  /// Chunks being refreshed this frame.
+  std::vector<MeshJob> mesh_jobs;
+
   typedef boost::ptr_map<StageChunk*, RenderData> RenderDataMap;
-  typedef std::list<StageChunk*> StaleChunkCollection;
+  typedef BoundedMPMCQueue<StageChunk*> StaleChunkQueue;
 
   RenderDataMap chunk_data;         ///< Map of rendering data to StageChunks
-  StaleChunkCollection stale_chunks_; ///< List of chunks that need refreshing
+
+  /// Queue of chunks that need refreshing.  Created when we start listening
+  /// to the stage, once we know how many chunks there are.
+  std::unique_ptr<StaleChunkQueue> stale_chunks_;
 
   glm::vec3 light_dir;              ///< Light direction in world space
   glm::vec3 light_color;            ///< Light color
@@ -368,7 +449,9 @@ struct StageRenderer3D::Impl
 
   GLuint frame_counter;             ///< Frame counter
 
-  boost::mutex stale_chunks_mutex; ///< Mutex for stale chunks set.
+  double profile_face_ms;           ///< Time spent calculating faces
+  double profile_mesh_ms;           ///< Time spent meshing chunks
+  unsigned int profile_chunk_count; ///< Chunks refreshed since last report
 
   std::unique_ptr<GLShaderProgram> render_program; ///< Chunk rendering program
 
@@ -405,6 +488,8 @@ StageRenderer3D::StageRenderer3D()
 {
   name_ = "3D Renderer";
 
+  impl->mesh_jobs.resize(Impl::max_chunks_per_frame);
+
   // Create and compile the GLSL chunk rendering program from the shaders.
   impl->render_program.reset(
     new GLShaderProgram("shaders/3DVertexShader.glsl",
@@ -444,6 +529,11 @@ StageRenderer3D::StageRenderer3D()
   impl->camera_x_angle = -10.0f;
   impl->camera_y_angle = 30.0f;
 
+  // Clear the profiling counters.
+  impl->profile_face_ms = 0;
+  impl->profile_mesh_ms = 0;
+  impl->profile_chunk_count = 0;
+
   // TEST CODE: Load the test texture.
   //impl->texture_test.reset(new GLTexture());
   //impl->texture_test->load("textures/test-checkerboard.png");
@@ -455,6 +545,10 @@ StageRenderer3D::StageRenderer3D()
 
 StageRenderer3D::~StageRenderer3D()
 {
+  if (impl->stale_chunks_)
+  {
+    Stage::get_instance()->remove_chunk_listener(this);
+  }
 }
 
 bool StageRenderer3D::visit(Stage& stage)
@@ -474,30 +568,27 @@ bool StageRenderer3D::visit(StageBlock& block)
 
 bool StageRenderer3D::visit(StageChunk& chunk)
 {
-  // See if the chunk's vertex data needs to be recalculated.
-  if (chunk.is_render_data_dirty())
-  {
-    boost::mutex::scoped_lock lock(impl->stale_chunks_mutex);
-
-    // Try to avoid pushing the exact same chunk onto the list twice in a row.
-    // This will not eliminate all repeat chunks, but it will reduce them.
-    // TODO: Another option is to periodically use .unique() to compress the
-    //       list.
-    if ((impl->stale_chunks_.size() == 0) ||
-        (impl->stale_chunks_.back() != &chunk))
-    {
-      impl->stale_chunks_.push_back(&chunk);
-      chunk.set_render_data_dirty(false);
-    }
-  }
-
-  // Since we visited the blocks underneath ourself, we don't need the caller to do it.
+  // Stale chunks arrive via handle_chunk_dirty(), so there's nothing to do.
   return false;
 }
 
 bool StageRenderer3D::visit(StageChunkCollection& collection)
 {
-  return true;
+  return false;
+}
+
+void StageRenderer3D::handle_chunk_dirty(StageChunk& chunk)
+{
+  // The queued flag makes sure each chunk is on the queue at most once.
+  if (chunk.try_mark_queued())
+  {
+    if (!impl->stale_chunks_->push(&chunk))
+    {
+      // Can't happen unless the queue is smaller than the chunk count, but
+      // if it does, the chunk will be picked up by its next change.
+      chunk.clear_queued();
+    }
+  }
 }
 
 EventResult StageRenderer3D::handle_window_resize(int w, int h)
@@ -580,44 +671,81 @@ void StageRenderer3D::draw()
   // Set the viewport to match window size.
   glViewport(0.0f, 0.0f, (float) window_size.x, (float) window_size.y);
 
-  // See if any chunks are stale and need re-rendering.
+  // Start listening for stale chunks once the stage has some.
+  if (!impl->stale_chunks_ && stage->okay_to_render_map())
   {
-    unsigned int stale_chunk_count = 1; /// @todo eliminate magic number
+    impl->stale_chunks_.reset(
+      new Impl::StaleChunkQueue(stage->get_chunk_count()));
+    stage->add_chunk_listener(this);
+  }
 
-    boost::mutex::scoped_lock lock(impl->stale_chunks_mutex);
+  // See if any chunks are stale and need re-rendering.
+  if (impl->stale_chunks_)
+  {
+    unsigned int job_count = 0;
+    StageChunk* chunk;
 
-    // Update stale chunks on the list, up to the number defined above.
-    while ((impl->stale_chunks_.size() > 0) && (stale_chunk_count > 0))
+    // Take stale chunks off the queue, up to the limit for one frame.
+    while ((job_count < Impl::max_chunks_per_frame) &&
+           impl->stale_chunks_->pop(chunk))
     {
-      --stale_chunk_count;
-      StageChunk* chunk = impl->stale_chunks_.front();
-      impl->stale_chunks_.pop_front();
-      RenderData& render_data = impl->chunk_data[chunk];
-
-      render_data.clear_vertices();
+      impl->mesh_jobs[job_count].chunk = chunk;
+      ++job_count;
+    }
 
-      StageCoord3 chunk_coords = chunk->get_coords();
+    for (unsigned int index = 0; index < job_count; ++index)
+    {
+      Impl::MeshJob& job = impl->mesh_jobs[index];
+      chunk = job.chunk;
+
+      // Clear the flags before the snapshot is taken, so any change made from
+      // here on marks the chunk dirty again and it gets re-queued.  This is
+      // done only once the batch is complete, so that a re-queued chunk
+      // can't be popped into the same batch twice.
+      chunk->take_from_queue();
+
+      // Rendering data owns GL objects, so it has to be created here.
+      job.render_data = &(impl->chunk_data[chunk]);
+      job.render_data->clear_vertices();
+
+      // Chunks with nothing to show can skip meshing entirely.
+      job.needs_mesh = chunk->is_visible() &&
+                       (Settings::debugMapRevealAll || chunk->is_known());
+    }
 
-      for (StageCoord add_y = 0;
-                      add_y < StageChunk::chunk_side_length; ++add_y)
+    if (job_count > 0)
+    {
       {
-        for (StageCoord add_x = 0;
-                        add_x < StageChunk::chunk_side_length; ++add_x)
+        // Keep substances from being reloaded out from under the meshers.
+        boost::mutex::scoped_lock lock(SL->get_reload_mutex());
+
+        App::instance().get_jobs().parallel_for(job_count, 1,
+            [this](unsigned int first, unsigned int last)
         {
-          int block_x = chunk_coords.x + add_x;
-          int block_y = chunk_coords.y + add_y;
-          int block_z = chunk_coords.z;
+          for (unsigned int index = first; index < last; ++index)
+          {
+            impl->mesh_chunk(impl->mesh_jobs[index]);
+          }
+        }, JobSystem::Priority::High);
+      }
 
-          StageBlock& block = chunk->get_parent()->get_block(block_x,
-                                                            block_y,
-                                                            block_z);
+      // Update vertex information on the GPU.
+      for (unsigned int index = 0; index < job_count; ++index)
+      {
+        Impl::MeshJob& job = impl->mesh_jobs[index];
+        job.render_data->update_VAOs();
 
-          impl->draw_stage_block(block, render_data);
-        }
+        impl->profile_face_ms += job.face_ms;
+        impl->profile_mesh_ms += job.mesh_ms;
+        ++(impl->profile_chunk_count);
       }
 
-      // Update vertex information on the GPU.
-      render_data.update_VAOs();
+      // Once the queue drains, report how long the passes took in total.
+      if (impl->stale_chunks_->size_approx() == 0)
+      {
+        impl->report_profile(
+          impl->mesh_jobs[0].chunk->get_parent()->get_layout_name());
+      }
     }
   }
 
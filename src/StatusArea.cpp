@@ -31,6 +31,7 @@ StatusArea::StatusArea(GUIElement* parent)
   test_label->set_size(glm::vec2(300, 20));
   test_label->set_visible(true);
   test_label->setText(U"Testing GUILabel");
+  test_label->setOutlined(true);
   frame->add_child(test_label);
 }
 
@@ -1,6 +1,7 @@
 #include "Substance.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
@@ -9,6 +10,7 @@
 #include <unordered_map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -17,10 +19,25 @@
 #include <glm/glm.hpp>
 #include <noise/noise.h>
 
+#include "DescriptorDatabase.h"
 #include "ErrorMacros.h"
 #include "Settings.h"
 #include "TextureAtlas.h"
 
+/// Like MINOR_ERROR and MAJOR_ERROR, but for use in Substance::parse(): the
+/// error is kept in the substance until report_errors() is called.
+#define PARSE_MINOR_ERROR(...) PARSE_ERROR(false, __VA_ARGS__)
+#define PARSE_MAJOR_ERROR(...) PARSE_ERROR(true, __VA_ARGS__)
+
+#define PARSE_ERROR(is_major, ...)                                        \
+{                                                                         \
+  char buf[1024];                                                         \
+  snprintf(buf, 1024, __VA_ARGS__);                                       \
+  Impl::ParseError error =                                                \
+    { is_major, buf, __FILE__, __LINE__, __func__ };                      \
+  impl->errors.push_back(error);                                          \
+}
+
 typedef boost::ptr_unordered_map<std::string, Substance> SubstanceCollection;
 typedef std::unordered_map<std::string, std::set<std::string> > Categories;
 typedef std::unordered_map<std::string, std::set<std::string> > Verbs;
@@ -28,6 +45,40 @@ typedef boost::filesystem::path MaterialPath;
 typedef std::vector<std::string> NameVector;
 typedef NameVector::const_iterator NameIterator;
 
+namespace
+{
+  /// Descriptor path and default value of a property in the schema.
+  template <typename T>
+  struct SchemaEntry
+  {
+    char const* path;
+    T default_value;
+  };
+
+  /// Schema for SubstanceBoolProperty, in enum order.
+  SchemaEntry<bool> const bool_schema[] =
+  {
+    { "attributes.soil", false },
+    { "attributes.water", false }
+  };
+
+  /// Schema for SubstanceStringProperty, in enum order.
+  SchemaEntry<char const*> const string_schema[] =
+  {
+    { "name", "" },
+    { "terrain.layer", "" },
+    { "attributes.ore", "" },
+    { "attributes.secondaryore", "" }
+  };
+
+  static_assert(sizeof(bool_schema) / sizeof(bool_schema[0]) ==
+                (size_t) SubstanceBoolProperty::Count,
+                "bool_schema doesn't match SubstanceBoolProperty");
+  static_assert(sizeof(string_schema) / sizeof(string_schema[0]) ==
+                (size_t) SubstanceStringProperty::Count,
+                "string_schema doesn't match SubstanceStringProperty");
+}
+
 struct Substance::Impl
 {
   /// Property tree containing all properties of this chunk type.
@@ -35,17 +86,79 @@ struct Substance::Impl
 
   /// Data corresponding to material.
   SubstanceData data;
+
+  /// ID assigned by the SubstanceLibrary.
+  SubstanceID id;
+
+  /// Values of the schema properties, indexed by SubstanceBoolProperty.
+  std::array<bool, (size_t) SubstanceBoolProperty::Count> bool_slots;
+
+  /// Values of the schema properties, indexed by SubstanceStringProperty.
+  std::array<std::string, (size_t) SubstanceStringProperty::Count> string_slots;
+
+  /// Look every schema property up in the property tree.
+  void resolve_schema()
+  {
+    for (size_t index = 0; index < bool_slots.size(); ++index)
+    {
+      bool_slots[index] = properties.get<bool>(bool_schema[index].path,
+                                               bool_schema[index].default_value);
+    }
+
+    for (size_t index = 0; index < string_slots.size(); ++index)
+    {
+      string_slots[index] = properties.get<std::string>(
+                              string_schema[index].path,
+                              string_schema[index].default_value);
+    }
+  }
+
+  /// Categories this substance belongs to.
+  CategorySet categories;
+
+  /// Texture image read by parse(), waiting for finish_load() to add it to
+  /// the texture atlas.
+  std::unique_ptr<sf::Image> pending_image;
+
+  /// Path of the texture image, if parse() found one.  If there is no
+  /// pending_image, the texture atlas already has a baked copy of it.
+  std::string image_name;
+
+  /// An error found by parse().
+  struct ParseError
+  {
+    bool major;
+    std::string message;
+    char const* file;
+    int line;
+    char const* func;
+  };
+
+  /// Errors found by parse(), waiting for report_errors().
+  std::vector<ParseError> errors;
 };
 
 Substance::Substance()
   : impl(new Impl())
 {
+  impl->id = SUBSTANCEID_NULL;
+  impl->resolve_schema();
 }
 
 Substance::~Substance()
 {
 }
 
+bool Substance::get(SubstanceBoolProperty property) const
+{
+  return impl->bool_slots[(size_t) property];
+}
+
+std::string const& Substance::get(SubstanceStringProperty property) const
+{
+  return impl->string_slots[(size_t) property];
+}
+
 std::string Substance::get_string_property(std::string property) const
 {
   return impl->properties.get(property, "");
@@ -63,11 +176,45 @@ bool Substance::get_bool_property(std::string property,
   return impl->properties.get<bool>(property, default_value);
 }
 
+CategorySet const& Substance::get_categories() const
+{
+  return impl->categories;
+}
+
+bool Substance::in_category(CategoryID category) const
+{
+  return (category < impl->categories.size()) && impl->categories[category];
+}
+
+void Substance::add_category(CategoryID category)
+{
+  if (category >= impl->categories.size())
+  {
+    impl->categories.resize(category + 1);
+  }
+  impl->categories.set(category);
+}
+
+void Substance::resize_categories(unsigned int category_count)
+{
+  impl->categories.resize(category_count);
+}
+
 SubstanceData Substance::get_data() const
 {
   return impl->data;
 }
 
+SubstanceID Substance::get_id() const
+{
+  return impl->id;
+}
+
+void Substance::set_id(SubstanceID id)
+{
+  impl->id = id;
+}
+
 Visibility Substance::get_visibility() const
 {
   return impl->data.visibility;
@@ -99,6 +246,14 @@ void Substance::check_consistency(void)
 }
 
 bool Substance::load(std::string _name)
+{
+  bool success = parse(_name);
+  report_errors();
+  finish_load();
+  return success;
+}
+
+bool Substance::parse(std::string _name)
 {
   bool is_opaque, is_visible;
 
@@ -107,16 +262,19 @@ bool Substance::load(std::string _name)
   // Attempt to load the property tree for this substance.
   try
   {
-    read_xml("data/substances/" + impl->data.name + ".xml", impl->properties,
-             boost::property_tree::xml_parser::trim_whitespace);
+    DescriptorDatabase::instance()->read(
+      DescriptorDatabase::Section::Substances, impl->data.name,
+      impl->properties);
   }
   catch (std::exception& e)
   {
-    MINOR_ERROR("Can't parse \"%s\" descriptor file: %s",
-                impl->data.name.c_str(), e.what());
+    PARSE_MINOR_ERROR("Can't parse \"%s\" descriptor file: %s",
+                      impl->data.name.c_str(), e.what());
     return false;
   }
 
+  impl->resolve_schema();
+
   // Get substance visibility.
   // TODO: replace display.opaque, display.visible with single "display.visibility" attribute in XML.
   is_opaque = impl->properties.get<bool>("display.opaque", false);
@@ -167,8 +325,8 @@ bool Substance::load(std::string _name)
   }
   else
   {
-    MAJOR_ERROR("Substance \"%s\" has unknown phase \"%s\"",
-                impl->data.name.c_str(), strPhase.c_str());
+    PARSE_MAJOR_ERROR("Substance \"%s\" has unknown phase \"%s\"",
+                      impl->data.name.c_str(), strPhase.c_str());
     impl->data.phase = Phase::Unknown;
   }
 
@@ -225,18 +383,64 @@ bool Substance::load(std::string _name)
   // substance-XXXX where XXXX is the material name.
   std::string imageName = "sprites/substance-" + impl->data.name + ".tga";
 
-  sf::Image tempImage;
-
-  bool success = false;
+  impl->image_name.clear();
 
   if ((Settings::renderLoadTextures) && (boost::filesystem::exists(imageName)))
   {
-    success = tempImage.loadFromFile(imageName);
+    if (TAtlas->hasBaked(imageName))
+    {
+      impl->image_name = imageName;
+    }
+    else
+    {
+      impl->pending_image.reset(new sf::Image());
+      if (impl->pending_image->loadFromFile(imageName))
+      {
+        impl->image_name = imageName;
+      }
+      else
+      {
+        impl->pending_image.reset();
+      }
+    }
   }
 
-  if (success)
+  return true;
+}
+
+void Substance::report_errors()
+{
+  for (Impl::ParseError const& error : impl->errors)
+  {
+    char buf[1024];
+    snprintf(buf, 1024, "%s", error.message.c_str());
+
+    if (error.major)
+    {
+      Settings::handleMajorError(buf, error.file, error.line, error.func);
+    }
+    else
+    {
+      Settings::handleMinorError(buf, error.file, error.line, error.func);
+    }
+  }
+
+  impl->errors.clear();
+}
+
+void Substance::finish_load()
+{
+  if (impl->pending_image)
+  {
+    impl->data.texNumber = TAtlas->save(*(impl->pending_image),
+                                        impl->image_name);
+    impl->data.colorRender = glm::vec4(1.0f);
+    impl->data.textured = true;
+    impl->pending_image.reset();
+  }
+  else if (!impl->image_name.empty())
   {
-    impl->data.texNumber = TAtlas->save(tempImage);
+    impl->data.texNumber = TAtlas->useBaked(impl->image_name);
     impl->data.colorRender = glm::vec4(1.0f);
     impl->data.textured = true;
   }
@@ -245,8 +449,6 @@ bool Substance::load(std::string _name)
     impl->data.colorRender = impl->data.color;
     impl->data.textured = false;
   }
-
-  return true;
 }
 
 boost::property_tree::ptree const& Substance::get_properties() const
@@ -0,0 +1,80 @@
+#include "SubstanceChunkIndex.h"
+
+#include "ErrorMacros.h"
+
+SubstanceChunkIndex::SubstanceChunkIndex(unsigned int substance_count,
+                                         unsigned int chunk_count)
+  : substance_count_(substance_count),
+    chunk_count_(chunk_count),
+    counts_(substance_count * chunk_count, 0),
+    totals_(substance_count, 0),
+    chunks_(substance_count, boost::dynamic_bitset<>(chunk_count)),
+    no_chunks_(chunk_count)
+{
+}
+
+SubstanceChunkIndex::~SubstanceChunkIndex()
+{
+}
+
+unsigned int SubstanceChunkIndex::get_count(unsigned int chunk_index,
+                                            SubstanceID id) const
+{
+  if ((id >= substance_count_) || (chunk_index >= chunk_count_))
+  {
+    return 0;
+  }
+
+  return counts_[(id * chunk_count_) + chunk_index];
+}
+
+unsigned int SubstanceChunkIndex::get_total(SubstanceID id) const
+{
+  if (id >= substance_count_)
+  {
+    return 0;
+  }
+
+  return totals_[id];
+}
+
+boost::dynamic_bitset<> const& SubstanceChunkIndex::get_chunks(SubstanceID id) const
+{
+  if (id >= substance_count_)
+  {
+    return no_chunks_;
+  }
+
+  return chunks_[id];
+}
+
+boost::dynamic_bitset<> SubstanceChunkIndex::get_chunks(
+  boost::dynamic_bitset<> const& substances) const
+{
+  boost::dynamic_bitset<> result(chunk_count_);
+
+  if (substances.size() > substance_count_)
+  {
+    MINOR_ERROR("Substance set has %u bits, but only %u substances are indexed",
+                (unsigned int) substances.size(), substance_count_);
+  }
+
+  for (size_t id = substances.find_first();
+       (id != boost::dynamic_bitset<>::npos) && (id < substance_count_);
+       id = substances.find_next(id))
+  {
+    result |= chunks_[id];
+  }
+
+  return result;
+}
+
+unsigned int SubstanceChunkIndex::get_substance_count() const
+{
+  return substance_count_;
+}
+
+unsigned int SubstanceChunkIndex::get_chunk_count() const
+{
+  return chunk_count_;
+}
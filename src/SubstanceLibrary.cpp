@@ -1,13 +1,18 @@
 #include "SubstanceLibrary.h"
 
+#include <algorithm>
 #include <unordered_map>
 #include <set>
 #include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
+#include "Application.h"
 #include "ErrorMacros.h"
+#include "JobSystem.h"
 #include "MathUtils.h"
+#include "ProfileTimer.h"
+#include "TextureAtlas.h"
 
 // Using declarations
 using SubstanceCollection = std::unordered_map<std::string, SubstanceShPtr>;
@@ -19,6 +24,17 @@ using StringIterator = StringVector::const_iterator;
 
 struct SubstanceLibrary::Impl
 {
+  /// Load a set of substances.  The descriptor files are parsed in parallel
+  /// on the job system; the results are then added to the library one at a
+  /// time, in name order, so the library and texture atlas come out the same
+  /// regardless of thread timing or directory order.  Parse errors are
+  /// reported from the calling thread, in the same order.
+  /// @param names        Names of the substances to load.
+  /// @param keep_failed  If true, a substance whose descriptor can't be read
+  ///                     is added with default properties; otherwise it is
+  ///                     left out of the library.
+  void load_substances(StringVector names, bool keep_failed);
+
   /// Given a particular substance, populate category info for the substance.
   void populate_categories(SubstanceShPtr substance);
 
@@ -31,11 +47,75 @@ struct SubstanceLibrary::Impl
   /// Check substances overall for consistency.
   void check_substances(void);
 
+  /// Look up the IDs of the categories check_substance() works with.
+  void add_checked_categories(void);
+
+  /// Check a single substance for consistency, add the categories it
+  /// implies, and add it to the deposit lists of the substances it says it
+  /// is found in.
+  void check_substance(std::string const& substance_name,
+                       SubstanceShPtr substance);
+
+  /// Take a substance back out of every deposit list it was added to.
+  void remove_deposits(std::string const& substance_name);
+
+  /// Take a substance back out of the layer and verb tables.
+  void remove_layers_and_verbs(std::string const& substance_name);
+
+  /// Assign dense IDs to all substances, in name order.
+  void assign_ids(void);
+
+  /// Get the ID of a category, assigning the next one if it is new.
+  CategoryID add_category(std::string const& name);
+
+  /// Size every substance's category set to the final category count, and
+  /// gather the sets into category_column.
+  void finish_categories(void);
+
   /// Collection of known substances.
   SubstanceCollection collection;
 
-  /// Collection of categories and substances classified into them.
-  StringMapSet categories;
+  /// Substances indexed by ID.
+  std::vector<SubstanceShPtr> substances_by_id;
+
+  /// Substance names indexed by ID.
+  StringVector names_by_id;
+
+  /// Substance IDs indexed by name.
+  std::unordered_map<std::string, SubstanceID> ids;
+
+  /// ID of the "nothing" substance, used as a fallback.
+  SubstanceID nothing_id;
+
+  /// Category IDs indexed by name.
+  std::unordered_map<std::string, CategoryID> category_ids;
+
+  /// Category names indexed by ID.
+  StringVector category_names;
+
+  /// Category set of every substance, indexed by substance ID.
+  std::vector<CategorySet> category_column;
+
+  /// IDs of the categories check_substance() adds and checks.  Category IDs
+  /// never change once assigned, so these are looked up once, before the
+  /// first substance is checked.
+  struct CheckedCategories
+  {
+    CategoryID conductor;
+    CategoryID flat;
+    CategoryID flux;
+    CategoryID fuel;
+    CategoryID gem;
+    CategoryID granular;
+    CategoryID grass;
+    CategoryID metal;
+    CategoryID plant;
+    CategoryID polished;
+    CategoryID rock;
+    CategoryID sand;
+    CategoryID soil;
+    CategoryID wood;
+  } checked;
 
   /// Collection of layer types and substances classified into them.
   StringMapVector layers;
@@ -43,25 +123,78 @@ struct SubstanceLibrary::Impl
   /// Collection of verbs and substances associated with them.
   StringMapSet verbs;
 
+  /// Held while reloaded substances are swapped in.
+  boost::mutex reload_mutex;
+
   /// Pointer to the library instance.
   static SubstanceLibraryShPtr instance_;
 };
 
 SubstanceLibraryShPtr SubstanceLibrary::Impl::instance_;
 
+void SubstanceLibrary::Impl::load_substances(StringVector names,
+                                             bool keep_failed)
+{
+  std::sort(names.begin(), names.end());
+
+  std::vector<SubstanceShPtr> loaded(names.size());
+  std::vector<char> parsed(names.size());
+
+  // Make sure the texture atlas, and any baked copy of it, is loaded before
+  // the parsers start asking it about images.
+  TextureAtlas::instance();
+
+  {
+    ProfileTimer timer("Parsing " + std::to_string(names.size()) +
+                       " substance descriptors");
+
+    App::instance().get_jobs().parallel_for(names.size(), 4,
+        [&](unsigned int first, unsigned int last)
+    {
+      for (unsigned int index = first; index < last; ++index)
+      {
+        if (Settings::debugShowVerboseInfo)
+        {
+          std::cout << "Parsing substance " << names[index] << "."
+                    << std::endl;
+        }
+        loaded[index].reset(new Substance());
+        parsed[index] = loaded[index]->parse(names[index]);
+      }
+    });
+  }
+
+  ProfileTimer timer("Merging " + std::to_string(names.size()) +
+                     " substances into the library");
+
+  for (unsigned int index = 0; index < names.size(); ++index)
+  {
+    SubstanceShPtr substance = loaded[index];
+    substance->report_errors();
+
+    if (!parsed[index] && !keep_failed)
+    {
+      MINOR_ERROR("Leaving substance \"%s\" out of the library",
+                  names[index].c_str());
+      continue;
+    }
+
+    substance->finish_load();
+    collection[names[index]] = substance;
+    populate_layers(substance);
+    populate_categories(substance);
+    populate_verbs(substance);
+  }
+}
+
 void SubstanceLibrary::Impl::populate_categories(SubstanceShPtr substance)
 {
   // Use attributes to populate substance category information.
   try
   {
-    Properties props = substance->get_properties();
-    std::string category_name;
-    std::string substance_name = substance->get_data().name;
-
-    for (auto v : props.get_child("attributes"))
+    for (auto const& v : substance->get_properties().get_child("attributes"))
     {
-      category_name = v.first;
-      categories[category_name].insert(substance_name);
+      substance->add_category(add_category(v.first));
     }
   }
   catch (const boost::property_tree::ptree_bad_path& p)
@@ -73,9 +206,8 @@ void SubstanceLibrary::Impl::populate_categories(SubstanceShPtr substance)
 void SubstanceLibrary::Impl::populate_layers(SubstanceShPtr substance)
 {
   // Check terrain inclusion layers.
-  Properties props = substance->get_properties();
-
-  std::string layer_name = substance->get_string_property("terrain.layer");
+  std::string const& layer_name =
+    substance->get(SubstanceStringProperty::TerrainLayer);
   std::string substance_name = substance->get_data().name;
   if (layer_name != "")
   {
@@ -119,255 +251,370 @@ void SubstanceLibrary::Impl::check_substances(void)
 {
   std::cout << "*** Parsing substance descriptors for consistency..."
             << std::endl;
-  int matCount = 0;
+
+  add_checked_categories();
 
   for (auto substance_iterator = collection.begin();
        substance_iterator != collection.end();
        ++substance_iterator)
   {
-    ++matCount;
+    check_substance(substance_iterator->first, substance_iterator->second);
+  }
+  std::cout << "*** Done parsing descriptors:  " << std::endl;
+  std::cout << "***   " << collection.size() << " substances parsed"
+            << std::endl;
+  std::cout << "***   " << category_names.size()
+            << " distinct substance attributes counted" << std::endl;
+}
+
+void SubstanceLibrary::Impl::add_checked_categories(void)
+{
+  checked.conductor = add_category("conductor");
+  checked.flat = add_category("flat");
+  checked.flux = add_category("flux");
+  checked.fuel = add_category("fuel");
+  checked.gem = add_category("gem");
+  checked.granular = add_category("granular");
+  checked.grass = add_category("grass");
+  checked.metal = add_category("metal");
+  checked.plant = add_category("plant");
+  checked.polished = add_category("polished");
+  checked.rock = add_category("rock");
+  checked.sand = add_category("sand");
+  checked.soil = add_category("soil");
+  checked.wood = add_category("wood");
+}
+
+void SubstanceLibrary::Impl::check_substance(std::string const& substance_name,
+                                             SubstanceShPtr substance)
+{
+  substance->check_consistency();
 
-    std::string substance_name = substance_iterator->first;
-    SubstanceShPtr substance = substance_iterator->second;
+  // Automatic class setting for certain implied classes.
+  // TODO: This should be made configurable in XML.
+  if (substance->in_category(checked.grass))
+  {
+    substance->add_category(checked.plant);
+  }
+  if (substance->in_category(checked.metal))
+  {
+    substance->add_category(checked.conductor);
+  }
+  if (substance->in_category(checked.sand))
+  {
+    substance->add_category(checked.granular);
+  }
+  if (substance->in_category(checked.soil))
+  {
+    substance->add_category(checked.granular);
+  }
+  if (substance->in_category(checked.wood))
+  {
+    substance->add_category(checked.plant);
+    substance->add_category(checked.fuel);
+  }
 
-    substance->check_consistency();
+  // Consistency checks for substance classes: mutually exclusive classes
+  if (substance->in_category(checked.flat) &&
+      substance->in_category(checked.granular))
+  {
+    MINOR_ERROR("%s is defined as both flat and granular; which are incompatible",
+                substance_name.c_str());
+  }
 
-    // Automatic class setting for certain implied classes.
-    // TODO: This should be made configurable in XML.
-    if (categories["grass"].count(substance_name) != 0)
+  // Consistency checks for substance classes: solids.
+  // TODO: This should be made configurable in XML.
+  if (substance->get_data().phase != Phase::Solid)
+  {
+    if (substance->in_category(checked.flux))
     {
-      categories["plant"].insert(substance_name);
+      MINOR_ERROR("%s is defined as a flux, but is not a solid",
+                  substance_name.c_str());
     }
-    if (categories["metal"].count(substance_name) != 0)
+    if (substance->in_category(checked.gem))
     {
-      categories["conductor"].insert(substance_name);
+      MINOR_ERROR("%s is defined as a gem, but is not a solid",
+                  substance_name.c_str());
     }
-    if (categories["sand"].count(substance_name) != 0)
+    if (substance->in_category(checked.rock))
     {
-      categories["granular"].insert(substance_name);
+      MINOR_ERROR("%s is defined as a rock, but is not a solid",
+                  substance_name.c_str());
     }
-    if (categories["soil"].count(substance_name) != 0)
+    if (substance->in_category(checked.metal) &&
+        (substance->get_data().phase != Phase::Liquid))
     {
-      categories["granular"].insert(substance_name);
+      MINOR_ERROR("%s is defined as a metal, but is not a solid or liquid",
+                  substance_name.c_str());
     }
-    if (categories["wood"].count(substance_name) != 0)
+    if (substance->in_category(checked.sand))
     {
-      categories["plant"].insert(substance_name);
-      categories["fuel"].insert(substance_name);
+      MINOR_ERROR("%s is defined as a type of sand, but is not a solid",
+                  substance_name.c_str());
     }
-
-    // Consistency checks for substance classes: mutually exclusive classes
-    if ((categories["flat"].count(substance_name) != 0) &&
-        (categories["granular"].count(substance_name.c_str()) != 0))
+    if (substance->in_category(checked.soil))
     {
-      MINOR_ERROR("%s is defined as both flat and granular; which are incompatible",
+      MINOR_ERROR("%s is defined as a type of soil, but is not a solid",
                   substance_name.c_str());
     }
-
-    // Consistency checks for substance classes: solids.
-    // TODO: This should be made configurable in XML.
-    if (substance->get_data().phase != Phase::Solid)
+    if (substance->in_category(checked.wood))
     {
-      if (categories["flux"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a flux, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["gem"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a gem, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["rock"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a rock, but is not a solid",
-                    substance_name.c_str());
-      }
-      if ((categories["metal"].count(substance_name) != 0) &&
-          (substance->get_data().phase != Phase::Liquid))
-      {
-        MINOR_ERROR("%s is defined as a metal, but is not a solid or liquid",
-                    substance_name.c_str());
-      }
-      if (categories["sand"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a type of sand, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["soil"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a type of soil, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["wood"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a type of wood, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["plant"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as a type of plant matter, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["granular"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as granular, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["flat"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is defined as flat, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (substance->get_data().hardness != 0)
-      {
-        MINOR_ERROR("%s has a hardness value defined, but is not a solid",
-                    substance_name.c_str());
-      }
-      if (categories["polished"].count(substance_name) != 0)
-      {
-        MINOR_ERROR("%s is marked as polishable, but is not a solid",
-                    substance_name.c_str());
-      }
+      MINOR_ERROR("%s is defined as a type of wood, but is not a solid",
+                  substance_name.c_str());
     }
-    else // if the substance IS a solid...
+    if (substance->in_category(checked.plant))
     {
-
+      MINOR_ERROR("%s is defined as a type of plant matter, but is not a solid",
+                  substance_name.c_str());
     }
-
-    std::string ore_name = substance->get_properties().get("attributes.ore", "");
-    if ((ore_name != "") && (collection.count(ore_name) == 0))
+    if (substance->in_category(checked.granular))
     {
-      MINOR_ERROR("%s is defined as an ore of missing substance %s",
-                  substance_name.c_str(), ore_name.c_str());
+      MINOR_ERROR("%s is defined as granular, but is not a solid",
+                  substance_name.c_str());
     }
-    ore_name = substance->get_properties().get("attributes.secondaryore", "");
-    if ((ore_name != "") && (collection.count(ore_name) == 0))
+    if (substance->in_category(checked.flat))
     {
-      MINOR_ERROR("%s is defined as a secondary ore of missing substance %s",
-                  substance_name.c_str(), ore_name.c_str());
+      MINOR_ERROR("%s is defined as flat, but is not a solid",
+                  substance_name.c_str());
     }
-
-    // Parse "large deposit" designations.
-    try
+    if (substance->get_data().hardness != 0)
     {
-      for (auto v :
-           substance->get_properties().get_child("terrain.largedeposit"))
-      {
-        std::string deposit_name = v.first;
-        if (collection.count(deposit_name) == 0)
-        {
-          MINOR_ERROR("%s has the missing largedeposit substance \"%s\"",
-                      substance_name.c_str(), deposit_name.c_str());
-        }
-        else
-        {
-          collection[deposit_name]->large_deposits.push_back(substance_name);
-        }
-      }
+      MINOR_ERROR("%s has a hardness value defined, but is not a solid",
+                  substance_name.c_str());
     }
-    catch (const boost::property_tree::ptree_bad_path& p)
+    if (substance->in_category(checked.polished))
     {
-      // If the subtree didn't exist, we don't care.
+      MINOR_ERROR("%s is marked as polishable, but is not a solid",
+                  substance_name.c_str());
     }
+  }
+  else // if the substance IS a solid...
+  {
+
+  }
 
-    // Parse "small deposit" designations.
-    try
+  std::string ore_name = substance->get(SubstanceStringProperty::OreOf);
+  if ((ore_name != "") && (collection.count(ore_name) == 0))
+  {
+    MINOR_ERROR("%s is defined as an ore of missing substance %s",
+                substance_name.c_str(), ore_name.c_str());
+  }
+  ore_name = substance->get(SubstanceStringProperty::SecondaryOreOf);
+  if ((ore_name != "") && (collection.count(ore_name) == 0))
+  {
+    MINOR_ERROR("%s is defined as a secondary ore of missing substance %s",
+                substance_name.c_str(), ore_name.c_str());
+  }
+
+  // Parse "large deposit" designations.
+  try
+  {
+    for (auto v :
+         substance->get_properties().get_child("terrain.largedeposit"))
     {
-      for (auto v :
-           substance->get_properties().get_child("terrain.smalldeposit"))
+      std::string deposit_name = v.first;
+      if (collection.count(deposit_name) == 0)
       {
-        std::string deposit_name = v.first;
-        if (collection.count(deposit_name) == 0)
-        {
-          MINOR_ERROR("%s has the missing smalldeposit substance \"%s\"",
-                      substance_name.c_str(), deposit_name.c_str());
-        }
-        else
-        {
-          collection[deposit_name]->small_deposits.push_back(substance_name);
-        }
+        MINOR_ERROR("%s has the missing largedeposit substance \"%s\"",
+                    substance_name.c_str(), deposit_name.c_str());
+      }
+      else
+      {
+        collection[deposit_name]->large_deposits.push_back(substance_name);
       }
     }
-    catch (const boost::property_tree::ptree_bad_path& p)
-    {
-      // If the subtree didn't exist, we don't care.
-    }
+  }
+  catch (const boost::property_tree::ptree_bad_path& p)
+  {
+    // If the subtree didn't exist, we don't care.
+  }
 
-    // Parse "vein" designations.
-    try
+  // Parse "small deposit" designations.
+  try
+  {
+    for (auto v :
+         substance->get_properties().get_child("terrain.smalldeposit"))
     {
-      for (auto v :
-           substance->get_properties().get_child("terrain.vein"))
+      std::string deposit_name = v.first;
+      if (collection.count(deposit_name) == 0)
       {
-        std::string deposit_name = v.first;
-        if (collection.count(deposit_name) == 0)
-        {
-          MINOR_ERROR("%s has the missing vein substance \"%s\"",
-                      substance_name.c_str(), deposit_name.c_str());
-        }
-        else
-        {
-          collection[deposit_name]->vein_deposits.push_back(substance_name);
-        }
+        MINOR_ERROR("%s has the missing smalldeposit substance \"%s\"",
+                    substance_name.c_str(), deposit_name.c_str());
+      }
+      else
+      {
+        collection[deposit_name]->small_deposits.push_back(substance_name);
       }
     }
-    catch (const boost::property_tree::ptree_bad_path& p)
-    {
-      // If the subtree didn't exist, we don't care.
-    }
+  }
+  catch (const boost::property_tree::ptree_bad_path& p)
+  {
+    // If the subtree didn't exist, we don't care.
+  }
 
-    // Parse "gangue" designations.
-    try
+  // Parse "vein" designations.
+  try
+  {
+    for (auto v :
+         substance->get_properties().get_child("terrain.vein"))
     {
-      for (auto v :
-           substance->get_properties().get_child("terrain.gangue"))
+      std::string deposit_name = v.first;
+      if (collection.count(deposit_name) == 0)
       {
-        std::string deposit_name = v.first;
-        if (collection.count(deposit_name) == 0)
-        {
-          MINOR_ERROR("%s has the missing gangue substance \"%s\"",
-                      substance_name.c_str(), deposit_name.c_str());
-        }
-        else
-        {
-          collection[deposit_name]->gangue_deposits.push_back(substance_name);
-        }
+        MINOR_ERROR("%s has the missing vein substance \"%s\"",
+                    substance_name.c_str(), deposit_name.c_str());
+      }
+      else
+      {
+        collection[deposit_name]->vein_deposits.push_back(substance_name);
       }
     }
-    catch (const boost::property_tree::ptree_bad_path& p)
+  }
+  catch (const boost::property_tree::ptree_bad_path& p)
+  {
+    // If the subtree didn't exist, we don't care.
+  }
+
+  // Parse "gangue" designations.
+  try
+  {
+    for (auto v :
+         substance->get_properties().get_child("terrain.gangue"))
     {
-      // If the subtree didn't exist, we don't care.
+      std::string deposit_name = v.first;
+      if (collection.count(deposit_name) == 0)
+      {
+        MINOR_ERROR("%s has the missing gangue substance \"%s\"",
+                    substance_name.c_str(), deposit_name.c_str());
+      }
+      else
+      {
+        collection[deposit_name]->gangue_deposits.push_back(substance_name);
+      }
     }
+  }
+  catch (const boost::property_tree::ptree_bad_path& p)
+  {
+    // If the subtree didn't exist, we don't care.
+  }
 
-    // Parse "single" designations.
-    try
+  // Parse "single" designations.
+  try
+  {
+    for (auto v :
+         substance->get_properties().get_child("terrain.single"))
     {
-      for (auto v :
-           substance->get_properties().get_child("terrain.single"))
+      std::string deposit_name = v.first;
+      if (collection.count(deposit_name) == 0)
       {
-        std::string deposit_name = v.first;
-        if (collection.count(deposit_name) == 0)
-        {
-          MINOR_ERROR("%s has the missing single substance \"%s\"",
-                      substance_name.c_str(), deposit_name.c_str());
-        }
-        else
-        {
-          collection[deposit_name]->single_deposits.push_back(substance_name);
-        }
+        MINOR_ERROR("%s has the missing single substance \"%s\"",
+                    substance_name.c_str(), deposit_name.c_str());
+      }
+      else
+      {
+        collection[deposit_name]->single_deposits.push_back(substance_name);
       }
     }
-    catch (const boost::property_tree::ptree_bad_path& p)
+  }
+  catch (const boost::property_tree::ptree_bad_path& p)
+  {
+    // If the subtree didn't exist, we don't care.
+  }
+}
+
+void SubstanceLibrary::Impl::remove_deposits(std::string const& substance_name)
+{
+  for (auto& entry : collection)
+  {
+    for (StringVector* list : { &(entry.second->large_deposits),
+                                &(entry.second->small_deposits),
+                                &(entry.second->vein_deposits),
+                                &(entry.second->gangue_deposits),
+                                &(entry.second->single_deposits) })
     {
-      // If the subtree didn't exist, we don't care.
+      list->erase(std::remove(list->begin(), list->end(), substance_name),
+                  list->end());
     }
   }
-  std::cout << "*** Done parsing descriptors:  " << std::endl;
-  std::cout << "***   " << collection.size() << " substances parsed"
-            << std::endl;
-  std::cout << "***   " << categories.size()
-            << " distinct substance attributes counted" << std::endl;
+}
+
+void SubstanceLibrary::Impl::remove_layers_and_verbs(std::string const& substance_name)
+{
+  for (auto& layer : layers)
+  {
+    StringVector& names = layer.second;
+    names.erase(std::remove(names.begin(), names.end(), substance_name),
+                names.end());
+  }
+
+  for (auto& verb : verbs)
+  {
+    verb.second.erase(substance_name);
+  }
+}
+
+void SubstanceLibrary::Impl::assign_ids(void)
+{
+  StringVector names;
+  for (auto& entry : collection)
+  {
+    names.push_back(entry.first);
+  }
+
+  // Sort by name so IDs don't depend on directory or hash ordering.
+  std::sort(names.begin(), names.end());
+
+  if (names.size() >= SUBSTANCEID_NULL)
+  {
+    FATAL_ERROR("Too many substances (%u) to assign IDs to",
+                (unsigned int) names.size());
+  }
+
+  substances_by_id.clear();
+  names_by_id.clear();
+  ids.clear();
+
+  for (std::string const& name : names)
+  {
+    SubstanceID id = (SubstanceID) substances_by_id.size();
+    collection[name]->set_id(id);
+    substances_by_id.push_back(collection[name]);
+    names_by_id.push_back(name);
+    ids[name] = id;
+  }
+
+  nothing_id = ids["nothing"];
+}
+
+CategoryID SubstanceLibrary::Impl::add_category(std::string const& name)
+{
+  auto iter = category_ids.find(name);
+  if (iter != category_ids.end())
+  {
+    return iter->second;
+  }
+
+  if (category_names.size() >= CATEGORYID_NULL)
+  {
+    FATAL_ERROR("Too many substance categories (%u) to assign IDs to",
+                (unsigned int) category_names.size());
+  }
+
+  CategoryID id = (CategoryID) category_names.size();
+  category_names.push_back(name);
+  category_ids[name] = id;
+  return id;
+}
+
+void SubstanceLibrary::Impl::finish_categories(void)
+{
+  category_column.clear();
+
+  for (SubstanceShPtr const& substance : substances_by_id)
+  {
+    substance->resize_categories(category_names.size());
+    category_column.push_back(substance->get_categories());
+  }
 }
 
 SubstanceLibrary::SubstanceLibrary() :
@@ -394,6 +641,8 @@ std::shared_ptr<SubstanceLibrary> SubstanceLibrary::get_instance()
 
 void SubstanceLibrary::initialize()
 {
+  ProfileTimer timer("Substance library initialization");
+
   std::cout << "Scanning substances directory for descriptor files..."
             << std::endl;
 
@@ -429,19 +678,7 @@ void SubstanceLibrary::initialize()
       if (names.size() != 0)
       {
         // Attempt to load data for each file seen.
-        for (StringIterator iter = names.begin(); iter != names.end(); ++iter)
-        {
-          std::string tag = *iter;
-          if (Settings::debugShowVerboseInfo)
-          {
-            std::cout << "Parsing substance " << tag << "." << std::endl;
-          }
-          impl->collection[tag].reset(new Substance());
-          impl->collection[tag]->load(tag);
-          impl->populate_layers(impl->collection[tag]);
-          impl->populate_categories(impl->collection[tag]);
-          impl->populate_verbs(impl->collection[tag]);
-        }
+        impl->load_substances(names, false);
       }
       else
       {
@@ -458,27 +695,28 @@ void SubstanceLibrary::initialize()
     FATAL_ERROR("Substances directory \"data/substances\" does not exist");
   }
 
-  // If "nothing" and/or "air" do not exist, create them.  These two Materials
-  // must exist for world generation to work properly.
+  // If "nothing" and/or "air" do not exist, create them, with default
+  // properties if need be.  These two Materials must exist for world
+  // generation to work properly.
+  StringVector missing;
   if (impl->collection.count("nothing") == 0)
   {
-    impl->collection["nothing"].reset(new Substance());
-    impl->collection["nothing"]->load("nothing");
-    impl->populate_layers(impl->collection["nothing"]);
-    impl->populate_categories(impl->collection["nothing"]);
-    impl->populate_verbs(impl->collection["nothing"]);
+    missing.push_back("nothing");
   }
 
   if (impl->collection.count("air") == 0)
   {
-    impl->collection["air"].reset(new Substance());
-    impl->collection["air"]->load("air");
-    impl->populate_layers(impl->collection["air"]);
-    impl->populate_categories(impl->collection["air"]);
-    impl->populate_verbs(impl->collection["air"]);
+    missing.push_back("air");
+  }
+
+  if (!missing.empty())
+  {
+    impl->load_substances(missing, true);
   }
 
   impl->check_substances();
+  impl->assign_ids();
+  impl->finish_categories();
 }
 
 SubstanceConstShPtr SubstanceLibrary::get(std::string name)
@@ -498,6 +736,53 @@ SubstanceConstShPtr SubstanceLibrary::get(std::string name)
   }
 }
 
+SubstanceConstShPtr SubstanceLibrary::get(SubstanceID id)
+{
+  if (id < impl->substances_by_id.size())
+  {
+    return impl->substances_by_id[id];
+  }
+  else
+  {
+    return impl->substances_by_id[impl->nothing_id];
+  }
+}
+
+SubstanceID SubstanceLibrary::get_id(std::string name)
+{
+  auto iter = impl->ids.find(name);
+  if (iter != impl->ids.end())
+  {
+    return iter->second;
+  }
+  else
+  {
+    if (Settings::debugShowVerboseInfo)
+    {
+      std::cout << "Unable to find substance \"" << name
+                << "\", returning nothing" << std::endl;
+    }
+    return impl->nothing_id;
+  }
+}
+
+std::string const& SubstanceLibrary::get_name(SubstanceID id)
+{
+  if (id < impl->names_by_id.size())
+  {
+    return impl->names_by_id[id];
+  }
+  else
+  {
+    return impl->names_by_id[impl->nothing_id];
+  }
+}
+
+unsigned int SubstanceLibrary::get_substance_count()
+{
+  return impl->substances_by_id.size();
+}
+
 unsigned int SubstanceLibrary::get_layer_substance_count(std::string name)
 {
   return (impl->layers[name]).size();
@@ -511,12 +796,220 @@ std::string SubstanceLibrary::get_layer_random_substance(std::string name)
 
 bool SubstanceLibrary::in_category(std::string name, std::string category)
 {
-  if (impl->collection.count(name) != 0)
+  auto substance_iter = impl->ids.find(name);
+  auto category_iter = impl->category_ids.find(category);
+
+  if ((substance_iter != impl->ids.end()) &&
+      (category_iter != impl->category_ids.end()))
   {
-    return (impl->categories[category].count(name) != 0);
+    return in_category(substance_iter->second, category_iter->second);
   }
   else
   {
     return false;
   }
 }
+
+bool SubstanceLibrary::in_category(SubstanceID id, CategoryID category)
+{
+  return (id < impl->category_column.size()) &&
+         (category < impl->category_names.size()) &&
+         impl->category_column[id][category];
+}
+
+CategoryID SubstanceLibrary::get_category_id(std::string name)
+{
+  auto iter = impl->category_ids.find(name);
+  if (iter != impl->category_ids.end())
+  {
+    return iter->second;
+  }
+  else
+  {
+    return CATEGORYID_NULL;
+  }
+}
+
+std::string const& SubstanceLibrary::get_category_name(CategoryID id)
+{
+  static std::string const none = "";
+
+  if (id < impl->category_names.size())
+  {
+    return impl->category_names[id];
+  }
+  else
+  {
+    return none;
+  }
+}
+
+unsigned int SubstanceLibrary::get_category_count()
+{
+  return impl->category_names.size();
+}
+
+std::vector<SubstanceID> SubstanceLibrary::get_substances_in(
+  CategorySet const& categories)
+{
+  std::vector<SubstanceID> result;
+
+  if (categories.size() != impl->category_names.size())
+  {
+    MINOR_ERROR("Category set has %u bits, but there are %u categories",
+                (unsigned int) categories.size(),
+                (unsigned int) impl->category_names.size());
+    return result;
+  }
+
+  for (SubstanceID id = 0; id < impl->category_column.size(); ++id)
+  {
+    if (categories.is_subset_of(impl->category_column[id]))
+    {
+      result.push_back(id);
+    }
+  }
+
+  return result;
+}
+
+std::vector<SubstanceID> SubstanceLibrary::get_substances_in(
+  std::vector<std::string> const& categories)
+{
+  CategorySet set(impl->category_names.size());
+
+  for (std::string const& name : categories)
+  {
+    auto iter = impl->category_ids.find(name);
+    if (iter == impl->category_ids.end())
+    {
+      // Nothing is in a category nobody has heard of.
+      return std::vector<SubstanceID>();
+    }
+    set.set(iter->second);
+  }
+
+  return get_substances_in(set);
+}
+
+std::vector<SubstanceID> SubstanceLibrary::reload(
+  std::vector<std::string> const& names)
+{
+  std::vector<SubstanceID> reloaded;
+  StringVector known;
+
+  for (std::string const& name : names)
+  {
+    if (impl->collection.count(name) == 0)
+    {
+      MINOR_ERROR("Substance \"%s\" is new; restart to load it",
+                  name.c_str());
+    }
+    else if (!boost::filesystem::exists(Path("data/substances") /
+                                        (name + ".xml")))
+    {
+      MINOR_ERROR("Substance \"%s\" has been deleted; restart to unload it",
+                  name.c_str());
+    }
+    else
+    {
+      known.push_back(name);
+    }
+  }
+
+  std::sort(known.begin(), known.end());
+  known.erase(std::unique(known.begin(), known.end()), known.end());
+
+  if (known.empty())
+  {
+    return reloaded;
+  }
+
+  std::vector<SubstanceShPtr> loaded(known.size());
+  std::vector<char> parsed(known.size());
+
+  {
+    ProfileTimer timer("Reloading " + std::to_string(known.size()) +
+                       " substance descriptors");
+
+    App::instance().get_jobs().parallel_for(known.size(), 4,
+        [&](unsigned int first, unsigned int last)
+    {
+      for (unsigned int index = first; index < last; ++index)
+      {
+        loaded[index].reset(new Substance());
+        parsed[index] = loaded[index]->parse(known[index]);
+      }
+    });
+  }
+
+  // A file that doesn't parse is most likely still being edited, so the old
+  // substance is kept until it is saved again.
+  for (unsigned int index = 0; index < known.size(); ++index)
+  {
+    loaded[index]->report_errors();
+    if (parsed[index])
+    {
+      loaded[index]->finish_load();
+    }
+  }
+
+  boost::mutex::scoped_lock lock(impl->reload_mutex);
+
+  unsigned int category_count = impl->category_names.size();
+
+  for (unsigned int index = 0; index < known.size(); ++index)
+  {
+    if (!parsed[index])
+    {
+      continue;
+    }
+
+    std::string const& name = known[index];
+    SubstanceShPtr substance = loaded[index];
+    SubstanceShPtr old_substance = impl->collection[name];
+    SubstanceID id = impl->ids[name];
+
+    substance->set_id(id);
+
+    // Deposit lists are filled in from other substances' descriptors.
+    substance->large_deposits = old_substance->large_deposits;
+    substance->small_deposits = old_substance->small_deposits;
+    substance->vein_deposits = old_substance->vein_deposits;
+    substance->gangue_deposits = old_substance->gangue_deposits;
+    substance->single_deposits = old_substance->single_deposits;
+
+    impl->collection[name] = substance;
+    impl->substances_by_id[id] = substance;
+
+    impl->remove_layers_and_verbs(name);
+    impl->remove_deposits(name);
+    impl->populate_layers(substance);
+    impl->populate_categories(substance);
+    impl->populate_verbs(substance);
+    impl->check_substance(name, substance);
+
+    reloaded.push_back(id);
+  }
+
+  if (impl->category_names.size() != category_count)
+  {
+    // New categories turned up, so every set needs more bits.
+    impl->finish_categories();
+  }
+  else
+  {
+    for (SubstanceID id : reloaded)
+    {
+      impl->substances_by_id[id]->resize_categories(category_count);
+      impl->category_column[id] = impl->substances_by_id[id]->get_categories();
+    }
+  }
+
+  return reloaded;
+}
+
+boost::mutex& SubstanceLibrary::get_reload_mutex()
+{
+  return impl->reload_mutex;
+}
@@ -0,0 +1,162 @@
+#include "TextLayout.h"
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+#include "TextureFont.h"
+
+TextLayout::TextLayout(TextureFont& font,
+                       float wrap_width,
+                       std::u32string const& text)
+{
+  glm::vec2 next_char_coords = glm::vec2(0.0f);
+  float line_height = font.getLineHeight();
+
+  quads.reserve(text.size());
+
+  for (char32_t character : text)
+  {
+    Quad quad;
+    quad.position = next_char_coords;
+    quad.size = font.getGlyphSize(character);
+    quad.texture_coords = font.getTextureCoordinates(character);
+    quad.outline_texture_coords = font.getOutlineTextureCoordinates(character);
+    quads.push_back(quad);
+
+    float advance = font.getXAdvance(character);
+
+    if (next_char_coords.x + advance > wrap_width)
+    {
+      next_char_coords.x = 0;
+      next_char_coords.y += line_height;
+    }
+    else
+    {
+      next_char_coords.x += advance;
+    }
+  }
+}
+
+struct TextLayoutCache::Impl
+{
+  /// What a layout depends on.
+  struct Key
+  {
+    TextureFont const* font;
+    float wrap_width;
+    std::u32string text;
+
+    bool operator==(Key const& other) const
+    {
+      return (font == other.font) && (wrap_width == other.wrap_width) &&
+             (text == other.text);
+    }
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(Key const& key) const
+    {
+      size_t hash = std::hash<std::u32string>()(key.text);
+      hash ^= std::hash<void const*>()(key.font) + 0x9e3779b9 +
+              (hash << 6) + (hash >> 2);
+      hash ^= std::hash<float>()(key.wrap_width) + 0x9e3779b9 +
+              (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  typedef std::pair<Key, std::shared_ptr<TextLayout const> > Entry;
+  typedef std::list<Entry> EntryList;
+
+  /// Most recently used first.
+  EntryList entries;
+
+  /// Index into entries.
+  std::unordered_map<Key, EntryList::iterator, KeyHash> index;
+
+  /// Protects everything above.
+  boost::mutex mutex;
+
+  unsigned int capacity;
+  unsigned int hit_count;
+  unsigned int miss_count;
+};
+
+TextLayoutCache::TextLayoutCache(unsigned int capacity)
+  : impl(new Impl())
+{
+  impl->capacity = std::max(1u, capacity);
+  impl->hit_count = 0;
+  impl->miss_count = 0;
+}
+
+TextLayoutCache::~TextLayoutCache()
+{
+}
+
+std::shared_ptr<TextLayout const> TextLayoutCache::get(
+  TextureFont& font,
+  float wrap_width,
+  std::u32string const& text)
+{
+  Impl::Key key = { &font, wrap_width, text };
+
+  boost::mutex::scoped_lock lock(impl->mutex);
+
+  auto iter = impl->index.find(key);
+  if (iter != impl->index.end())
+  {
+    // Move it to the front.
+    impl->entries.splice(impl->entries.begin(), impl->entries, iter->second);
+    ++(impl->hit_count);
+    return iter->second->second;
+  }
+
+  ++(impl->miss_count);
+
+  std::shared_ptr<TextLayout const> layout(
+    new TextLayout(font, wrap_width, text));
+
+  impl->entries.push_front(Impl::Entry(key, layout));
+  impl->index[key] = impl->entries.begin();
+
+  if (impl->entries.size() > impl->capacity)
+  {
+    impl->index.erase(impl->entries.back().first);
+    impl->entries.pop_back();
+  }
+
+  return layout;
+}
+
+void TextLayoutCache::forget(TextureFont& font)
+{
+  boost::mutex::scoped_lock lock(impl->mutex);
+
+  for (auto iter = impl->entries.begin(); iter != impl->entries.end(); )
+  {
+    if (iter->first.font == &font)
+    {
+      impl->index.erase(iter->first);
+      iter = impl->entries.erase(iter);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+}
+
+unsigned int TextLayoutCache::get_hit_count() const
+{
+  return impl->hit_count;
+}
+
+unsigned int TextLayoutCache::get_miss_count() const
+{
+  return impl->miss_count;
+}
@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <iostream>
 
 #include "TextureAtlas.h"
 
+#include "AtlasBuilder.h"
 #include "ErrorMacros.h"
+#include "ProfileTimer.h"
 #include "Settings.h"
 
 std::unique_ptr<TextureAtlas> TextureAtlas::instance_;
@@ -18,134 +21,124 @@ TextureAtlas* TextureAtlas::instance()
 }
 
 TextureAtlas::TextureAtlas()
+  : dirty(true), nextSerialNumber(0)
 {
   unsigned int maximumSize = sf::Texture::getMaximumSize();
   std::cout << "Maximum size for textures on this computer is " << maximumSize
             << " pixels." << std::endl;
-  std::cout << "Block size for this texture atlas is " << (1 << blockSize)
-            << " pixels." << std::endl;
-
-  atlas.create(maximumSize, maximumSize);
-  maxBlocks = maximumSize >> blockSize;
-  used.resize(maxBlocks * maxBlocks, false);
 
-  // Mark block (0, 0) as used, and create an area of {255,255,255,255} so
-  // we have a "blank" texture.
-  sf::Image blankImage;
-  blankImage.create((1 << blockSize), (1 << blockSize), sf::Color::White);
-  save(blankImage);
-}
+  unsigned int width = std::min(atlasWidth, maximumSize);
+  builder.reset(new AtlasBuilder(width, maximumSize));
 
-SerialNumber TextureAtlas::save(sf::Image& image)
-{
-  sf::Vector2u divided
-  { image.getSize().x >> blockSize, image.getSize().y >> blockSize };
-  sf::Vector2u remaining
+  // Every baked atlas has the blank texture in it, under the name "blank".
+  sf::IntRect blankRect;
+  if (builder->load("data/atlas.png", "data/atlas.xml") &&
+      builder->find("blank", blankRect))
   {
-    image.getSize().x& ((1 << blockSize) - 1), image.getSize().y
-    & ((1 << blockSize) - 1)
-  };
-  sf::Vector2u imageBlocks
+    std::cout << "Loaded baked texture atlas holding "
+              << builder->get_image_count() << " images." << std::endl;
+    texRect[nextSerialNumber] = blankRect;
+    ++nextSerialNumber;
+  }
+  else
   {
-    divided.x + ((remaining.x != 0) ? 1 : 0), divided.y
-    + ((remaining.y != 0) ? 1 : 0)
-  };
+    builder.reset(new AtlasBuilder(width, maximumSize));
 
-  bool suitable = true;
-  sf::Vector2u origin
-  { 0, 0 };
+    // Create an area of {255,255,255,255} so we have a "blank" texture.
+    sf::Image blankImage;
+    blankImage.create(blankSize, blankSize, sf::Color::White);
+    save(blankImage, "blank");
+  }
+}
 
-  SerialNumber serialNumber = nextSerialNumber;
+TextureAtlas::~TextureAtlas()
+{
+}
 
-  suitable = findNextSpot(origin, imageBlocks);
+SerialNumber TextureAtlas::save(sf::Image& image, std::string const& name)
+{
+  boost::mutex::scoped_lock lock(mutex);
 
-  if (suitable == false)
+  sf::IntRect info;
+  sf::IntRect old_info;
+  bool reloading = !name.empty() && builder->find_any_version(name, old_info);
+
+  if (reloading && builder->replace(image, name, info))
   {
-    FATAL_ERROR("No room left in texture atlas to store an image");
+    // A changed image the same size as before goes back where it was, so
+    // reloading it doesn't take up any more of the atlas.
   }
+  else if (!builder->add(image, name, info))
+  {
+    if (!reloading)
+    {
+      FATAL_ERROR("No room left in texture atlas to store an image");
+    }
 
-  // At this point, xOrigin/yOrigin is a suitable block to store the image.
-  atlas.update(image, origin.x << blockSize, origin.y << blockSize);
+    MAJOR_ERROR("No room left in texture atlas to reload \"%s\"; keeping the old image",
+                name.c_str());
+    info = old_info;
+  }
 
   // Save texture information and add it to our set.
-  sf::IntRect info;
-  info.left = origin.x << blockSize;
-  info.top = origin.y << blockSize;
-  info.width = image.getSize().x;
-  info.height = image.getSize().y;
+  SerialNumber serialNumber = nextSerialNumber;
   texRect[serialNumber] = info;
   ++nextSerialNumber;
-
-  reserveSpot(origin, imageBlocks);
+  dirty = true;
 
   return serialNumber;
 }
 
-bool TextureAtlas::findNextSpot(sf::Vector2u& origin,
-                                sf::Vector2u const& imageBlocks)
+bool TextureAtlas::hasBaked(std::string const& name)
 {
-  bool suitable = false;
-
-  // NOTE: This is super-duper inefficient.
-  //       I am sure this algorithm's speed could be greatly improved; for now this works.
-  for (origin.y = 0; origin.y < maxBlocks; ++origin.y)
-  {
-    for (origin.x = 0; origin.x < maxBlocks; ++origin.x)
-    {
-      // Start by assuming the origin block is suitable.
-      suitable = true;
-
-      // Now check the spots left of and below the origin to see if there's room.
-      for (unsigned int yCheck = origin.y; yCheck < origin.y + imageBlocks.y;
-           ++yCheck)
-      {
-        for (unsigned xCheck = origin.x; xCheck < origin.x + imageBlocks.x;
-             ++xCheck)
-        {
-          if (used[get_block(xCheck, yCheck)])
-          {
-            suitable = false;
-            break;
-          }
-        }
-        if (suitable == false)
-        {
-          break;
-        }
-      }
-      if (suitable == true)
-      {
-        break;
-      }
-    }
-    if (suitable == true)
-    {
-      break;
-    }
-  }
-  return suitable;
+  sf::IntRect info;
+  return builder->find(name, info);
 }
 
-void TextureAtlas::reserveSpot(const sf::Vector2u& origin,
-                               const sf::Vector2u& imageBlocks)
+SerialNumber TextureAtlas::useBaked(std::string const& name)
 {
-  for (unsigned int yBlocks = origin.y; yBlocks < origin.y + imageBlocks.y;
-       ++yBlocks)
+  boost::mutex::scoped_lock lock(mutex);
+
+  sf::IntRect info;
+  if (!builder->find(name, info))
   {
-    for (unsigned int xBlocks = origin.x; xBlocks < origin.x + imageBlocks.x;
-         ++xBlocks)
-    {
-      used[get_block(xBlocks, yBlocks)] = true;
-    }
+    MAJOR_ERROR("\"%s\" is not in the baked texture atlas", name.c_str());
+    return BLANK;
   }
+
+  SerialNumber serialNumber = nextSerialNumber;
+  texRect[serialNumber] = info;
+  ++nextSerialNumber;
+
+  return serialNumber;
 }
 
 const sf::IntRect& TextureAtlas::getRect(SerialNumber texNumber)
 {
+  boost::mutex::scoped_lock lock(mutex);
   return texRect[texNumber];
 }
 
 const sf::Texture* TextureAtlas::getAtlasTexture(void)
 {
+  boost::mutex::scoped_lock lock(mutex);
+
+  if (dirty)
+  {
+    ProfileTimer timer;
+    atlas.loadFromImage(builder->get_image());
+    dirty = false;
+
+    if (Settings::debugProfile)
+    {
+      std::cout << "PROFILE: Texture atlas: " << builder->get_image_count()
+                << " images in " << builder->get_width() << "x"
+                << builder->get_used_height() << " pixels ("
+                << (int) (builder->get_efficiency() * 100) << "% covered), "
+                << builder->get_packing_ms() << " ms packing, "
+                << timer.get_elapsed_ms() << " ms uploading" << std::endl;
+    }
+  }
+
   return &atlas;
 }
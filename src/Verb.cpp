@@ -6,6 +6,7 @@
 // *** END ***
 #include "Verb.h"
 
+#include "DescriptorDatabase.h"
 #include "ErrorMacros.h"
 #include "Settings.h"
 
@@ -21,7 +22,8 @@ void Verb::initialize()
   // Try to open the verb descriptor file and load its property tree.
   try
   {
-    read_xml("data/verbs.xml", properties);
+    DescriptorDatabase::instance()->read(DescriptorDatabase::Section::Verbs,
+                                         "verbs", properties);
   }
   catch (std::exception& e)
   {
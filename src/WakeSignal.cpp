@@ -0,0 +1,53 @@
+#include "WakeSignal.h"
+
+#include <boost/chrono.hpp>
+
+WakeSignal::WakeSignal()
+  : pending_(false)
+{
+}
+
+WakeSignal::~WakeSignal()
+{
+}
+
+void WakeSignal::notify()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    pending_ = true;
+  }
+  condition_.notify_all();
+}
+
+bool WakeSignal::wait(double timeout_ms)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if (timeout_ms < 0)
+  {
+    while (!pending_)
+    {
+      condition_.wait(lock);
+    }
+  }
+  else
+  {
+    boost::chrono::steady_clock::time_point deadline =
+      boost::chrono::steady_clock::now() +
+      boost::chrono::duration_cast<boost::chrono::steady_clock::duration>(
+        boost::chrono::duration<double, boost::milli>(timeout_ms));
+
+    while (!pending_)
+    {
+      if (condition_.wait_until(lock, deadline) == boost::cv_status::timeout)
+      {
+        break;
+      }
+    }
+  }
+
+  bool notified = pending_;
+  pending_ = false;
+  return notified;
+}
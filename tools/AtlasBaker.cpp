@@ -0,0 +1,130 @@
+/// Offline tool that packs every image under sprites/ into a baked texture
+/// atlas (data/atlas.png plus data/atlas.xml) for the game to load in one go
+/// at startup.  Needs no graphics card.
+/// Usage: AtlasBaker [sprites directory] [data directory] [atlas width]
+/// Run it from the project directory; the defaults match what the game
+/// expects.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "AtlasBuilder.h"
+#include "ProfileTimer.h"
+
+/// Largest atlas height to allow.  Graphics cards that can't take a texture
+/// this tall will ignore the baked atlas and pack images at startup.
+static unsigned int const max_height = 8192;
+
+/// An image waiting to be packed.
+struct Sprite
+{
+  std::string name;
+  sf::Image image;
+};
+
+int main(int argc, char** argv)
+{
+  std::string sprites_path = (argc > 1) ? argv[1] : "sprites";
+  std::string data_path = (argc > 2) ? argv[2] : "data";
+  unsigned int width = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 2048;
+
+  ProfileTimer timer;
+  std::vector<Sprite> sprites;
+
+  // The game expects a blank white texture called "blank".
+  sprites.push_back(Sprite());
+  sprites.back().name = "blank";
+  sprites.back().image.create(16, 16, sf::Color::White);
+
+  if (boost::filesystem::is_directory(sprites_path))
+  {
+    for (boost::filesystem::directory_iterator iter(sprites_path);
+         iter != boost::filesystem::directory_iterator(); ++iter)
+    {
+      std::string extension = iter->path().extension().generic_string();
+      if (!boost::filesystem::is_regular_file(iter->path()) ||
+          ((extension != ".tga") && (extension != ".png")))
+      {
+        continue;
+      }
+
+      // Images are filed under the path the game will ask for them by.
+      Sprite sprite;
+      sprite.name = sprites_path + "/" +
+                    iter->path().filename().generic_string();
+      if (!sprite.image.loadFromFile(iter->path().generic_string()))
+      {
+        std::cout << "Can't read " << sprite.name << ", skipping it."
+                  << std::endl;
+        continue;
+      }
+      sprites.push_back(sprite);
+    }
+  }
+  else
+  {
+    std::cout << "No \"" << sprites_path << "\" directory; baking only the "
+              << "blank texture." << std::endl;
+  }
+
+  double reading_ms = timer.get_elapsed_ms();
+
+  // Offline, the images can be packed tallest first, which packs much more
+  // tightly than the order the game finds them in.
+  std::sort(sprites.begin(), sprites.end(),
+            [](Sprite const& a, Sprite const& b)
+  {
+    if (a.image.getSize().y != b.image.getSize().y)
+    {
+      return a.image.getSize().y > b.image.getSize().y;
+    }
+    if (a.image.getSize().x != b.image.getSize().x)
+    {
+      return a.image.getSize().x > b.image.getSize().x;
+    }
+    return a.name < b.name;
+  });
+
+  AtlasBuilder builder(width, max_height);
+  for (Sprite const& sprite : sprites)
+  {
+    sf::IntRect rect;
+    if (!builder.add(sprite.image, sprite.name, rect))
+    {
+      std::cout << "No room left in a " << width << "x" << max_height
+                << " atlas for " << sprite.name << "." << std::endl;
+      return 1;
+    }
+  }
+
+  std::string image_path = data_path + "/atlas.png";
+  std::string table_path = data_path + "/atlas.xml";
+
+  if (!builder.bake(image_path, table_path))
+  {
+    std::cout << "Texture atlas was not written." << std::endl;
+    return 1;
+  }
+
+  std::cout << "Baked " << builder.get_image_count() << " images into a "
+            << builder.get_width() << "x" << builder.get_used_height()
+            << " atlas (" << (int) (builder.get_efficiency() * 100)
+            << "% covered)." << std::endl;
+  std::cout << "Reading took " << reading_ms << " ms, packing took "
+            << builder.get_packing_ms() << " ms." << std::endl;
+
+  // Make sure the game will accept what was just written.
+  AtlasBuilder check(width, max_height);
+  if (!check.load(image_path, table_path))
+  {
+    std::cout << "Texture atlas failed to load back." << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
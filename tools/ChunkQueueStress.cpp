@@ -0,0 +1,195 @@
+/// Stress test for the dirty/queued handshake between the thread that edits
+/// chunks and the renderer that re-meshes them.
+///
+/// Writer threads hammer chunks the way StageChunk::set_render_data_dirty()
+/// and StageRenderer3D::handle_chunk_dirty() do: bump a version number (the
+/// "edit"), mark the chunk dirty, and if that made it dirty, queue it unless
+/// it is already queued.  Meanwhile a renderer thread drains the queue the
+/// way StageRenderer3D::draw() does: pop a batch, take every chunk in it off
+/// the queue, then snapshot each chunk's version (the "mesh").
+///
+/// Once the writers stop and the queue is drained, every chunk must be clean
+/// and its last snapshot must match its last edit; if an update was lost, a
+/// chunk is left with an edit that was never re-meshed.
+///
+/// Usage: ChunkQueueStress [seconds [writer_count]]
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "BoundedMPMCQueue.h"
+#include "ChunkRenderState.h"
+
+namespace
+{
+  /// Number of chunks; small, so that writers and the renderer collide a lot.
+  unsigned int const chunk_count = 64;
+
+  /// Largest batch the renderer takes in one go.
+  unsigned int const max_chunks_per_frame = 8;
+
+  struct Chunk
+  {
+    ChunkRenderState state;
+
+    /// Bumped by every edit.
+    std::atomic<unsigned int> version;
+
+    /// Version seen by the last snapshot.
+    unsigned int meshed_version;
+
+    /// Set while the chunk is in the renderer's current batch.
+    bool in_batch;
+  };
+
+  std::unique_ptr<Chunk[]> chunks;
+  std::unique_ptr<BoundedMPMCQueue<Chunk*> > stale_chunks;
+  std::atomic<bool> writers_done;
+  unsigned int duplicate_count = 0;
+  unsigned long long batch_count = 0;
+
+  void queue_chunk(Chunk& chunk)
+  {
+    if (chunk.state.try_mark_queued())
+    {
+      if (!stale_chunks->push(&chunk))
+      {
+        chunk.state.clear_queued();
+      }
+    }
+  }
+
+  void write(unsigned int seed)
+  {
+    unsigned int random = seed;
+    unsigned long long edits = 0;
+
+    while (!writers_done)
+    {
+      random = (random * 1103515245) + 12345;
+      Chunk& chunk = chunks[(random >> 16) % chunk_count];
+
+      ++(chunk.version);
+      if (chunk.state.set_dirty())
+      {
+        queue_chunk(chunk);
+      }
+      ++edits;
+    }
+
+    std::cout << "  Writer " << seed << ": " << edits << " edits" << std::endl;
+  }
+
+  /// Drain one batch.  Returns the number of chunks in it.
+  unsigned int render()
+  {
+    Chunk* batch[max_chunks_per_frame];
+    unsigned int batch_size = 0;
+    Chunk* chunk;
+
+    while ((batch_size < max_chunks_per_frame) && stale_chunks->pop(chunk))
+    {
+      if (chunk->in_batch)
+      {
+        ++duplicate_count;
+      }
+      chunk->in_batch = true;
+      batch[batch_size] = chunk;
+      ++batch_size;
+    }
+
+    for (unsigned int index = 0; index < batch_size; ++index)
+    {
+      batch[index]->state.take();
+    }
+
+    for (unsigned int index = 0; index < batch_size; ++index)
+    {
+      batch[index]->meshed_version = batch[index]->version;
+      batch[index]->in_batch = false;
+    }
+
+    if (batch_size > 0)
+    {
+      ++batch_count;
+    }
+
+    return batch_size;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  double seconds = (argc > 1) ? std::atof(argv[1]) : 5;
+  unsigned int writer_count = (argc > 2) ? std::atoi(argv[2]) : 3;
+
+  chunks.reset(new Chunk[chunk_count]);
+  stale_chunks.reset(new BoundedMPMCQueue<Chunk*>(chunk_count));
+  writers_done = false;
+
+  // Chunks start out dirty, so queue them all, as add_listener() does.
+  for (unsigned int index = 0; index < chunk_count; ++index)
+  {
+    chunks[index].version = 0;
+    chunks[index].meshed_version = (unsigned int) -1;
+    chunks[index].in_batch = false;
+    queue_chunk(chunks[index]);
+  }
+
+  std::cout << "Editing " << chunk_count << " chunks from " << writer_count
+            << " threads for " << seconds << " s while draining the queue..."
+            << std::endl;
+
+  boost::thread_group writers;
+  for (unsigned int index = 0; index < writer_count; ++index)
+  {
+    writers.create_thread([index]()
+    {
+      write(index + 1);
+    });
+  }
+
+  boost::chrono::steady_clock::time_point end =
+    boost::chrono::steady_clock::now() +
+    boost::chrono::milliseconds((long long) (seconds * 1000));
+
+  while (boost::chrono::steady_clock::now() < end)
+  {
+    render();
+  }
+
+  writers_done = true;
+  writers.join_all();
+
+  while (render() > 0)
+  {
+  }
+
+  unsigned int lost_count = 0;
+  for (unsigned int index = 0; index < chunk_count; ++index)
+  {
+    Chunk& chunk = chunks[index];
+    if (chunk.state.is_dirty() || (chunk.meshed_version != chunk.version))
+    {
+      ++lost_count;
+    }
+  }
+
+  std::cout << batch_count << " batches, " << lost_count
+            << " chunk(s) with a lost update, " << duplicate_count
+            << " chunk(s) in the same batch twice." << std::endl;
+
+  if ((lost_count != 0) || (duplicate_count != 0))
+  {
+    std::cout << "FAILED" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Passed" << std::endl;
+  return 0;
+}
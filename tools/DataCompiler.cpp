@@ -0,0 +1,32 @@
+/// Offline tool that compiles the descriptor files under data/ into the
+/// binary descriptor database the game loads at startup.
+/// Usage: DataCompiler [data directory] [database file]
+/// Run it from the project directory; the defaults match what the game
+/// expects.
+
+#include <iostream>
+#include <string>
+
+#include "DescriptorDatabase.h"
+
+int main(int argc, char** argv)
+{
+  std::string data_path = (argc > 1) ? argv[1] : "data";
+  std::string database_path = (argc > 2) ? argv[2] :
+                              (data_path + "/descriptors.db");
+
+  if (!DescriptorDatabase::compile(data_path, database_path))
+  {
+    std::cout << "Descriptor database was not written." << std::endl;
+    return 1;
+  }
+
+  // Make sure the game will accept what was just written.
+  if (!DescriptorDatabase::instance()->open(data_path, database_path))
+  {
+    std::cout << "Descriptor database failed to load back." << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
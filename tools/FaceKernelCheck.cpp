@@ -0,0 +1,214 @@
+/// Check that the three ways of working out hidden faces agree exactly:
+/// HiddenFaceKernel::calculate() (SSE2, where available), the one-block-at-
+/// a-time HiddenFaceKernel::calculate_scalar(), and the per-block
+/// StageBlock::calculate_hidden_faces() that both replaced.
+///
+/// First the two kernels are run on halos filled with random substances and
+/// opacities.  Then a small stage is filled with blocks of random
+/// substances, each chunk's halo is captured the way the game does it, and
+/// both kernels are compared against every block's own calculation,
+/// including along the edges of the stage.
+///
+/// The second part needs the application instance (for the job system and
+/// the random twister) and the substance library, so it opens the game's
+/// window while it runs, and must be run from the project directory.
+///
+/// Usage: FaceKernelCheck [seed [random halo count]]
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "Application.h"
+#include "FaceBools.h"
+#include "HiddenFaceKernel.h"
+#include "Stage.h"
+#include "StageBlock.h"
+#include "StageChunk.h"
+#include "StageChunkHalo.h"
+#include "SubstanceLibrary.h"
+
+namespace
+{
+  /// Number of substances to pick from when filling blocks.  Kept small so
+  /// that neighbors are often made of the same thing.
+  unsigned int const palette_size = 4;
+
+  boost::random::mt19937 twister;
+
+  unsigned int mismatch_count = 0;
+
+  /// Pick a random number from 0 to count - 1.
+  unsigned int pick(unsigned int count)
+  {
+    boost::random::uniform_int_distribution<unsigned int> dist(0, count - 1);
+    return dist(twister);
+  }
+
+  /// Compare two sets of masks for one block, and report any difference.
+  void compare(char const* what,
+               int block_index,
+               uint8_t expected_solid,
+               uint8_t expected_fluid,
+               uint8_t solid,
+               uint8_t fluid)
+  {
+    if ((solid != expected_solid) || (fluid != expected_fluid))
+    {
+      if (mismatch_count < 10)
+      {
+        std::cout << "  " << what << " mismatch at block " << block_index
+                  << ": solid " << (int) solid << " vs " << (int) expected_solid
+                  << ", fluid " << (int) fluid << " vs " << (int) expected_fluid
+                  << std::endl;
+      }
+      ++mismatch_count;
+    }
+  }
+
+  /// Compare the SIMD and scalar kernels on halos of random data.
+  void check_random_halos(unsigned int halo_count)
+  {
+    std::unique_ptr<StageChunkHalo> halo(new StageChunkHalo());
+    HiddenFaceKernel::Output output;
+    HiddenFaceKernel::Output scalar_output;
+
+    for (unsigned int count = 0; count < halo_count; ++count)
+    {
+      // A fresh palette each time, sometimes including the ID used for
+      // places outside the stage.
+      SubstanceID palette[palette_size];
+      for (unsigned int index = 0; index < palette_size; ++index)
+      {
+        palette[index] = (pick(8) == 0) ? SUBSTANCEID_NULL : pick(1024);
+      }
+
+      for (int slab = 0; slab < StageChunkHalo::SlabCount; ++slab)
+      {
+        for (int index = 0; index < StageChunkHalo::area; ++index)
+        {
+          halo->solid[slab][index] = palette[pick(palette_size)];
+          halo->fluid[slab][index] = palette[pick(palette_size)];
+          halo->opaque[slab][index] = (pick(3) == 0) ? 0xFFFF : 0;
+          halo->summary[slab][index] = 0;
+        }
+      }
+
+      HiddenFaceKernel::calculate(*halo, output);
+      HiddenFaceKernel::calculate_scalar(*halo, scalar_output);
+
+      for (int index = 0; index < StageChunk::blocks_per_chunk; ++index)
+      {
+        compare("Random halo: SIMD/scalar", index,
+                scalar_output.solid[index], scalar_output.fluid[index],
+                output.solid[index], output.fluid[index]);
+      }
+    }
+  }
+
+  /// Fill a stage with random blocks, and compare both kernels against
+  /// StageBlock::calculate_hidden_faces() for every block.
+  void check_stage(StageCoord3 stage_size)
+  {
+    SubstanceLibraryShPtr library = SL;
+    StageShPtr stage = Stage::get_instance();
+    stage->build(stage_size, (int) twister());
+    stage_size = stage->size();
+
+    std::vector<SubstanceID> palette;
+    palette.push_back(library->get_id("air"));
+    palette.push_back(library->get_id("nothing"));
+    while (palette.size() < palette_size)
+    {
+      palette.push_back(pick(library->get_substance_count()));
+    }
+
+    for (StageCoord z = 0; z < stage_size.z; ++z)
+    {
+      for (StageCoord y = 0; y < stage_size.y; ++y)
+      {
+        for (StageCoord x = 0; x < stage_size.x; ++x)
+        {
+          StageBlock& block = stage->get_block(x, y, z);
+          block.set_substance_quickly(BlockLayer::Solid, palette[pick(palette_size)]);
+          block.set_substance_quickly(BlockLayer::Fluid, palette[pick(palette_size)]);
+        }
+      }
+    }
+
+    std::unique_ptr<StageChunkHalo> halo(new StageChunkHalo());
+    HiddenFaceKernel::Output output;
+    HiddenFaceKernel::Output scalar_output;
+
+    for (int chunk_index = 0; chunk_index < stage->get_chunk_count(); ++chunk_index)
+    {
+      StageChunk& chunk = stage->get_chunk(chunk_index);
+      StageCoord3 const& coords = chunk.get_coords();
+
+      chunk.capture_halo(*halo);
+      HiddenFaceKernel::calculate(*halo, output);
+      HiddenFaceKernel::calculate_scalar(*halo, scalar_output);
+
+      for (StageCoord add_y = 0; add_y < StageChunk::chunk_side_length; ++add_y)
+      {
+        for (StageCoord add_x = 0; add_x < StageChunk::chunk_side_length; ++add_x)
+        {
+          StageBlock& block = stage->get_block(coords.x + add_x,
+                                               coords.y + add_y,
+                                               coords.z);
+          int index = (add_y * StageChunk::chunk_side_length) + add_x;
+
+          block.calculate_hidden_faces();
+          uint8_t solid = block.get_hidden_faces(BlockLayer::Solid).get_mask();
+          uint8_t fluid = block.get_hidden_faces(BlockLayer::Fluid).get_mask();
+
+          compare("Stage: SIMD/per-block", index, solid, fluid,
+                  output.solid[index], output.fluid[index]);
+          compare("Stage: scalar/per-block", index, solid, fluid,
+                  scalar_output.solid[index], scalar_output.fluid[index]);
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int seed = (argc > 1) ? std::strtoul(argv[1], nullptr, 10)
+                                 : (unsigned int) std::time(nullptr);
+  unsigned int halo_count = (argc > 2) ? std::strtoul(argv[2], nullptr, 10)
+                                       : 1000;
+
+  twister.seed(seed);
+  std::cout << "Seed " << seed << std::endl;
+
+#ifdef __SSE2__
+  std::cout << "Comparing the SSE2 and scalar kernels on " << halo_count
+            << " random halos..." << std::endl;
+#else
+  std::cout << "No SSE2 here, so HiddenFaceKernel::calculate() is the scalar "
+            << "kernel; comparing it anyway on " << halo_count
+            << " random halos..." << std::endl;
+#endif
+  check_random_halos(halo_count);
+
+  std::cout << "Comparing both kernels against StageBlock on a random stage..."
+            << std::endl;
+  App::instance();
+  check_stage(StageCoord3(64, 64, 8));
+
+  std::cout << mismatch_count << " mismatch(es)." << std::endl;
+
+  if (mismatch_count != 0)
+  {
+    std::cout << "FAILED" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,426 @@
+/// Headless check of GUIRenderData's partial re-emission.
+///
+/// Builds a small GUI tree out of the real GUIElement and GUIParentElement
+/// classes and visits it the way GUIRenderer3D does, with the GL calls made
+/// by GUIRenderData pointed at stubs that record uploads instead of talking
+/// to a driver.  Each element emits a fixed number of vertices tagged with
+/// its own ID and the pass that emitted them, so the buffer shows exactly
+/// which spans were rewritten.
+///
+/// After the first pass, a pass where nothing changed must emit nothing, and
+/// dirtying one element must emit only that element's vertices, leave every
+/// other element's vertices alone, and upload only that element's span.
+/// After every edit, the patched buffer must draw the same as a buffer built
+/// from scratch.
+///
+/// Usage: GUIVertexCount
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "GUIElementVisitor.h"
+#include "GUIParentElement.h"
+#include "GUIRenderData.h"
+#include "GUIVertexRenderData.h"
+
+namespace
+{
+  /// Spare room GUIRenderData leaves after each span.
+  unsigned int const span_slack = 48;
+
+  /// Uploads recorded by the GL stubs.
+  unsigned int full_upload_count = 0;
+  unsigned int partial_upload_count = 0;
+  long partial_upload_offset = 0;
+  long partial_upload_size = 0;
+
+  unsigned int failure_count = 0;
+
+  void GLAPIENTRY stub_gen(GLsizei n, GLuint* ids)
+  {
+    for (GLsizei index = 0; index < n; ++index)
+    {
+      ids[index] = index + 1;
+    }
+  }
+
+  void GLAPIENTRY stub_delete(GLsizei, GLuint const*)
+  {
+  }
+
+  void GLAPIENTRY stub_bind_vertex_array(GLuint)
+  {
+  }
+
+  void GLAPIENTRY stub_bind_buffer(GLenum, GLuint)
+  {
+  }
+
+  void GLAPIENTRY stub_buffer_data(GLenum, GLsizeiptr, void const*, GLenum)
+  {
+    ++full_upload_count;
+  }
+
+  void GLAPIENTRY stub_buffer_sub_data(GLenum, GLintptr offset,
+                                       GLsizeiptr size, void const*)
+  {
+    ++partial_upload_count;
+    partial_upload_offset = offset;
+    partial_upload_size = size;
+  }
+
+  void GLAPIENTRY stub_enable_vertex_attrib_array(GLuint)
+  {
+  }
+
+  void GLAPIENTRY stub_vertex_attrib_pointer(GLuint, GLint, GLenum, GLboolean,
+                                             GLsizei, void const*)
+  {
+  }
+
+  /// Point the GL entry points GUIRenderData uses at the stubs.
+  void stub_out_gl()
+  {
+    glGenVertexArrays = stub_gen;
+    glGenBuffers = stub_gen;
+    glDeleteVertexArrays = stub_delete;
+    glDeleteBuffers = stub_delete;
+    glBindVertexArray = stub_bind_vertex_array;
+    glBindBuffer = stub_bind_buffer;
+    glBufferData = stub_buffer_data;
+    glBufferSubData = stub_buffer_sub_data;
+    glEnableVertexAttribArray = stub_enable_vertex_attrib_array;
+    glVertexAttribPointer = stub_vertex_attrib_pointer;
+  }
+
+  /// Element that emits a set number of vertices.
+  class TestElement : public GUIParentElement
+  {
+  public:
+    TestElement(GUIElement* parent, std::string name, unsigned int id,
+                unsigned int vertex_count)
+      : GUIParentElement(parent, name, glm::vec2(0.0f), glm::vec2(10.0f), true),
+        id_(id),
+        vertex_count_(vertex_count)
+    {
+    }
+
+    /// Change the number of vertices emitted, as a label does when its text
+    /// changes length.
+    void set_vertex_count(unsigned int vertex_count)
+    {
+      vertex_count_ = vertex_count;
+      set_dirty();
+    }
+
+    unsigned int get_id() const
+    {
+      return id_;
+    }
+
+    unsigned int get_vertex_count() const
+    {
+      return vertex_count_;
+    }
+
+  private:
+    unsigned int id_;
+    unsigned int vertex_count_;
+  };
+
+  /// Visitor that emits vertices the way GUIRenderer3D does.  Each vertex
+  /// has the pass number (plus one, so it is never zero) as its X and the
+  /// element's ID as its Y.  Padding vertices are all zero.
+  class TestRenderer : public GUIElementVisitor
+  {
+  public:
+    TestRenderer(GUIRenderData& render_data)
+      : render_data_(render_data),
+        pass_(0)
+    {
+    }
+
+    /// Visit the GUI, visiting it again if the data had to be rebuilt.
+    /// @return False if the data had to be rebuilt.
+    bool draw(GUIElement& root)
+    {
+      ++pass_;
+      render_data_.begin_pass();
+      root.accept(*this);
+      if (render_data_.end_pass())
+      {
+        render_data_.update_VAO();
+        return true;
+      }
+
+      render_data_.begin_pass();
+      root.accept(*this);
+      render_data_.end_pass();
+      render_data_.update_VAO();
+      return false;
+    }
+
+    unsigned int get_pass() const
+    {
+      return pass_;
+    }
+
+    virtual bool visit(GUI&)
+    {
+      return false;
+    }
+
+    virtual bool visit(GUIElement& element)
+    {
+      bool redraw;
+      return begin_visit(element, redraw);
+    }
+
+    virtual bool visit(GUIParentElement& element)
+    {
+      bool redraw;
+      bool visit_children = begin_visit(element, redraw);
+
+      if (redraw)
+      {
+        TestElement& test_element = static_cast<TestElement&>(element);
+        for (unsigned int index = 0; index < test_element.get_vertex_count(); ++index)
+        {
+          render_data_.add_vertex(glm::vec2((float) (pass_ + 1),
+                                            (float) test_element.get_id()),
+                                  glm::vec4(1.0f));
+        }
+      }
+
+      return visit_children;
+    }
+
+    virtual bool visit(GUIFrame&)
+    {
+      return false;
+    }
+
+    virtual bool visit(GUILabel&)
+    {
+      return false;
+    }
+
+  private:
+    /// Same as GUIRenderer3D::Impl::begin_visit().
+    bool begin_visit(GUIElement& element, bool& redraw)
+    {
+      redraw = render_data_.begin_element(element);
+      bool visible = element.get_absolute_visibility();
+      bool visit_children = visible && (redraw || element.is_dirty());
+
+      if (redraw || !visible)
+      {
+        element.clear_dirty();
+      }
+      else
+      {
+        element.clear_child_dirty();
+      }
+
+      redraw = redraw && visible;
+      return visit_children;
+    }
+
+    GUIRenderData& render_data_;
+    unsigned int pass_;
+  };
+
+  void check(bool condition, std::string const& what)
+  {
+    if (!condition)
+    {
+      std::cout << "  FAILED: " << what << std::endl;
+      ++failure_count;
+    }
+  }
+
+  /// Get the element IDs of a buffer's non-padding vertices, in order.
+  std::vector<unsigned int> get_drawn_ids(GUIRenderData const& render_data)
+  {
+    std::vector<unsigned int> ids;
+    for (GUIVertexRenderData const& vertex : render_data.vertices)
+    {
+      if (vertex.x != 0.0f)
+      {
+        ids.push_back((unsigned int) vertex.y);
+      }
+    }
+    return ids;
+  }
+
+  /// Check that the buffer draws the same elements, in the same order, as
+  /// one built from scratch.
+  void check_matches_rebuild(GUIRenderData const& render_data,
+                             GUIElement& root,
+                             std::string const& what)
+  {
+    GUIRenderData fresh_data;
+    TestRenderer fresh_renderer(fresh_data);
+    root.set_dirty();
+    fresh_renderer.draw(root);
+    check(get_drawn_ids(render_data) == get_drawn_ids(fresh_data),
+          what + ": patched buffer draws the same as a rebuilt one");
+  }
+
+  /// Find where an element's vertices sit in the buffer.
+  /// @return True if they were found in one unbroken run.
+  bool find_vertices(GUIRenderData const& render_data, unsigned int id,
+                     unsigned int& first, unsigned int& count)
+  {
+    bool found = false;
+    count = 0;
+    for (unsigned int index = 0; index < render_data.vertices.size(); ++index)
+    {
+      GUIVertexRenderData const& vertex = render_data.vertices[index];
+      if ((vertex.x != 0.0f) && ((unsigned int) vertex.y == id))
+      {
+        if (!found)
+        {
+          found = true;
+          first = index;
+        }
+        else if (index != first + count)
+        {
+          return false;
+        }
+        ++count;
+      }
+    }
+    return found;
+  }
+
+  /// Dirty one element with no children, draw, and check that only its
+  /// span was touched.
+  void check_patch(GUIRenderData& render_data,
+                   TestRenderer& renderer,
+                   GUIElement& root,
+                   TestElement& element,
+                   unsigned int new_vertex_count,
+                   std::string const& what)
+  {
+    unsigned int old_first;
+    unsigned int old_count;
+    check(find_vertices(render_data, element.get_id(), old_first, old_count),
+          what + ": element's vertices found before the edit");
+
+    std::vector<GUIVertexRenderData> before(render_data.vertices.begin(),
+                                            render_data.vertices.end());
+    unsigned int full_uploads = full_upload_count;
+    unsigned int partial_uploads = partial_upload_count;
+
+    element.set_vertex_count(new_vertex_count);
+    check(renderer.draw(root), what + ": no rebuild needed");
+
+    check(render_data.emitted_count == new_vertex_count,
+          what + ": emitted only the dirty element's vertices");
+    check(render_data.vertices.size() == before.size(),
+          what + ": buffer stayed the same size");
+    check(full_upload_count == full_uploads,
+          what + ": buffer not uploaded in full");
+    check(partial_upload_count == partial_uploads + 1,
+          what + ": one partial upload");
+
+    // The span runs from the element's first vertex to its spare room.
+    unsigned int span_first = old_first;
+    unsigned int span_end = old_first + old_count + span_slack;
+    check(partial_upload_offset == (long) (span_first * sizeof(GUIVertexRenderData)),
+          what + ": upload starts at the element's span");
+    check(partial_upload_size == (long) ((span_end - span_first) * sizeof(GUIVertexRenderData)),
+          what + ": upload covers only the element's span");
+
+    // Everything outside the span must be untouched.
+    bool untouched = (render_data.vertices.size() == before.size());
+    for (unsigned int index = 0; untouched && (index < before.size()); ++index)
+    {
+      if ((index < span_first) || (index >= span_end))
+      {
+        untouched = (std::memcmp(&(before[index]),
+                                 &(render_data.vertices[index]),
+                                 sizeof(GUIVertexRenderData)) == 0);
+      }
+    }
+    check(untouched, what + ": vertices outside the span untouched");
+
+    unsigned int new_first;
+    unsigned int new_count;
+    check(find_vertices(render_data, element.get_id(), new_first, new_count) &&
+          (new_first == span_first) && (new_count == new_vertex_count),
+          what + ": element's new vertices are at the start of its span");
+    check(render_data.vertices[new_first].x == (float) (renderer.get_pass() + 1),
+          what + ": element's vertices came from this pass");
+
+    check_matches_rebuild(render_data, root, what);
+  }
+}
+
+int main()
+{
+  stub_out_gl();
+
+  // root
+  //   a       (6 vertices)
+  //   b       (30 vertices)
+  //     label (36 vertices)
+  //   c       (6 vertices)
+  TestElement root(nullptr, "root", 1, 6);
+  TestElement* a = new TestElement(&root, "a", 2, 6);
+  TestElement* b = new TestElement(&root, "b", 3, 30);
+  TestElement* label = new TestElement(b, "label", 4, 36);
+  TestElement* c = new TestElement(&root, "c", 5, 6);
+  root.add_child(a);
+  root.add_child(b);
+  b->add_child(label);
+  root.add_child(c);
+
+  GUIRenderData render_data;
+  TestRenderer renderer(render_data);
+
+  std::cout << "Building the buffer..." << std::endl;
+  check(renderer.draw(root), "first pass: no rebuild needed");
+  check(render_data.emitted_count == 6 + 6 + 30 + 36 + 6,
+        "first pass: emitted every element");
+  check(render_data.vertex_count == (int) (render_data.emitted_count + (5 * span_slack)),
+        "first pass: every span has its spare room");
+  check(full_upload_count == 1, "first pass: buffer uploaded in full");
+
+  std::cout << "Drawing with nothing changed..." << std::endl;
+  unsigned int partial_uploads = partial_upload_count;
+  renderer.draw(root);
+  check(render_data.emitted_count == 0, "idle pass: emitted nothing");
+  check((full_upload_count == 1) && (partial_upload_count == partial_uploads),
+        "idle pass: nothing uploaded");
+
+  std::cout << "Changing a nested element without changing its size..." << std::endl;
+  check_patch(render_data, renderer, root, *label, 36, "same size");
+
+  std::cout << "Growing a nested element within its spare room..." << std::endl;
+  check_patch(render_data, renderer, root, *label, 36 + span_slack, "grown");
+
+  std::cout << "Shrinking an element at the end of the tree..." << std::endl;
+  check_patch(render_data, renderer, root, *c, 3, "shrunk");
+
+  std::cout << "Outgrowing the spare room..." << std::endl;
+  label->set_vertex_count(36 + (2 * span_slack));
+  check(!renderer.draw(root), "outgrown: buffer rebuilt");
+  check(render_data.emitted_count == 6 + 6 + 30 + (36 + (2 * span_slack)) + 3,
+        "outgrown: emitted every element");
+  check_matches_rebuild(render_data, root, "outgrown");
+
+  if (failure_count != 0)
+  {
+    std::cout << "FAILED" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,336 @@
+/// Check the parts of JobSystem that the stage builders, the mesher and the
+/// simulation systems rely on.
+///
+/// Stealing: one worker queues low- and high-priority jobs on its own queues
+/// and then stays busy, so the other worker has to steal every one of them.
+/// All of the high-priority jobs must be stolen before any of the low-
+/// priority ones, and each priority's jobs must be stolen oldest first.
+///
+/// Helping: with a single worker, a job submits more jobs and waits for
+/// them.  Nothing else can run them, so unless Counter waits run queued jobs
+/// themselves, the job never finishes.  This is checked two levels deep.
+///
+/// parallel_for: ranges of several sizes are split with several grains on
+/// pools of several sizes, and every index must be handed to the body
+/// exactly once.
+///
+/// A check that gets stuck is reported as failed after a timeout, instead
+/// of hanging.
+///
+/// Usage: JobSystemCheck [timeout seconds]
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "JobSystem.h"
+
+namespace
+{
+  /// Number of jobs of each priority queued for the stealing check.
+  unsigned int const steal_job_count = 32;
+
+  /// Number of jobs each level of the helping check waits for.
+  unsigned int const help_job_count = 16;
+
+  /// How long a check may take before it is reported as stuck.
+  double timeout_seconds = 10;
+
+  unsigned int failure_count = 0;
+
+  void fail(char const* what)
+  {
+    std::cout << "  " << what << std::endl;
+    ++failure_count;
+  }
+
+  /// Sleep until a flag is set, or the timeout runs out.
+  /// @return True if the flag was set.
+  bool wait_for(std::atomic<bool> const& flag)
+  {
+    boost::chrono::steady_clock::time_point end =
+      boost::chrono::steady_clock::now() +
+      boost::chrono::milliseconds((long long) (timeout_seconds * 1000));
+
+    while (!flag.load())
+    {
+      if (boost::chrono::steady_clock::now() >= end)
+      {
+        return false;
+      }
+      boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+    }
+
+    return true;
+  }
+
+  /// Give up on a check that is stuck.  The pool can't be shut down with
+  /// jobs still running, so the process ends here.
+  void give_up(char const* what)
+  {
+    std::cout << "  " << what << " didn't finish within " << timeout_seconds
+              << " s." << std::endl;
+    std::cout << "FAILED" << std::endl;
+    std::_Exit(1);
+  }
+
+  void check_stealing()
+  {
+    std::cout << "Checking that jobs are stolen by priority..." << std::endl;
+
+    JobSystem jobs(2);
+
+    std::atomic<unsigned int> arrived(0);
+    std::atomic<bool> queued(false);
+    std::atomic<bool> finished(false);
+    std::atomic<unsigned int> next_slot(0);
+    std::vector<int> order(steal_job_count * 2, -1);
+    std::vector<boost::thread::id> ran_on(steal_job_count * 2);
+    boost::thread::id owner;
+
+    // Jobs 0 to steal_job_count - 1 are low priority, the rest high.
+    auto queue_jobs = [&]()
+    {
+      owner = boost::this_thread::get_id();
+
+      JobSystem::Counter stolen_jobs;
+      for (unsigned int index = 0; index < steal_job_count * 2; ++index)
+      {
+        JobSystem::Priority priority = (index < steal_job_count)
+                                       ? JobSystem::Priority::Low
+                                       : JobSystem::Priority::High;
+        jobs.submit([&, index]()
+        {
+          unsigned int slot = next_slot.fetch_add(1);
+          order[slot] = index;
+          ran_on[index] = boost::this_thread::get_id();
+        }, priority, &stolen_jobs);
+      }
+      queued = true;
+
+      // Stay busy, without helping, until the other worker has run them all.
+      while (!stolen_jobs.is_done())
+      {
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+      }
+      jobs.wait(stolen_jobs);
+      finished = true;
+    };
+
+    // Both workers take one of these; the first to arrive queues the jobs,
+    // and the other is let go once they are queued.
+    for (unsigned int index = 0; index < 2; ++index)
+    {
+      jobs.submit([&]()
+      {
+        if (arrived.fetch_add(1) == 0)
+        {
+          while (arrived.load() < 2)
+          {
+            boost::this_thread::yield();
+          }
+          queue_jobs();
+        }
+        else
+        {
+          while (!queued.load())
+          {
+            boost::this_thread::yield();
+          }
+        }
+      });
+    }
+
+    if (!wait_for(finished))
+    {
+      give_up("Stealing check");
+    }
+
+    // Thieves take the oldest job of the highest priority they can find.
+    bool in_order = true;
+    bool all_stolen = true;
+    for (unsigned int slot = 0; slot < steal_job_count * 2; ++slot)
+    {
+      int expected = (slot < steal_job_count) ? slot + steal_job_count
+                                              : slot - steal_job_count;
+      if (order[slot] != expected)
+      {
+        in_order = false;
+      }
+      if (ran_on[slot] == owner)
+      {
+        all_stolen = false;
+      }
+    }
+
+    std::vector<JobSystem::WorkerStats> stats = jobs.get_stats();
+    unsigned int stolen_count = stats[0].jobs_stolen + stats[1].jobs_stolen;
+    std::cout << "  " << stolen_count << " job(s) stolen." << std::endl;
+
+    if (!all_stolen)
+    {
+      fail("The busy worker ran some of its own queued jobs.");
+    }
+    if (!in_order)
+    {
+      fail("Jobs weren't stolen high priority first, oldest first.");
+    }
+    if (stolen_count < steal_job_count * 2)
+    {
+      fail("Fewer jobs were counted as stolen than were queued.");
+    }
+  }
+
+  /// Submit jobs and wait for them from inside a job, depth levels deep.
+  void submit_and_wait(JobSystem& jobs,
+                       unsigned int depth,
+                       std::atomic<unsigned int>& run_count,
+                       std::atomic<bool>& wrong_thread)
+  {
+    boost::thread::id waiter = boost::this_thread::get_id();
+    JobSystem::Counter counter;
+
+    for (unsigned int index = 0; index < help_job_count; ++index)
+    {
+      jobs.submit([&, depth, waiter]()
+      {
+        if (boost::this_thread::get_id() != waiter)
+        {
+          wrong_thread = true;
+        }
+        ++run_count;
+        if (depth > 1)
+        {
+          submit_and_wait(jobs, depth - 1, run_count, wrong_thread);
+        }
+      }, JobSystem::Priority::Normal, &counter);
+    }
+
+    jobs.wait(counter);
+  }
+
+  void check_helping()
+  {
+    std::cout << "Checking that waiting inside a job runs the jobs waited "
+              << "for..." << std::endl;
+
+    JobSystem jobs(1);
+
+    std::atomic<unsigned int> run_count(0);
+    std::atomic<bool> wrong_thread(false);
+    std::atomic<bool> finished(false);
+
+    jobs.submit([&]()
+    {
+      submit_and_wait(jobs, 2, run_count, wrong_thread);
+      finished = true;
+    });
+
+    if (!wait_for(finished))
+    {
+      give_up("Helping check");
+    }
+
+    std::cout << "  " << run_count << " nested job(s) run." << std::endl;
+
+    if (run_count != help_job_count + (help_job_count * help_job_count))
+    {
+      fail("Some nested jobs didn't run.");
+    }
+    if (wrong_thread)
+    {
+      fail("Nested jobs ran somewhere other than the waiting worker.");
+    }
+  }
+
+  void check_parallel_for()
+  {
+    std::cout << "Checking that parallel_for covers every index once..."
+              << std::endl;
+
+    unsigned int const worker_counts[] = { 1, 2, 4 };
+    unsigned int const counts[] = { 0, 1, 7, 64, 1000, 4099 };
+    unsigned int const grains[] = { 0, 1, 3, 64, 5000 };
+    unsigned int range_count = 0;
+
+    for (unsigned int worker_count : worker_counts)
+    {
+      JobSystem jobs(worker_count);
+
+      for (unsigned int count : counts)
+      {
+        for (unsigned int grain : grains)
+        {
+          std::unique_ptr<std::atomic<unsigned int>[]> hits(
+            new std::atomic<unsigned int>[count + 1]);
+          for (unsigned int index = 0; index <= count; ++index)
+          {
+            hits[index] = 0;
+          }
+          std::atomic<bool> bad_range(false);
+
+          jobs.parallel_for(count, grain,
+                            [&](unsigned int first, unsigned int last)
+          {
+            if ((first >= last) || (last > count))
+            {
+              bad_range = true;
+              return;
+            }
+            for (unsigned int index = first; index < last; ++index)
+            {
+              ++(hits[index]);
+            }
+          });
+
+          bool exactly_once = true;
+          for (unsigned int index = 0; index < count; ++index)
+          {
+            if (hits[index] != 1)
+            {
+              exactly_once = false;
+            }
+          }
+
+          if (bad_range || !exactly_once)
+          {
+            std::cout << "  " << worker_count << " worker(s), count " << count
+                      << ", grain " << grain << ": ";
+            fail(bad_range ? "empty or out-of-range piece"
+                           : "some index not covered exactly once");
+          }
+          ++range_count;
+        }
+      }
+    }
+
+    std::cout << "  " << range_count << " range(s) checked." << std::endl;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+  {
+    timeout_seconds = std::strtod(argv[1], nullptr);
+  }
+
+  check_stealing();
+  check_helping();
+  check_parallel_for();
+
+  std::cout << failure_count << " failure(s)." << std::endl;
+
+  if (failure_count != 0)
+  {
+    std::cout << "FAILED" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Passed" << std::endl;
+  return 0;
+}